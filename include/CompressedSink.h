@@ -0,0 +1,278 @@
+#ifndef INCLUDE_COMPRESSED_SINK_H
+#define INCLUDE_COMPRESSED_SINK_H
+
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "LogCompression.h"
+#include "LogSink.h"
+#include "QueuedSink.h"
+#include "TimeIndex.h"
+
+/**
+ * A block of CompressedSink and the index entries of the messages that start in it
+ * */
+struct CompressedBlock {
+    std::vector<char> text;
+    std::vector<TimeIndex::Entry> entries;
+
+    bool empty() const {
+        return text.empty();
+    }
+
+    void clear() {
+        text.clear();
+        entries.clear();
+    }
+
+    void reserve(size_t size) {
+        text.reserve(size);
+    }
+};
+
+/**
+ * Output that compresses everything written to it into a file of independent blocks (see LogCompression.h)
+ * Writes are copied into the current block; full blocks are compressed and written by a background thread,
+ * so the thread that logs never compresses or touches the disk
+ * ```
+ * CompressedSink sink("trace.dlz");
+ * logger.setTargetOutput(&sink);
+ * ```
+ * Read the file back with the LogCat tool
+ *
+ * A block is sealed when it is full, when the sink is flushed (std::flush), and when it has been
+ * open for the flush interval, so a crash loses at most the open block and the blocks still queued,
+ * and a crash in the middle of writing a block only costs that block
+ * Only 2 sealed blocks wait for the background thread by default, so the logging thread feels a slow disk or compressor
+ * within a few blocks and little is lost on a crash. setMaxQueuedBlocks() allows a deeper queue to ride out bursts
+ * The queue depth variables count blocks, the dropped count is messages
+ * enableTimeIndex() writes a sidecar index of the blocks, see TimeIndex.h
+ * @author Bryce Young
+ * */
+class CompressedSink : public QueuedSink<CompressedSink, CompressedBlock> {
+    public:
+        /**
+         * @param path the file to create, replacing any file already there
+         * @param blockSize bytes of text per block, more compresses better but loses more on a crash
+         * */
+        CompressedSink(const char* path, size_t blockSize = 65536)
+            :QueuedSink(&buffer, 1000, validBlockSize(blockSize), 2),
+            buffer(*this),
+            blockSize(validBlockSize(blockSize))
+        {
+            file = fopen(path, "wb");
+
+            if(!file) {
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            char header[LogCompression::FILE_HEADER_SIZE];
+            LogCompression::writeFileHeader(header);
+            fwrite(header, 1, sizeof(header), file);
+            fflush(file);
+            startWorker();
+        }
+
+        /**
+         * Writes every queued block before closing the file
+         * */
+        ~CompressedSink() {
+            if(!file) {
+                return;
+            }
+
+            stopWorker();
+            fclose(file);
+        }
+
+        CompressedSink(const CompressedSink&) = delete;
+        CompressedSink& operator=(const CompressedSink&) = delete;
+
+        /**
+         * Returns whether the file could be created
+         * */
+        bool isOpen() const {
+            return file != nullptr;
+        }
+
+        /**
+         * Sets how long a partly filled block may wait before it is compressed and written, 0 to only write full blocks
+         * This bounds how much is lost on a crash when little is being logged (default 1000ms)
+         * */
+        void setFlushInterval(uint64_t milliseconds) {
+            setSealInterval(milliseconds * 1000000);
+        }
+
+        /**
+         * Sets the number of sealed blocks that may wait for the background thread (default 2)
+         * A deeper queue absorbs longer bursts before the logging thread waits or drops messages, at the cost of
+         * a block size of memory per block and more of the log lost on a crash
+         * */
+        void setMaxQueuedBlocks(size_t blocks) {
+            std::lock_guard<std::mutex> guard(lock);
+            maxQueuedBlocks = blocks > 0? blocks : 1;
+            space.notify_all();
+        }
+
+        /**
+         * Sets what happens when the queue is full: wait for the background thread (default),
+         * or throw the message away and count it in the dropped messages
+         * */
+        void setDropWhenFull(bool drop) {
+            std::lock_guard<std::mutex> guard(lock);
+            dropWhenFull = drop;
+        }
+
+        /**
+         * Seals the open block and waits until everything written so far is in the file
+         * */
+        void drain() {
+            if(file) {
+                drainQueue();
+            }
+        }
+
+        /**
+         * Writes an index of the messages of the logger writing to this sink to @param path, see TimeIndex.h
+         * An entry is added every @param everyMessages messages or @param everyMilliseconds of logger time, whichever comes first
+         * Entries are written after the block they point into, so the index never points past the end of the file
+         * */
+        bool enableTimeIndex(const char* path, uint64_t everyMessages = 1000, uint64_t everyMilliseconds = 1000) {
+            std::unique_lock<std::mutex> guard(lock);
+
+            //the background thread writes entries without holding the lock
+            while(busy) {
+                space.wait(guard);
+            }
+
+            bool opened = file && index.open(path, true, everyMessages, everyMilliseconds);
+            indexing.store(opened, std::memory_order_relaxed);
+            return opened;
+        }
+
+        void beginMessage(uint64_t nanoseconds, uint64_t messageCount) override {
+            //the entry is made by write(), under the lock the message is copied with
+            if(indexing.load(std::memory_order_relaxed)) {
+                setPendingMessage(nanoseconds, messageCount);
+            }
+        }
+
+        /**
+         * Returns the number of bytes written to the sink
+         * */
+        uint64_t getRawBytes() const {
+            return rawBytes.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the number of bytes written to the file, including the headers
+         * */
+        uint64_t getCompressedBytes() const {
+            return compressedBytes.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class QueuedSink<CompressedSink, CompressedBlock>;
+        friend class SinkBuffer<CompressedSink>;
+
+        bool write(const char* data, size_t length) {
+            if(!file) {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> guard(lock);
+
+            if(queue.size() >= maxQueuedBlocks) {
+                if(dropWhenFull) {
+                    addDropped(1);
+                    return true;
+                }
+
+                //wait before copying anything, so a message never has another one in the middle of it
+                while(queue.size() >= maxQueuedBlocks && !stopping) {
+                    space.wait(guard);
+                }
+            }
+
+            rawBytes.fetch_add(length, std::memory_order_relaxed);
+            uint64_t nanoseconds;
+            uint64_t messageCount;
+
+            if(takePendingMessage(nanoseconds, messageCount) && index.isDue(nanoseconds, messageCount)) {
+                //a full block was sealed when it filled, so the message starts in the open block
+                TimeIndex::Entry entry;
+                entry.nanoseconds = nanoseconds;
+                entry.messageCount = messageCount;
+                entry.textOffset = current.text.size();
+                index.markDue(entry);
+                current.entries.push_back(entry);
+            }
+
+            while(length > 0) {
+                openCurrent();
+                size_t room = blockSize - current.text.size();
+                size_t count = length < room? length : room;
+                current.text.insert(current.text.end(), data, data + count);
+                data += count;
+                length -= count;
+
+                if(current.text.size() < blockSize) {
+                    break;
+                }
+
+                seal();
+            }
+
+            return true;
+        }
+
+        static size_t validBlockSize(size_t blockSize) {
+            return blockSize > 0 && blockSize <= LogCompression::MAX_BLOCK_SIZE? blockSize : 65536;
+        }
+
+        /**
+         * Compresses and writes @param block, on the background thread
+         * */
+        void process(CompressedBlock& block) {
+            encoded.clear();
+            LogCompression::encodeBlock(block.text.data(), block.text.size(), encoded);
+
+            //one write per block, so a crash tears at most this block
+            fwrite(encoded.data(), 1, encoded.size(), file);
+            fflush(file);
+
+            if(!block.entries.empty()) {
+                for(TimeIndex::Entry& entry : block.entries) {
+                    entry.fileOffset = fileOffset;
+                    index.write(entry);
+                }
+
+                index.flush();
+            }
+
+            fileOffset += encoded.size();
+            compressedBytes.fetch_add(encoded.size(), std::memory_order_relaxed);
+        }
+
+        SinkBuffer<CompressedSink> buffer;
+        size_t blockSize;
+        FILE* file = nullptr;
+
+        size_t maxQueuedBlocks = 2;
+        bool dropWhenFull = false;
+
+        //only touched by the background thread once the file is open
+        std::vector<char> encoded;
+        uint64_t fileOffset = LogCompression::FILE_HEADER_SIZE;
+        TimeIndex::Writer index;
+        std::atomic<bool> indexing{ false };
+
+        std::atomic<uint64_t> rawBytes{ 0 };
+        std::atomic<uint64_t> compressedBytes{ 0 };
+};
+
+#endif
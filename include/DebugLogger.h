@@ -10,15 +10,65 @@
 #include <sstream>
 #include <math.h>
 #include <cmath>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+#include <climits>
+#include <time.h>
 
 #include "Timer.h"
+#include "LogSink.h"
 
 #if defined(WIN32) | defined(__WIN32) || defined (_WIN32)
+#include <io.h>
 #define SPRINTF(buffer, format, value) sprintf_s(buffer, 128, format, value)
+#define ISATTY(fd) _isatty(fd)
+#define LOCALTIME(time, result) localtime_s(&(result), &(time))
 #elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
 #define SPRINTF(buffer, format, value) sprintf(buffer, format, value)
+#define ISATTY(fd) isatty(fd)
+#define LOCALTIME(time, result) localtime_r(&(time), &(result))
 #endif
 
+//thread and process identity for the tid, tname, pid and cpu variables
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#if defined(__has_include) && defined(__has_builtin)
+#if __has_include(<sys/rseq.h>) && __has_builtin(__builtin_thread_pointer)
+#include <sys/rseq.h>
+#define DEBUGLOGGER_RSEQ 1
+#endif
+#endif
+#elif defined(__APPLE__)
+#include <pthread.h>
+#elif defined(WIN32) | defined(__WIN32) || defined (_WIN32)
+#include <process.h>
+//windows.h without its min and max macros, which would break std::min and std::max in the code including this header
+#ifndef NOMINMAX
+#define NOMINMAX
+#define DEBUGLOGGER_NOMINMAX 1
+#endif
+#include <windows.h>
+#ifdef DEBUGLOGGER_NOMINMAX
+#undef NOMINMAX
+#undef DEBUGLOGGER_NOMINMAX
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEBUGLOGGER_SSE2 1
+#endif
+
+constexpr int STDOUT_FD = 1;
+constexpr int STDERR_FD = 2;
+
 constexpr int OUTPUTFORMAT_DECIMAL = 0;
 constexpr int OUTPUTFORMAT_HEX = 1;
 constexpr int OUTPUTFORMAT_UPPERHEX = 2;
@@ -26,6 +76,8 @@ constexpr int OUTPUTFORMAT_BIN = 3;
 constexpr int CAPITALIZEDFORMAT_NONE = 0;
 constexpr int CAPITALIZEDFORMAT_CAPS = 1;
 constexpr int CAPITALIZEDFORMAT_LOWER = 2;
+constexpr const char* COLOR_RESET = "\033[0m";
+constexpr const char* DEFAULT_PREFIX = "[3ln]~[.2etl] \\[[>05lmc]\\]: ";
 
 /**
  * Levels for debugging
@@ -44,6 +96,18 @@ enum class Level {
     LEVEL_COUNT
 };
 
+/**
+ * When the logger writes color escape sequences
+ * AUTO: only when the output is a standard stream attached to a terminal
+ * ALWAYS: on every output, including files and pipes
+ * NEVER: colors are never written
+ * */
+enum class ColorMode {
+    AUTO,
+    ALWAYS,
+    NEVER
+};
+
 /**
  * all the valid types for debug variables
  * INTEGER32: a 32 bit integer
@@ -51,6 +115,7 @@ enum class Level {
  * FLOAT32: a 32 bit floating point value
  * FLOAT64: a 64 bit floating point value
  * STRING: an instance of std::string
+ * CSTRING: a const char* (the variable points to the pointer, so the text can be swapped out)
  * @author Bryce Young 5/19/2021
  * */
 enum class DebugVarType {
@@ -60,495 +125,2299 @@ enum class DebugVarType {
     FLOAT32,
     FLOAT64,
     STRING,
+    CSTRING,
+    FUNCTION,
+    ATOMIC_INTEGER64,
+    ATOMIC_FLOAT64,
+    SEQLOCK_STRING,
     DEBUGVAR_TYPE_COUNT
 };
 
 /**
- * Class to interface with the logger
- * CFG doc:
- * 
- * Capitalize any output by prefixing with ^
- * 
- * @author Bryce Young 5/20/2021
+ * Where a log call is in the source code, printed by the call site variables sfl, sln and sfn
+ * Instances are meant to be static, one per call site (see Tracepoints.h)
  * */
-class DebugLogger {
+struct CallSite {
+    constexpr CallSite(const char* file, int line, const char* function, const char* format)
+        :file(file),
+        line(line),
+        function(function),
+        format(format)
+    {
+    }
+
+    const char* file;
+    int line;
+    const char* function;
+    const char* format;
+};
+
+/**
+ * A variable whose value is computed by a function when a message that uses it is printed
+ * Each logger has its own, copying a logger copies its callback variables, so the memoized value is that of the logger's own messages
+ * See DebugLogger::addCallbackVariable
+ * */
+class CallbackVariable {
     public:
-        DebugLogger(const std::string& loggerName = "Debug", Level level = Level::LEVEL_TRACE) 
-            :level(level),
-            targetStream(&std::cout)
+        CallbackVariable(DebugVarType resultType, bool memoize, bool unsignedResult = false)
+            :resultType(resultType),
+            memoize(memoize),
+            unsignedResult(unsignedResult)
         {
-            this->loggerName = loggerName;
-            this->level = Level::CRITICAL_ERROR;
-            totalNanoseconds = 0;
-
-            for(int i = 0; i <= (int)Level::LEVEL_COUNT; ++i) {
-                messageCount[i] = 0;
-            }
-
-            levelNames[(int)Level::LEVEL_TRACE] = "TCE";
-            levelNames[(int)Level::LEVEL_WARNING] = "WNG";
-            levelNames[(int)Level::LEVEL_ERROR] = "ERR";
-            levelNames[(int)Level::CRITICAL_ERROR] = "CRT";
-            levelNames[(int)Level::LEVEL_COUNT] = levelNames[(int)Level::LEVEL_TRACE];
-
-            //add default variables
-            //th = time hours
-            //tm = time minutes
-            //ts = time seconds
-            //tl = time milliseconds
-            //ti = time microseconds
-            addInternalVariable("th", timeVars + 0, DebugVarType::FLOAT64);
-            addInternalVariable("tm", timeVars + 1, DebugVarType::FLOAT64);
-            addInternalVariable("ts", timeVars + 2, DebugVarType::FLOAT64);
-            addInternalVariable("tl", timeVars + 3, DebugVarType::FLOAT64);
-            addInternalVariable("ti", timeVars + 4, DebugVarType::FLOAT64);
-
-            //eth = elapsed time hours
-            //etm = elapsed time minutes
-            //ets = elapsed time seconds
-            //etl = elapsed time milliseconds
-            //eti = elapsed time microseconds
-            addInternalVariable("eth", elapsedTimeVars + 0, DebugVarType::FLOAT64);
-            addInternalVariable("etm", elapsedTimeVars + 1, DebugVarType::FLOAT64);
-            addInternalVariable("ets", elapsedTimeVars + 2, DebugVarType::FLOAT64);
-            addInternalVariable("etl", elapsedTimeVars + 3, DebugVarType::FLOAT64);
-            addInternalVariable("eti", elapsedTimeVars + 4, DebugVarType::FLOAT64);
-
-            //the name of the logger program
-            addInternalVariable("pn", &this->loggerName, DebugVarType::STRING);
-
-            //the name of the levels
-            //tn = trace name
-            //wn = warning name
-            //en = error name
-            //cn = critical name
-            //ln = current level name
-            addInternalVariable("tn", &this->levelNames[(int)Level::LEVEL_TRACE], DebugVarType::STRING);
-            addInternalVariable("wn", &this->levelNames[(int)Level::LEVEL_WARNING], DebugVarType::STRING);
-            addInternalVariable("en", &this->levelNames[(int)Level::LEVEL_ERROR], DebugVarType::STRING);
-            addInternalVariable("cn", &this->levelNames[(int)Level::CRITICAL_ERROR], DebugVarType::STRING);
-            addInternalVariable("ln", &this->levelNames[(int)Level::LEVEL_COUNT], DebugVarType::STRING);
-
-            //variables for message count
-            //dmc stands for debug message count
-            addInternalVariable("dmc", &messageCount[(int)Level::LEVEL_COUNT], DebugVarType::INTEGER64);
-
-            //tmc stands for trace message count
-            //wmc warning message count
-            //emc error message count
-            //cmc critical messageCount
-            addInternalVariable("tmc", &messageCount[(int)Level::LEVEL_TRACE], DebugVarType::INTEGER64);
-            addInternalVariable("wmc", &messageCount[(int)Level::LEVEL_WARNING], DebugVarType::INTEGER64);
-            addInternalVariable("emc", &messageCount[(int)Level::LEVEL_ERROR], DebugVarType::INTEGER64);
-            addInternalVariable("cmc", &messageCount[(int)Level::CRITICAL_ERROR], DebugVarType::INTEGER64);
-
-            //level message count
-            addInternalVariable("lmc", &currentMessageCount, DebugVarType::INTEGER64);
-
-            //helpful characters
-            addInternalVariable("lbc", &specialCharacters[0], DebugVarType::CHAR);
-            addInternalVariable("rbc", &specialCharacters[1], DebugVarType::CHAR);
-            addInternalVariable("lbk", &specialCharacters[2], DebugVarType::CHAR);
-            addInternalVariable("rbk", &specialCharacters[3], DebugVarType::CHAR);
-            addInternalVariable("bks", &specialCharacters[4], DebugVarType::CHAR);
-
-            //char pnemonics
-            reserves["char"] = Token::TokenType::SIGNED_CHAR;
-            reserves["ch"] = Token::TokenType::SIGNED_CHAR;
-            reserves["c"] = Token::TokenType::SIGNED_CHAR;
-
-            //int pnemonics
-            reserves["int"] = Token::TokenType::SIGNED_INT;
-            reserves["i"] = Token::TokenType::SIGNED_INT;
-            reserves["d"] = Token::TokenType::SIGNED_INT;
-            reserves["uint"] = Token::TokenType::SIGNED_INT;
-            reserves["ui"] = Token::TokenType::SIGNED_INT;
-            reserves["u"] = Token::TokenType::SIGNED_INT;
-
-            //long pneumonics
-            reserves["long"] = Token::TokenType::SIGNED_LONG;
-            reserves["llu"] = Token::TokenType::SIGNED_LONG;
-            reserves["ulong"] = Token::TokenType::SIGNED_LONG;
-            reserves["ul"] = Token::TokenType::SIGNED_LONG;
-
-            //float pnemoinics
-            reserves["float"] = Token::TokenType::FLOAT;
-            reserves["flt"] = Token::TokenType::FLOAT;
-            reserves["f"] = Token::TokenType::FLOAT;
-
-            //str pneumonics
-            reserves["string"] = Token::TokenType::STRING;
-            reserves["str"] = Token::TokenType::STRING;
-            reserves["s"] = Token::TokenType::STRING;
-
-            setPrefix("[3ln]~[.2etl] \\[[>05lmc]\\]: ");
-            timer.reset();
         }
 
-        ~DebugLogger() {
+        virtual ~CallbackVariable() {}
+
+        /**
+         * Returns a new callback variable calling a copy of the same function, with nothing memoized yet
+         * */
+        virtual CallbackVariable* clone() const = 0;
+
+        /**
+         * Returns a pointer to the value for message number @param message, typed as getResultType()
+         * When memoized, the function is only called once per message
+         * */
+        void* get(long long message) {
+            if(!memoize || message != lastMessage || !value) {
+                value = evaluate();
+                lastMessage = message;
+            }
+
+            return value;
         }
 
-        void setTargetOutput(std::ostream* outputStream) {
-            this->targetStream = outputStream;
+        /**
+         * Calls the function even if it was already called for @param message, and keeps the result for that message
+         * */
+        void* refresh(long long message) {
+            value = evaluate();
+            lastMessage = message;
+            return value;
+        }
+
+        DebugVarType getResultType() const {
+            return resultType;
         }
 
         /**
-         * Returns the level of the debugger
+         * Returns true if the function returns an unsigned integer, which prints as unsigned
          * */
-        Level getLevel() const {
-            return level;
+        bool isUnsigned() const {
+            return unsignedResult;
+        }
+
+        bool isMemoized() const {
+            return memoize;
         }
 
+    protected:
         /**
-         * Updates level
-         * @param newLevel: the new level
+         * Calls the function and returns a pointer to the stored result
          * */
-        void setLevel(Level newLevel) {
-            this->level = newLevel;
+        virtual void* evaluate() = 0;
+
+    private:
+        DebugVarType resultType;
+        bool memoize;
+        bool unsignedResult;
+        long long lastMessage = -1;
+        void* value = nullptr;
+};
+
+/**
+ * How the result of a callback variable is stored and printed
+ * Integers print as INTEGER64, floating point as FLOAT64, char as CHAR, C strings as CSTRING and everything else as a std::string
+ * */
+template<typename T, bool Integral = std::is_integral<T>::value, bool Floating = std::is_floating_point<T>::value>
+struct CallbackResult {
+    typedef std::string Type;
+    static DebugVarType type() { return DebugVarType::STRING; }
+};
+
+template<typename T>
+struct CallbackResult<T, true, false> {
+    typedef long long Type;
+    static DebugVarType type() { return DebugVarType::INTEGER64; }
+};
+
+template<>
+struct CallbackResult<char, true, false> {
+    typedef char Type;
+    static DebugVarType type() { return DebugVarType::CHAR; }
+};
+
+template<typename T>
+struct CallbackResult<T, false, true> {
+    typedef double Type;
+    static DebugVarType type() { return DebugVarType::FLOAT64; }
+};
+
+template<>
+struct CallbackResult<const char*, false, false> {
+    typedef const char* Type;
+    static DebugVarType type() { return DebugVarType::CSTRING; }
+};
+
+template<>
+struct CallbackResult<char*, false, false> {
+    typedef const char* Type;
+    static DebugVarType type() { return DebugVarType::CSTRING; }
+};
+
+/**
+ * A CallbackVariable calling any function object that takes no arguments
+ * */
+template<typename Function>
+class FunctionVariable : public CallbackVariable {
+    public:
+        typedef typename std::decay<decltype(std::declval<Function&>()())>::type ReturnType;
+        typedef CallbackResult<ReturnType> Result;
+
+        FunctionVariable(Function function, bool memoize)
+            :CallbackVariable(Result::type(), memoize, std::is_unsigned<ReturnType>::value),
+            function(function)
+        {
         }
 
-        void setColorTrace(std::ostream& outputStream) {
-            if(enableColor) {
-                //outputStream << "\033[34m"; //blue
-                //outputStream << "\033[32m"; //green
-                //outputStream << "\033[1m\033[34m"; //dark blue
-                outputStream << "\033[1m\033[32m"; //dark green
+        CallbackVariable* clone() const override {
+            return new FunctionVariable(function, isMemoized());
+        }
+
+    protected:
+        void* evaluate() override {
+            result = (typename Result::Type)function();
+            return &result;
+        }
+
+    private:
+        Function function;
+        typename Result::Type result;
+};
+
+/**
+ * A string that other threads can replace while loggers print it, without either side blocking the other
+ * Writers take turns through a sequence number, readers copy the text and retry if a write happened during the copy
+ * Text longer than CAPACITY - 1 characters is truncated
+ * */
+class SeqlockString {
+    public:
+        static constexpr size_t CAPACITY = 128;
+
+        SeqlockString(const char* text = "") {
+            set(text);
+        }
+
+        /**
+         * Replaces the text, safe to call from any thread
+         * */
+        void set(const char* text) {
+            set(text, strlen(text));
+        }
+
+        void set(const std::string& text) {
+            set(text.c_str(), text.size());
+        }
+
+        void set(const char* text, size_t length) {
+            char buffer[CAPACITY] = { 0 };
+            memcpy(buffer, text, length < CAPACITY? length : CAPACITY - 1);
+
+            //an odd sequence number marks a write in progress
+            uint32_t current = sequence.load(std::memory_order_relaxed);
+
+            while((current & 1) || !sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                current = sequence.load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for(size_t i = 0; i < WORD_COUNT; ++i) {
+                uint64_t word;
+                memcpy(&word, buffer + i * sizeof(uint64_t), sizeof(uint64_t));
+                words[i].store(word, std::memory_order_relaxed);
+            }
+
+            sequence.store(current + 2, std::memory_order_release);
+        }
+
+        /**
+         * Copies the text into @param out, which holds CAPACITY characters
+         * */
+        void get(char* out) const {
+            uint64_t copy[WORD_COUNT];
+            uint32_t before;
+
+            do {
+                before = sequence.load(std::memory_order_acquire);
+
+                for(size_t i = 0; i < WORD_COUNT; ++i) {
+                    copy[i] = words[i].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while((before & 1) || sequence.load(std::memory_order_relaxed) != before);
+
+            memcpy(out, copy, CAPACITY);
+            out[CAPACITY - 1] = 0;
+        }
+
+        std::string get() const {
+            char text[CAPACITY];
+            get(text);
+            return text;
+        }
+
+    private:
+        static constexpr size_t WORD_COUNT = CAPACITY / sizeof(uint64_t);
+
+        std::atomic<uint32_t> sequence{ 0 };
+        std::atomic<uint64_t> words[WORD_COUNT];
+};
+
+/**
+ * The DebugVarType of a variable of type T, used by the addVariable template
+ * Only types the logger can read correctly are supported, everything else fails to compile
+ * */
+template<typename T, typename Enable = void>
+struct VariableType {
+    static constexpr bool SUPPORTED = false;
+    static DebugVarType type() { return DebugVarType::DEBUGVAR_TYPE_COUNT; }
+};
+
+template<>
+struct VariableType<char> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::CHAR; }
+};
+
+template<typename T>
+struct VariableType<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 4>::type> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::INTEGER32; }
+};
+
+template<typename T>
+struct VariableType<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8>::type> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::INTEGER64; }
+};
+
+template<>
+struct VariableType<float> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::FLOAT32; }
+};
+
+template<>
+struct VariableType<double> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::FLOAT64; }
+};
+
+template<>
+struct VariableType<std::string> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::STRING; }
+};
+
+template<>
+struct VariableType<const char*> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::CSTRING; }
+};
+
+template<>
+struct VariableType<char*> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::CSTRING; }
+};
+
+template<typename T>
+struct VariableType<std::atomic<T>, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8>::type> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::ATOMIC_INTEGER64; }
+};
+
+template<>
+struct VariableType<std::atomic<double>> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::ATOMIC_FLOAT64; }
+};
+
+template<>
+struct VariableType<SeqlockString> {
+    static constexpr bool SUPPORTED = true;
+    static DebugVarType type() { return DebugVarType::SEQLOCK_STRING; }
+};
+
+/**
+ * Per-thread stack of named values (a mapped diagnostic context), printed by [ctx.name] in formats and prefixes
+ * Values are pushed by ScopedContext guards. Pushing and popping is O(1) and copies the value into the stack, nothing is allocated
+ * When a name is pushed more than once the newest value is printed. Entries deeper than MAX_DEPTH are counted but not kept
+ * ```
+ * ScopedContext request("request", requestId);
+ * ScopedContext user("user", userName);
+ * logger.trace("[ctx.request] [ctx.user] loaded {int} rows", rows);
+ * ```
+ * */
+class LogContext {
+    public:
+        static constexpr int MAX_DEPTH = 32;
+        static constexpr size_t TEXT_SIZE = 64;
+
+        struct Entry {
+            //not copied, usually a string literal
+            const char* name;
+            //CSTRING, INTEGER64 or FLOAT64
+            DebugVarType type;
+            long long integer;
+            double number;
+            //what a CSTRING DebugVar points to, always text
+            const char* textPointer;
+            char text[TEXT_SIZE];
+        };
+
+        /**
+         * Adds an entry named @param name to this thread's stack
+         * @return the entry to fill in, nullptr when the stack is full
+         * */
+        static Entry* push(const char* name) {
+            Stack& s = stack();
+            Entry* entry = nullptr;
+
+            if(s.depth < MAX_DEPTH) {
+                entry = &s.entries[s.depth];
+                entry->name = name;
+                entry->textPointer = entry->text;
+            }
+
+            s.depth++;
+            return entry;
+        }
+
+        static void pop() {
+            stack().depth--;
+        }
+
+        /**
+         * Returns the newest entry named by the @param length characters of @param name, nullptr if there is none
+         * */
+        static const Entry* find(const char* name, size_t length) {
+            Stack& s = stack();
+
+            for(int i = (s.depth < MAX_DEPTH? s.depth : MAX_DEPTH) - 1; i >= 0; --i) {
+                const char* entryName = s.entries[i].name;
+
+                if(strncmp(entryName, name, length) == 0 && entryName[length] == 0) {
+                    return &s.entries[i];
+                }
+            }
+
+            return nullptr;
+        }
+
+        /**
+         * Returns the number of entries pushed on this thread, including the ones past MAX_DEPTH
+         * */
+        static int getDepth() {
+            return stack().depth;
+        }
+
+        /**
+         * Returns where a DebugVar of @param entry's type reads its value
+         * */
+        static void* valueOf(const Entry& entry) {
+            switch(entry.type) {
+                case DebugVarType::INTEGER64:
+                    return (void*)&entry.integer;
+                case DebugVarType::FLOAT64:
+                    return (void*)&entry.number;
+                default:
+                    return (void*)&entry.textPointer;
+            }
+        }
+
+    private:
+        struct Stack {
+            Entry entries[MAX_DEPTH];
+            int depth;
+        };
+
+        //plain data, so the thread_local needs no constructor or guard
+        static Stack& stack() {
+            static thread_local Stack s;
+            return s;
+        }
+};
+
+/**
+ * Pushes a value onto this thread's LogContext for the life of the guard
+ * Text longer than LogContext::TEXT_SIZE - 1 characters is truncated. @param name is not copied and must outlive the guard
+ * */
+class ScopedContext {
+    public:
+        ScopedContext(const char* name, const char* value) {
+            setText(LogContext::push(name), value? value : "", value? strlen(value) : 0);
+        }
+
+        ScopedContext(const char* name, const std::string& value) {
+            setText(LogContext::push(name), value.c_str(), value.size());
+        }
+
+        template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        ScopedContext(const char* name, T value) {
+            LogContext::Entry* entry = LogContext::push(name);
+
+            if(entry) {
+                entry->type = DebugVarType::INTEGER64;
+                entry->integer = (long long)value;
+            }
+        }
+
+        ScopedContext(const char* name, double value) {
+            LogContext::Entry* entry = LogContext::push(name);
+
+            if(entry) {
+                entry->type = DebugVarType::FLOAT64;
+                entry->number = value;
+            }
+        }
+
+        ~ScopedContext() {
+            LogContext::pop();
+        }
+
+        ScopedContext(const ScopedContext&) = delete;
+        ScopedContext& operator=(const ScopedContext&) = delete;
+
+    private:
+        static void setText(LogContext::Entry* entry, const char* value, size_t length) {
+            if(!entry) {
+                return;
+            }
+
+            if(length > LogContext::TEXT_SIZE - 1) {
+                length = LogContext::TEXT_SIZE - 1;
+            }
+
+            entry->type = DebugVarType::CSTRING;
+            memcpy(entry->text, value, length);
+            entry->text[length] = 0;
+        }
+};
+
+/**
+ * Receives every log call made on a DebugLogger, before the level is checked
+ * See FlightRecorder.h
+ * */
+class LogRecorder {
+    public:
+        virtual ~LogRecorder() {}
+
+        /**
+         * Called for every message on @param lev, whether or not it is printed
+         * @param args the arguments of the message, copy them with va_copy before reading
+         * */
+        virtual void record(Level lev, const char* format, va_list& args) = 0;
+};
+
+/**
+ * Supplies the [metric.name] variables of a DebugLogger
+ * See Metrics.h
+ * */
+class MetricSource {
+    public:
+        virtual ~MetricSource() {}
+
+        /**
+         * Looks up the value named by the @param length characters of @param name, the part after "metric."
+         * @return INTEGER64 with the value in @param integer, FLOAT64 with the value in @param number,
+         * or DEBUGVAR_TYPE_COUNT if there is no such value
+         * */
+        virtual DebugVarType getMetric(const char* name, size_t length, uint64_t& integer, double& number) = 0;
+};
+
+/**
+ * The value of a variable read at one point in time, see DebugLogger::snapshotVariable()
+ * */
+struct VariableSnapshot {
+    //INTEGER64, FLOAT64 or STRING, the type the value prints as
+    DebugVarType type = DebugVarType::DEBUGVAR_TYPE_COUNT;
+    uint64_t integer = 0;
+    double number = 0;
+    std::string text;
+
+    /**
+     * Returns the value as a variable of the snapshot's type points to it, see DebugLogger::addVariable()
+     * */
+    void* value() {
+        return type == DebugVarType::INTEGER64? (void*)&integer : type == DebugVarType::FLOAT64? (void*)&number : (void*)&text;
+    }
+
+    //numbers compare by their bits, so a NaN equals itself
+    bool operator==(const VariableSnapshot& other) const {
+        return type == other.type && integer == other.integer && memcmp(&number, &other.number, sizeof(number)) == 0 && text == other.text;
+    }
+
+    bool operator!=(const VariableSnapshot& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * A snapshot of what logging costs a DebugLogger, see DebugLogger::enableInstrumentation
+ * */
+struct LoggerStats {
+    static constexpr int SLOW_FORMAT_COUNT = 8;
+
+    /**
+     * A format and the longest it has taken to format
+     * */
+    struct SlowFormat {
+        const char* format = nullptr;
+        uint64_t nanoseconds = 0;
+    };
+
+    //time spent building messages and writing them to the output
+    uint64_t formatNanoseconds = 0;
+    uint64_t writeNanoseconds = 0;
+
+    //bytes written on each level, bytes[LEVEL_COUNT] is every level
+    uint64_t bytes[(int)Level::LEVEL_COUNT + 1] = { 0 };
+
+    //messages filtered out by the level
+    uint64_t suppressed = 0;
+
+    //filled in from the target output when it is a LogSink
+    uint64_t queueDepth = 0;
+    uint64_t queueHighWater = 0;
+    uint64_t dropped = 0;
+
+    //the slowest formats, slowest first
+    SlowFormat slowest[SLOW_FORMAT_COUNT];
+};
+
+/**
+ * Owns an optional part of a logger, like std::unique_ptr, but copies what it points to when it is copied
+ * so the logger stays copyable and each copy has its own
+ * */
+template<typename T>
+class CopiedPointer {
+    public:
+        CopiedPointer() {}
+
+        CopiedPointer(const CopiedPointer& other)
+            :value(other.value? new T(*other.value) : nullptr)
+        {
+        }
+
+        CopiedPointer& operator=(const CopiedPointer& other) {
+            if(this != &other) {
+                value.reset(other.value? new T(*other.value) : nullptr);
             }
+
+            return *this;
+        }
+
+        CopiedPointer(CopiedPointer&&) = default;
+        CopiedPointer& operator=(CopiedPointer&&) = default;
+
+        T* get() const {
+            return value.get();
+        }
+
+        T* operator->() const {
+            return value.get();
+        }
+
+        T& operator*() const {
+            return *value;
+        }
+
+        explicit operator bool() const {
+            return value != nullptr;
+        }
+
+        void reset(T* replacement = nullptr) {
+            value.reset(replacement);
+        }
+
+    private:
+        std::unique_ptr<T> value;
+};
+
+/**
+ * Class to interface with the logger
+ * CFG doc:
+ * 
+ * Capitalize any output by prefixing with ^
+ * 
+ * @author Bryce Young 5/20/2021
+ * */
+class DebugLogger {
+    friend class LoggerRegistry;
+
+    public:
+        //the most bytes a {hexdump} line can hold, larger counts print this many per line
+        static constexpr int MAX_HEXDUMP_LINE = 64;
+
+        DebugLogger(const std::string& loggerName = "Debug", Level level = Level::LEVEL_TRACE) 
+            :level(level),
+            loggerName(loggerName),
+            targetStream(&std::cout)
+        {
+            this->level = Level::CRITICAL_ERROR;
+            updateColorActive();
+            timer.reset();
+        }
+
+        ~DebugLogger() {
+        }
+
+        void setTargetOutput(std::ostream* outputStream) {
+            this->targetStream = outputStream;
+            this->targetSink = dynamic_cast<LogSink*>(outputStream);
+            updateColorActive();
+        }
+
+        /**
+         * Sends every log call to @param newRecorder, including the ones filtered out by the level
+         * Pass nullptr to stop recording
+         * */
+        void setRecorder(LogRecorder* newRecorder) {
+            this->recorder = newRecorder;
+        }
+
+        /**
+         * Resolves [metric.name] variables through @param source, pass nullptr to stop
+         * */
+        void setMetrics(MetricSource* source) {
+            this->metrics = source;
+        }
+
+        MetricSource* getMetrics() const {
+            return metrics;
+        }
+
+        /**
+         * Starts or stops measuring the logger itself: time spent formatting and writing, bytes per level,
+         * suppressed messages and the slowest formats. The values are in the internal variables fns, wns, tby, wby, eby, cby, dby, sup
+         * and in getStats(). Costs two extra clock reads per printed message while enabled
+         * Disabling clears the measurements
+         * */
+        void enableInstrumentation(bool enable = true) {
+            instrumentation.reset();
+
+            if(enable) {
+                //calibrate the clock now rather than during the first message
+                TscClock::getCalibration();
+                instrumentation.reset(new LoggerStats());
+            }
+        }
+
+        bool getInstrumentationEnabled() const {
+            return (bool)instrumentation;
+        }
+
+        /**
+         * Returns the measurements of the logger, all zero if instrumentation is disabled
+         * The queue values come from the target output if it is a LogSink
+         * */
+        LoggerStats getStats() const {
+            LoggerStats stats;
+
+            if(instrumentation) {
+                stats = *instrumentation;
+            }
+
+            if(targetSink) {
+                stats.queueDepth = targetSink->getQueueDepth();
+                stats.queueHighWater = targetSink->getQueueHighWater();
+                stats.dropped = targetSink->getDropped();
+            }
+
+            return stats;
+        }
+
+        /**
+         * Lists the types of the arguments read by @param format in the order they are read
+         * c: char, i: 32 bit int, u: unsigned 32 bit int, l: 64 bit int, L: unsigned 64 bit int, f: double, s: const char*
+         * p: the pointer of an array argument, always followed by z: its size_t element count
+         * @param types receives at most @param maxTypes types
+         * @return the number of arguments, which can be more than maxTypes
+         * */
+        static int getArgumentTypes(const char* format, char* types, int maxTypes) {
+            int count = 0;
+
+            for(int index = 0; format[index]; ++index) {
+                if(format[index] == '\\') {
+                    if(format[index + 1]) {
+                        index++;
+                    }
+
+                    continue;
+                }
+
+                if(format[index] != '{') {
+                    continue;
+                }
+
+                //the type is the reserve among the formatting options, a quote starts a sub-format whose arguments are read from its text
+                char type = 0;
+                bool unsignedValue = false;
+                bool array = false;
+                index++;
+
+                while(format[index] && format[index] != '}' && format[index] != '\'') {
+                    char c = format[index];
+
+                    //array arguments read a pointer and a size_t, skip the separator between the brackets
+                    if(c == '[') {
+                        array = true;
+
+                        while(format[index] && format[index] != ']') {
+                            if(format[index] == '\\' && format[index + 1]) {
+                                index++;
+                            }
+
+                            index++;
+                        }
+
+                        if(format[index]) {
+                            index++;
+                        }
+
+                        continue;
+                    }
+
+                    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+                        int start = index;
+
+                        while((format[index] >= 'a' && format[index] <= 'z') || (format[index] >= 'A' && format[index] <= 'Z') || format[index] == '_' || (format[index] >= '0' && format[index] <= '9')) {
+                            index++;
+                        }
+
+                        const Reserve* reserve = findReserve(std::string(format + start, format + index));
+
+                        if(reserve) {
+                            unsignedValue = unsignedValue || format[start] == 'u';
+
+                            switch(reserve->type) {
+                                case Token::TokenType::SIGNED_CHAR: type = 'c'; break;
+                                case Token::TokenType::SIGNED_INT: type = 'i'; break;
+                                case Token::TokenType::SIGNED_LONG: type = 'l'; break;
+                                case Token::TokenType::FLOAT: type = 'f'; break;
+                                case Token::TokenType::STRING: type = 's'; break;
+                                case Token::TokenType::HEXDUMP: type = 'h'; array = true; break;
+                                case Token::TokenType::STRING_LENGTH: type = 's'; array = true; break;
+                                default: break;
+                            }
+                        }
+
+                        continue;
+                    }
+
+                    unsignedValue = unsignedValue || c == '+';
+                    index++;
+                }
+
+                if(type && array) {
+                    if(count < maxTypes) {
+                        types[count] = 'p';
+                    }
+
+                    if(count + 1 < maxTypes) {
+                        types[count + 1] = 'z';
+                    }
+
+                    count += 2;
+                }
+                else if(type) {
+                    if(unsignedValue && type == 'i') {
+                        type = 'u';
+                    }
+                    else if(unsignedValue && type == 'l') {
+                        type = 'L';
+                    }
+
+                    if(count < maxTypes) {
+                        types[count] = type;
+                    }
+
+                    count++;
+                }
+
+                if(!format[index]) {
+                    break;
+                }
+            }
+
+            return count;
+        }
+
+        /**
+         * Returns the level of the debugger
+         * */
+        Level getLevel() const {
+            return level;
+        }
+
+        /**
+         * Updates level
+         * @param newLevel: the new level
+         * */
+        void setLevel(Level newLevel) {
+            this->level = newLevel;
+        }
+
+        void setColorTrace(std::ostream& outputStream) {
+            if(getColorEnabled(&outputStream)) {
+                outputStream << getLevelColor(Level::LEVEL_TRACE);
+            }
+        }
+
+        void setColorWarning(std::ostream& outputStream) {
+            if(getColorEnabled(&outputStream)) {
+                outputStream << getLevelColor(Level::LEVEL_WARNING);
+            }
+        }
+
+        void setColorError(std::ostream& outputStream) {
+            if(getColorEnabled(&outputStream)) {
+                outputStream << getLevelColor(Level::LEVEL_ERROR);
+            }
+        }
+
+        void setColorCritical(std::ostream& outputStream) {
+            if(getColorEnabled(&outputStream)) {
+                outputStream << getLevelColor(Level::CRITICAL_ERROR);
+            }
+        }
+
+        void resetColor(std::ostream& outputStream) {
+            if(getColorEnabled(&outputStream)) {
+                outputStream << COLOR_RESET;
+            }
+        }
+
+        /**
+         * Always prints colors, even if the output is a file or a pipe
+         * */
+        void setColorEnabled() {
+            this->colorMode = ColorMode::ALWAYS;
+            updateColorActive();
+        }
+
+        void setColorDisabled() {
+            this->colorMode = ColorMode::NEVER;
+            updateColorActive();
+        }
+
+        /**
+         * Prints colors only when the output stream is std::cout, std::cerr or std::clog and that stream is a terminal (default)
+         * */
+        void setColorAuto() {
+            this->colorMode = ColorMode::AUTO;
+            updateColorActive();
+        }
+
+        ColorMode getColorMode() const {
+            return this->colorMode;
+        }
+
+        /**
+         * Returns whether colors are written to the target output
+         * */
+        bool getColorEnabled() {
+            return this->colorActive;
+        }
+
+        /**
+         * Returns whether colors would be written to @param outputStream
+         * */
+        bool getColorEnabled(std::ostream* outputStream) {
+            if(outputStream == this->targetStream) {
+                return this->colorActive;
+            }
+
+            return colorMode == ColorMode::ALWAYS || (colorMode == ColorMode::AUTO && isTerminal(outputStream));
+        }
+
+        /**
+         * Returns the escape sequence written before messages on @param lev
+         * */
+        static const char* getLevelColor(Level lev) {
+            static const char* const colors[(int)Level::LEVEL_COUNT + 1] = {
+                "",
+                "\033[1m\033[32m", //dark green
+                "\033[1m\033[33m", //dark yellow
+                "\033[1m\033[31m", //dark red
+                "\033[1m\033[31m", //dark red
+                ""
+            };
+
+            return colors[(int)lev];
+        }
+
+        /**
+         * Returns whether the stream writes to a terminal
+         * Only the standard streams can be traced back to a file descriptor, every other stream is treated as a file
+         * isatty is only called once per standard stream
+         * */
+        static bool isTerminal(const std::ostream* outputStream) {
+            static const bool stdoutTerminal = ISATTY(STDOUT_FD) != 0;
+            static const bool stderrTerminal = ISATTY(STDERR_FD) != 0;
+
+            if(outputStream == &std::cout) {
+                return stdoutTerminal;
+            }
+            if(outputStream == &std::cerr || outputStream == &std::clog) {
+                return stderrTerminal;
+            }
+
+            return false;
+        }
+        
+        /**
+         * Returns the number of characters printHexdump() prints for @param length bytes at @param bytesPerLine
+         * */
+        static size_t hexdumpSize(size_t length, int bytesPerLine) {
+            HexdumpLayout layout(length, bytesPerLine);
+            size_t lines = (length + layout.bytesPerLine - 1) / layout.bytesPerLine;
+
+            //every line is full width up to the ascii column, which holds the line's bytes
+            return lines * (size_t)(layout.asciiStart + 2) + length;
+        }
+
+        /**
+         * Prints @param length bytes at @param data as a hexdump, one line per @param bytesPerLine bytes (at most MAX_HEXDUMP_LINE):
+         * 00000000  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 0a 00 01  |Hello, world!...|
+         * Every line starts with a new line, so the dump sits under the message's prefix
+         * This is what {hexdump} prints, public so a dump can be written without a logger
+         * */
+        static void printHexdump(std::ostream& output, const unsigned char* data, size_t length, int bytesPerLine, bool upper) {
+            HexdumpLayout layout(length, bytesPerLine);
+            bytesPerLine = layout.bytesPerLine;
+            static const char lowerDigits[] = "0123456789abcdef";
+            static const char upperDigits[] = "0123456789ABCDEF";
+            const char* digits = upper? upperDigits : lowerDigits;
+            int offsetDigits = layout.offsetDigits;
+            int hexStart = layout.hexStart;
+            int asciiStart = layout.asciiStart;
+            int lineLength = layout.lineLength;
+            int columns[MAX_HEXDUMP_LINE];
+
+            for(int i = 0; i < bytesPerLine; ++i) {
+                columns[i] = hexStart + i * 3 + i / 8;
+            }
+
+            //whole lines are formatted into the buffer and written when the next one doesn't fit
+            char buffer[4096];
+            size_t used = 0;
+            char pairs[32];
+
+            for(size_t offset = 0; offset < length && data; offset += bytesPerLine) {
+                if(used + (size_t)lineLength > sizeof(buffer)) {
+                    output.write(buffer, (std::streamsize)used);
+                    used = 0;
+                }
+
+                int count = (int)std::min((size_t)bytesPerLine, length - offset);
+                const unsigned char* in = data + offset;
+                char* out = buffer + used;
+                memset(out, ' ', (size_t)lineLength);
+                out[0] = '\n';
+
+                for(int i = 0; i < offsetDigits; ++i) {
+                    out[offsetDigits - i] = digits[(offset >> (i * 4)) & 0xF];
+                }
+
+                out[asciiStart] = '|';
+                char* ascii = out + asciiStart + 1;
+
+                //16 bytes at a time, then one at a time for the rest of the line
+                int i = 0;
+                for(; i + 16 <= count; i += 16) {
+                    hexBlock(in + i, pairs, ascii + i, upper);
+
+                    for(int j = 0; j < 16; ++j) {
+                        memcpy(out + columns[i + j], pairs + j * 2, 2);
+                    }
+                }
+
+                for(; i < count; ++i) {
+                    out[columns[i]] = digits[in[i] >> 4];
+                    out[columns[i] + 1] = digits[in[i] & 0xF];
+                    ascii[i] = (in[i] >= 0x20 && in[i] < 0x7F)? (char)in[i] : '.';
+                }
+
+                ascii[count] = '|';
+                used += (size_t)(asciiStart + 2 + count);
+            }
+
+            output.write(buffer, (std::streamsize)used);
+        }
+
+        /**
+         * Sets how array arguments such as {f[]} are printed
+         * @param separator goes between elements when the argument doesn't set its own, up to 7 characters
+         * @param elementsPerLine starts a new line after that many elements, 0 to keep every element on one line
+         * */
+        void setArrayFormat(const char* separator = ", ", int elementsPerLine = 0) {
+            size_t length = std::min(strlen(separator), sizeof(state.arraySeparator) - 1);
+            memcpy(state.arraySeparator, separator, length);
+            state.arraySeparator[length] = 0;
+            state.arrayWrap = std::max(0, elementsPerLine);
+        }
+
+        /**
+         * There exist various variables which the prefix uses
+         * To use a variable, use two braces and write the name of the variable inside; constrast from the {} used for printing parameters passed into the function
+         * [ var_name ] -> with or without the spaces, it doesn't matter
+         * Basic formatting options within the braces apply
+         * Applies the prefix to all levels if @param targetLevel is omitted
+         * */
+        void setPrefix(const std::string& prefix, Level targetLevel = Level::LEVEL_COUNT) {
+            if(!this->prefixStorage) {
+                this->prefixStorage.reset(new PrefixStorage());
+            }
+
+            if(targetLevel == Level::LEVEL_COUNT) {
+                //a single copy is shared by every level
+                this->prefixStorage->prefixes[(int)Level::NONE] = prefix;
+                this->state.prefixSource[(int)Level::LEVEL_TRACE] = (char)Level::NONE;
+                this->state.prefixSource[(int)Level::LEVEL_WARNING] = (char)Level::NONE;
+                this->state.prefixSource[(int)Level::LEVEL_ERROR] = (char)Level::NONE;
+                this->state.prefixSource[(int)Level::CRITICAL_ERROR] = (char)Level::NONE;
+            }
+            else if(targetLevel < Level::LEVEL_COUNT && targetLevel >= Level::LEVEL_TRACE){
+                this->prefixStorage->prefixes[(int)targetLevel] = prefix;
+                this->state.prefixSource[(int)targetLevel] = (char)targetLevel;
+            }
+        }
+
+        /**
+         * Returns the prefix format used by @param targetLevel
+         * */
+        const char* getPrefix(Level targetLevel) const {
+            int source = state.prefixSource[(int)targetLevel];
+
+            if(source == PREFIX_DEFAULT) {
+                return DEFAULT_PREFIX;
+            }
+
+            return prefixStorage->prefixes[source].c_str();
+        }
+
+        int trace(const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(*this->targetStream, Level::LEVEL_TRACE, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int traceToStream(std::ostream& output, const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(output, Level::LEVEL_TRACE, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int warning(const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(*this->targetStream, Level::LEVEL_WARNING, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int warningToStream(std::ostream& output, const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(output, Level::LEVEL_WARNING, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int error(const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(*this->targetStream, Level::LEVEL_ERROR, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int errorToStream(std::ostream& output, const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(output, Level::LEVEL_ERROR, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int critical(const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(*this->targetStream, Level::CRITICAL_ERROR, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        int criticalToStream(std::ostream& output, const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            int ret = logLevel(output, Level::CRITICAL_ERROR, format, args);
+            va_end(args);
+            return ret;
+        }
+
+        /**
+         * Traces a message from a known call site, filling in the call site variables sfl, sln and sfn
+         * */
+        int traceSite(const CallSite& site, const char* format, ...) {
+            va_list args;
+            va_start(args, format);
+            state.callSite = &site;
+            int ret = logLevel(*this->targetStream, Level::LEVEL_TRACE, format, args);
+            state.callSite = nullptr;
+            va_end(args);
+            return ret;
+        }
+
+        /**
+         * Updates times and message counts
+         * */
+        inline bool updateLogger(Level lev) {
+            if(this->level <= lev) {
+                state.messageCount[(int)lev]++;
+                state.messageCount[(int)Level::LEVEL_COUNT]++;
+
+                //update timers (hrs, mins, seconds, millis, microseconds)
+                //the unit conversions are done when a time variable is printed
+                uint64_t elapsedNanos = timer.nanoseconds();
+                state.totalNanoseconds += elapsedNanos;
+                state.elapsedNanoseconds = (long long)elapsedNanos;
+
+                timer.reset();
+                return true;
+            }
+
+            return false;
+        }
+
+        /**
+         * Sets the current level variables (ln, lmc) to the values of @param lev
+         * */
+        inline void setCurrentLevel(Level lev) {
+            state.currentLevel = lev;
+            state.levelNames[(int)Level::LEVEL_COUNT] = state.levelNames[(int)lev];
+            state.currentMessageCount = state.messageCount[(int)lev];
+        }
+
+        /**
+         * adds a variable to the debugger
+         * @param name the name to which the variable will be referred
+         * @param variable the variable value as a void*
+         * @param type the variable type, one of the section from the enum
+         * @return true if the variable was added successfully, false if the variable is conflicting with other variables
+         * */
+        bool addVariable(const std::string& name, void* variable, DebugVarType type) {
+            //callback variables are owned by the logger, see addCallbackVariable
+            if(type == DebugVarType::FUNCTION || type == DebugVarType::DEBUGVAR_TYPE_COUNT) {
+                return false;
+            }
+
+            return insertVariable(name, DebugVar(type, variable));
+        }
+
+        /**
+         * adds a variable to the debugger, with the type deduced from @param variable
+         * Types the logger can't print fail to compile instead of printing garbage
+         * @param name the name to which the variable will be referred
+         * @param variable a pointer to the variable. Use std::atomic<int64_t>, std::atomic<double> or SeqlockString for variables other threads change
+         * @return true if the variable was added successfully, false if the variable is conflicting with other variables
+         * */
+        template<typename T>
+        bool addVariable(const std::string& name, T* variable) {
+            typedef VariableType<typename std::remove_cv<T>::type> Type;
+            static_assert(Type::SUPPORTED, "DebugLogger can't print variables of this type");
+            return addVariable(name, (void*)const_cast<typename std::remove_cv<T>::type*>(variable), Type::type());
+        }
+
+        /**
+         * adds a variable whose value is computed by @param function only when a message using it is printed
+         * @param name the name to which the variable will be referred
+         * @param function any function object taking no arguments that returns an integer, floating point number, char, C string or std::string
+         * @param memoize true to call the function once per message, even if the variable is printed several times in it
+         * @return true if the variable was added successfully, false if the variable is conflicting with other variables
+         * ```
+         * logger.addCallbackVariable("qlen", [&queue]() { return queue.size(); });
+         * logger.setPrefix("[qlen] ");
+         * ```
+         * */
+        template<typename Function>
+        bool addCallbackVariable(const std::string& name, Function function, bool memoize = true) {
+            return insertVariable(name, DebugVar(new FunctionVariable<Function>(function, memoize)));
+        }
+
+        /**
+         * Removes a variable from the list
+         * @param name the name of the variable to remove
+         * @return true if the variable existed and is now removed, false if the variable never existed
+         * */
+        bool removeVariable(const std::string& name) {
+            std::map<std::string, DebugVar>::iterator v = variables.find(name);
+
+            if(v != variables.end()) {
+                variables.erase(v);
+                return true;
+            }
+
+            return false;
+        }
+
+        /**
+         * Returns if @param name is one of the internal variables every logger has
+         * */
+        static bool isInternalVariable(const std::string& name) {
+            return findInternalVariable(name) != nullptr;
+        }
+
+        /**
+         * Reads the calling thread's id and name again for the tid, tname and pid variables
+         * They are read once per thread and again after a fork, so call this after a thread renames itself
+         * */
+        static void refreshThreadIdentity() {
+            readThreadIdentity(threadIdentity(), forkGeneration().load(std::memory_order_relaxed));
+        }
+
+        /**
+         * Lists the variables @param format prints, in order, including the ones in its sub-formats
+         * */
+        std::vector<std::string> getVariableNames(const char* format) {
+            std::vector<std::string> names;
+
+            for(int index = 0; format[index]; ++index) {
+                if(format[index] == '\\') {
+                    if(format[index + 1]) {
+                        index++;
+                    }
+
+                    continue;
+                }
+
+                if(format[index] != '[' && format[index] != '{') {
+                    continue;
+                }
+
+                int capitalized = CAPITALIZEDFORMAT_NONE;
+                bool rightAligned = false;
+                bool unsignedValue = false;
+                std::string name;
+                const char* subFormat = nullptr;
+                const char* subFormatEnd = nullptr;
+                int spaceCount = -1;
+                int spaceCount_dec = -1;
+                bool fillZero = false;
+                int outputFormat = OUTPUTFORMAT_DECIMAL;
+                char end = format[index] == '['? ']' : '}';
+
+                collectFormattingOptions(format, index, capitalized, rightAligned, unsignedValue, name, spaceCount, spaceCount_dec, fillZero, outputFormat, subFormat, subFormatEnd, end);
+
+                if(subFormat) {
+                    std::vector<std::string> inner = getVariableNames(std::string(subFormat, subFormatEnd).c_str());
+                    names.insert(names.end(), inner.begin(), inner.end());
+                }
+                else if(end == ']' && !name.empty()) {
+                    names.push_back(name);
+                }
+
+                if(!format[index]) {
+                    break;
+                }
+            }
+
+            return names;
+        }
+
+        /**
+         * Mixes @param value into @param hash
+         * */
+        static uint64_t mixHash(uint64_t hash, uint64_t value) {
+            hash = (hash ^ value) * 0xff51afd7ed558ccdull;
+            return hash ^ (hash >> 32);
+        }
+
+        /**
+         * Mixes the text @param text into @param hash, nullptr hashes as no text
+         * */
+        static uint64_t mixHash(uint64_t hash, const char* text) {
+            uint64_t textHash = 0xcbf29ce484222325ull;
+
+            for(const char* c = text; c && *c; ++c) {
+                textHash = (textHash ^ (uint8_t)*c) * 0x100000001b3ull;
+            }
+
+            return mixHash(hash, textHash);
+        }
+
+        /**
+         * Mixes the current values of the variables @param names into @param hash, to tell whether a message using them
+         * would print differently than before. Leave the internal variables out of the names (see isInternalVariable),
+         * times and counts change with every message
+         * Callback variables are called, memoized ones keep the value for the next message printed
+         * */
+        uint64_t hashVariables(const std::vector<std::string>& names, uint64_t hash) {
+            for(const std::string& name : names) {
+                DebugVar local(DebugVarType::DEBUGVAR_TYPE_COUNT, nullptr);
+                DebugVar* var = &local;
+                uint64_t metricInteger = 0;
+                double metricNumber = 0;
+
+                if(name.compare(0, 4, "ctx.") == 0) {
+                    const LogContext::Entry* entry = LogContext::find(name.c_str() + 4, name.size() - 4);
+
+                    if(entry) {
+                        local = DebugVar(entry->type, LogContext::valueOf(*entry));
+                    }
+                }
+                else if(metrics && name.compare(0, 7, "metric.") == 0) {
+                    DebugVarType type = metrics->getMetric(name.c_str() + 7, name.size() - 7, metricInteger, metricNumber);
+                    local = DebugVar(type, type == DebugVarType::INTEGER64? (void*)&metricInteger : (void*)&metricNumber);
+                }
+                else {
+                    std::map<std::string, DebugVar>::iterator v = variables.find(name);
+
+                    //pointed to rather than copied, copying a callback variable copies its function
+                    if(v != variables.end()) {
+                        var = &v->second;
+                    }
+                }
+
+                if(var->getType() == DebugVarType::FUNCTION) {
+                    CallbackVariable* callback = var->getCallback();
+                    local = DebugVar(callback->getResultType(), callback->refresh(state.messageCount[(int)Level::LEVEL_COUNT] + 1));
+                    var = &local;
+                }
+
+                hash = mixHash(hash, (uint64_t)var->getType());
+
+                switch(var->getType()) {
+                    case DebugVarType::CHAR:
+                        hash = mixHash(hash, (uint64_t)(uint8_t)var->getChar());
+                        break;
+                    case DebugVarType::INTEGER32:
+                        hash = mixHash(hash, (uint64_t)(uint32_t)var->getInt32());
+                        break;
+                    case DebugVarType::INTEGER64:
+                        hash = mixHash(hash, (uint64_t)var->getInt64());
+                        break;
+                    case DebugVarType::FLOAT32:
+                        hash = mixHash(hash, doubleBits(var->getFloat32()));
+                        break;
+                    case DebugVarType::FLOAT64:
+                        hash = mixHash(hash, doubleBits(var->getFloat64()));
+                        break;
+                    case DebugVarType::STRING:
+                        hash = mixHash(hash, var->getString());
+                        break;
+                    case DebugVarType::CSTRING:
+                        hash = mixHash(hash, var->getCString());
+                        break;
+                    case DebugVarType::ATOMIC_INTEGER64:
+                        hash = mixHash(hash, (uint64_t)var->getAtomicInt64());
+                        break;
+                    case DebugVarType::ATOMIC_FLOAT64:
+                        hash = mixHash(hash, doubleBits(var->getAtomicFloat64()));
+                        break;
+                    case DebugVarType::SEQLOCK_STRING:
+                        {
+                            char text[SeqlockString::CAPACITY];
+                            var->getSeqlockString(text);
+                            hash = mixHash(hash, text);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            return hash;
+        }
+
+        static uint64_t doubleBits(double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        /**
+         * Reads the current value of the variable @param name into @param snapshot, if it can be read while other threads change it:
+         * atomics, SeqlockStrings and [metric.name] values
+         * @return false for every other variable and for names that aren't variables of this logger
+         * */
+        bool snapshotVariable(const std::string& name, VariableSnapshot& snapshot) {
+            snapshot.integer = 0;
+            snapshot.number = 0;
+            snapshot.text.clear();
+
+            if(metrics && name.compare(0, 7, "metric.") == 0) {
+                snapshot.type = metrics->getMetric(name.c_str() + 7, name.size() - 7, snapshot.integer, snapshot.number);
+                return snapshot.type != DebugVarType::DEBUGVAR_TYPE_COUNT;
+            }
+
+            std::map<std::string, DebugVar>::iterator v = variables.find(name);
+
+            if(v == variables.end()) {
+                return false;
+            }
+
+            switch(v->second.getType()) {
+                case DebugVarType::ATOMIC_INTEGER64:
+                    snapshot.type = DebugVarType::INTEGER64;
+                    snapshot.integer = (uint64_t)v->second.getAtomicInt64();
+                    return true;
+                case DebugVarType::ATOMIC_FLOAT64:
+                    snapshot.type = DebugVarType::FLOAT64;
+                    snapshot.number = v->second.getAtomicFloat64();
+                    return true;
+                case DebugVarType::SEQLOCK_STRING:
+                    {
+                        char value[SeqlockString::CAPACITY];
+                        v->second.getSeqlockString(value);
+                        snapshot.type = DebugVarType::STRING;
+                        snapshot.text = value;
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+    private:
+        /**
+         * Filters, formats and writes a single message on @param lev
+         * Color codes are written into the same line as the prefix so that each message is a single write to @param output
+         * */
+        inline int logLevel(std::ostream& output, Level lev, const char* format, va_list& args) {
+            if(recorder) {
+                recorder->record(lev, format, args);
+            }
+
+            if(!updateLogger(lev)) {
+                if(instrumentation) {
+                    instrumentation->suppressed++;
+                }
+
+                return 0;
+            }
+
+            setCurrentLevel(lev);
+            return logInternal(output, format, args, false, getColorEnabled(&output)? getLevelColor(lev) : nullptr);
+        }
+
+        /**
+         * Recomputes whether colors are written to the target output
+         * Called whenever the color mode or target output changes so that no terminal check happens per message
+         * */
+        void updateColorActive() {
+            this->colorActive = colorMode == ColorMode::ALWAYS || (colorMode == ColorMode::AUTO && isTerminal(this->targetStream));
+        }
+
+        /**
+         * Describes an internal variable: its name, type and how to find its value in a logger
+         * The table of descriptors is shared by every logger, so constructing a logger doesn't allocate anything for them
+         * */
+        struct InternalVariable {
+            const char* name;
+            DebugVarType type;
+            void* (*resolve)(DebugLogger& logger);
+        };
+
+        /**
+         * Returns the descriptor of the internal variable @param name, or nullptr if it isn't an internal variable
+         * */
+        static const InternalVariable* findInternalVariable(const std::string& name) {
+            //sorted by name for the binary search below
+            static const InternalVariable internalVariables[] = {
+                //special characters
+                { "bks", DebugVarType::CHAR, [](DebugLogger& l) -> void* { return &l.state.specialCharacters[4]; } },
+                //cby = bytes written on the critical level
+                { "cby", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentationBytes(Level::CRITICAL_ERROR)); } },
+                //cmc critical message count
+                { "cmc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.messageCount[(int)Level::CRITICAL_ERROR]; } },
+                //cn = critical name
+                { "cn", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return &l.state.levelNames[(int)Level::CRITICAL_ERROR]; } },
+                //cpu = the CPU the message is printed on, -1 where the platform can't tell
+                { "cpu", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(currentCpu()); } },
+                //dby = bytes written on every level
+                { "dby", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentationBytes(Level::LEVEL_COUNT)); } },
+                //dmc stands for debug message count
+                { "dmc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.messageCount[(int)Level::LEVEL_COUNT]; } },
+                //drp = messages dropped by the target output
+                { "drp", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.targetSink? (long long)l.targetSink->getDropped() : 0); } },
+                //eby = bytes written on the error level
+                { "eby", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentationBytes(Level::LEVEL_ERROR)); } },
+                //emc error message count
+                { "emc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.messageCount[(int)Level::LEVEL_ERROR]; } },
+                //en = error name
+                { "en", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return &l.state.levelNames[(int)Level::LEVEL_ERROR]; } },
+                //eth = elapsed time hours
+                { "eth", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.elapsedNanoseconds, 3.6e12); } },
+                //eti = elapsed time microseconds
+                { "eti", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.elapsedNanoseconds, 1000); } },
+                //etl = elapsed time milliseconds
+                { "etl", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.elapsedNanoseconds, 1e6); } },
+                //etm = elapsed time minutes
+                { "etm", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.elapsedNanoseconds, 6e10); } },
+                //ets = elapsed time seconds
+                { "ets", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.elapsedNanoseconds, 1e9); } },
+                //fns = nanoseconds spent formatting messages
+                { "fns", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentation? (long long)l.instrumentation->formatNanoseconds : 0); } },
+                { "lbc", DebugVarType::CHAR, [](DebugLogger& l) -> void* { return &l.state.specialCharacters[0]; } },
+                { "lbk", DebugVarType::CHAR, [](DebugLogger& l) -> void* { return &l.state.specialCharacters[2]; } },
+                //level message count
+                { "lmc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.currentMessageCount; } },
+                //ln = current level name
+                { "ln", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return &l.state.levelNames[(int)Level::LEVEL_COUNT]; } },
+                //pid = process id
+                { "pid", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(threadIdentity().pid); } },
+                //the name of the logger program
+                { "pn", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.currentName(); } },
+                //qd = queue depth of the target output
+                { "qd", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.targetSink? (long long)l.targetSink->getQueueDepth() : 0); } },
+                //qhw = queue high water mark of the target output
+                { "qhw", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.targetSink? (long long)l.targetSink->getQueueHighWater() : 0); } },
+                { "rbc", DebugVarType::CHAR, [](DebugLogger& l) -> void* { return &l.state.specialCharacters[1]; } },
+                { "rbk", DebugVarType::CHAR, [](DebugLogger& l) -> void* { return &l.state.specialCharacters[3]; } },
+                //sfl = call site file
+                { "sfl", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.state.callSite? l.state.callSite->file : ""); } },
+                //sfn = call site function
+                { "sfn", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.state.callSite? l.state.callSite->function : ""); } },
+                //sln = call site line
+                { "sln", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.state.callSite? l.state.callSite->line : 0); } },
+                //sup = messages suppressed by the level
+                { "sup", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentation? (long long)l.instrumentation->suppressed : 0); } },
+                //tby = bytes written on the trace level
+                { "tby", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentationBytes(Level::LEVEL_TRACE)); } },
+                //th = time hours
+                { "th", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.totalNanoseconds, 3.6e12); } },
+                //ti = time microseconds
+                { "ti", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.totalNanoseconds, 1000); } },
+                //tid = thread id
+                { "tid", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(threadIdentity().tid); } },
+                //tl = time milliseconds
+                { "tl", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.totalNanoseconds, 1e6); } },
+                //tm = time minutes
+                { "tm", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.totalNanoseconds, 6e10); } },
+                //tmc stands for trace message count
+                { "tmc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.messageCount[(int)Level::LEVEL_TRACE]; } },
+                //tn = trace name
+                { "tn", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return &l.state.levelNames[(int)Level::LEVEL_TRACE]; } },
+                //tname = thread name
+                { "tname", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(threadIdentity().name); } },
+                //ts = time seconds
+                { "ts", DebugVarType::FLOAT64, [](DebugLogger& l) -> void* { return l.timeValue(l.state.totalNanoseconds, 1e9); } },
+                //wby = bytes written on the warning level
+                { "wby", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentationBytes(Level::LEVEL_WARNING)); } },
+                //wd = wall clock date: 2026-10-19
+                { "wd", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.wallClock().date); } },
+                //wdt = wall clock date and time in ISO-8601: 2026-10-19T14:03:07.123456+02:00
+                { "wdt", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.wallClock().dateTime); } },
+                //wmc warning message count
+                { "wmc", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return &l.state.messageCount[(int)Level::LEVEL_WARNING]; } },
+                //wn = warning name
+                { "wn", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return &l.state.levelNames[(int)Level::LEVEL_WARNING]; } },
+                //wns = nanoseconds spent writing messages
+                { "wns", DebugVarType::INTEGER64, [](DebugLogger& l) -> void* { return l.integerValue(l.instrumentation? (long long)l.instrumentation->writeNanoseconds : 0); } },
+                //wt = wall clock time: 14:03:07.123456
+                { "wt", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.wallClock().time); } },
+                //wz = offset of the local time zone from UTC: +02:00
+                { "wz", DebugVarType::CSTRING, [](DebugLogger& l) -> void* { return l.textValue(l.wallClock().zone); } },
+            };
+
+            return findByName(internalVariables, sizeof(internalVariables) / sizeof(internalVariables[0]), name);
+        }
+
+        /**
+         * Converts @param nanos to the unit of @param nanosPerUnit for printing
+         * */
+        void* timeValue(long long nanos, double nanosPerUnit) {
+            state.scratchFloat = (double)nanos / nanosPerUnit;
+            return &state.scratchFloat;
+        }
+
+        long long instrumentationBytes(Level lev) const {
+            return instrumentation? (long long)instrumentation->bytes[(int)lev] : 0;
+        }
+
+        void* integerValue(long long value) {
+            state.scratchInteger = value;
+            return &state.scratchInteger;
+        }
+
+        void* textValue(const char* value) {
+            state.scratchText = value;
+            return &state.scratchText;
+        }
+
+        /**
+         * Text of the wall clock variables for one second, shared by every logger on a thread
+         * */
+        struct WallClockText {
+            long long second;
+            char dateTime[33];
+            char date[11];
+            char time[16];
+            char zone[7];
+        };
+
+        static WallClockText& wallClockText() {
+            static thread_local WallClockText text = { LLONG_MIN, "", "", "", "" };
+            return text;
+        }
+
+        /**
+         * Returns the wall clock variables for the message being printed
+         * The clock is read once per message, and localtime is only called when the second changes,
+         * otherwise only the microsecond digits are written
+         * */
+        const WallClockText& wallClock() {
+            long long message = state.messageCount[(int)Level::LEVEL_COUNT];
+
+            if(state.wallClockMessage != message) {
+                state.wallClockMessage = message;
+                state.wallClockMicroseconds = (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+
+            long long second = state.wallClockMicroseconds / 1000000;
+            int fraction = (int)(state.wallClockMicroseconds % 1000000);
+
+            if(fraction < 0) {
+                second--;
+                fraction += 1000000;
+            }
+
+            WallClockText& text = wallClockText();
+
+            if(text.second != second) {
+                renderWallClock(text, second);
+            }
+
+            writeDigits(text.dateTime + 20, fraction, 6);
+            writeDigits(text.time + 9, fraction, 6);
+            return text;
+        }
+
+        /**
+         * Renders every part of @param text except the microseconds for the local time of @param second
+         * The UTC offset is taken from the local time itself, so it follows daylight saving changes
+         * */
+        static void renderWallClock(WallClockText& text, long long second) {
+            time_t seconds = (time_t)second;
+            struct tm local;
+            LOCALTIME(seconds, local);
+
+            long long localSeconds = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400
+                + local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+            int offsetMinutes = (int)((localSeconds - second) / 60);
+            char sign = offsetMinutes < 0? '-' : '+';
+            offsetMinutes = offsetMinutes < 0? -offsetMinutes : offsetMinutes;
+
+            //2026-10-19
+            writeDigits(text.date, local.tm_year + 1900, 4);
+            text.date[4] = '-';
+            writeDigits(text.date + 5, local.tm_mon + 1, 2);
+            text.date[7] = '-';
+            writeDigits(text.date + 8, local.tm_mday, 2);
+            text.date[10] = 0;
+
+            //14:03:07.123456
+            writeDigits(text.time, local.tm_hour, 2);
+            text.time[2] = ':';
+            writeDigits(text.time + 3, local.tm_min, 2);
+            text.time[5] = ':';
+            writeDigits(text.time + 6, local.tm_sec, 2);
+            text.time[8] = '.';
+            text.time[15] = 0;
+
+            //+02:00
+            text.zone[0] = sign;
+            writeDigits(text.zone + 1, offsetMinutes / 60, 2);
+            text.zone[3] = ':';
+            writeDigits(text.zone + 4, offsetMinutes % 60, 2);
+            text.zone[6] = 0;
+
+            memcpy(text.dateTime, text.date, 10);
+            text.dateTime[10] = 'T';
+            memcpy(text.dateTime + 11, text.time, 9);
+            memcpy(text.dateTime + 26, text.zone, 7);
+            text.second = second;
+        }
+
+        /**
+         * Days from 1970-01-01 to the date @param year @param month @param day of the proleptic Gregorian calendar
+         * */
+        static long long daysFromCivil(long long year, int month, int day) {
+            year -= month <= 2;
+            long long era = (year >= 0? year : year - 399) / 400;
+            long long yearOfEra = year - era * 400;
+            long long dayOfYear = (153 * (month + (month > 2? -3 : 9)) + 2) / 5 + day - 1;
+            long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+            return era * 146097 + dayOfEra - 719468;
+        }
+
+        /**
+         * Writes @param value as exactly @param width decimal digits, padded with zeros
+         * */
+        static void writeDigits(char* out, int value, int width) {
+            for(int i = width - 1; i >= 0; --i) {
+                out[i] = (char)('0' + value % 10);
+                value /= 10;
+            }
+        }
+
+        /**
+         * The ids and name of the calling thread, read once per thread so the variables cost no system call per message
+         * Plain data, so the thread_local needs no constructor or guard
+         * */
+        struct ThreadIdentity {
+            //the fork generation the ids were read in, 0 before they are read
+            uint64_t generation;
+            long long tid;
+            long long pid;
+            char name[16];
+        };
+
+        /**
+         * Counts the forks of the process, starting at 1. A child sees a new generation and reads its ids again
+         * */
+        static std::atomic<uint64_t>& forkGeneration() {
+            static std::atomic<uint64_t> generation{ 1 };
+            return generation;
+        }
+
+        static ThreadIdentity& threadIdentity() {
+            static thread_local ThreadIdentity identity = { 0, 0, 0, "" };
+            uint64_t generation = forkGeneration().load(std::memory_order_relaxed);
+
+            if(identity.generation != generation) {
+                readThreadIdentity(identity, generation);
+            }
+
+            return identity;
         }
 
-        void setColorWarning(std::ostream& outputStream) {
-            if(enableColor) {
-                //outputStream << "\033[33m"; //yellow
-                outputStream << "\033[1m\033[33m"; //dark yellow
-            }
+        static void readThreadIdentity(ThreadIdentity& identity, uint64_t generation) {
+            identity.generation = generation;
+            identity.name[0] = 0;
+
+#if defined(__linux__)
+            //only the thread forking lives on in the child, so the handler only has to be registered once per process
+            static bool forkHandler = pthread_atfork(nullptr, nullptr, []() { forkGeneration().fetch_add(1, std::memory_order_relaxed); }) == 0;
+            (void)forkHandler;
+
+            identity.tid = (long long)syscall(SYS_gettid);
+            identity.pid = (long long)getpid();
+            //the 16 bytes a thread name is limited to, with its terminator
+            prctl(PR_GET_NAME, identity.name, 0, 0, 0);
+#elif defined(__APPLE__)
+            uint64_t tid = 0;
+            pthread_threadid_np(nullptr, &tid);
+            identity.tid = (long long)tid;
+            identity.pid = (long long)getpid();
+            pthread_getname_np(pthread_self(), identity.name, sizeof(identity.name));
+#elif defined(WIN32) | defined(__WIN32) || defined (_WIN32)
+            identity.tid = (long long)GetCurrentThreadId();
+            identity.pid = (long long)_getpid();
+            readWindowsThreadName(identity.name, sizeof(identity.name));
+#else
+            identity.tid = 0;
+            identity.pid = 0;
+#endif
+
+            identity.name[sizeof(identity.name) - 1] = 0;
         }
 
-        void setColorError(std::ostream& outputStream) {
-            if(enableColor) {
-                //outputStream << "\033[31m"; //red
-                outputStream << "\033[1m\033[31m"; //dark red
+#if defined(WIN32) | defined(__WIN32) || defined (_WIN32)
+        /**
+         * Copies the name set with SetThreadDescription into @param name as UTF-8, cut to @param size - 1 bytes
+         * GetThreadDescription is looked up at run time, it only exists from Windows 10 1607 on; before that the name stays empty
+         * */
+        static void readWindowsThreadName(char* name, size_t size) {
+            typedef HRESULT (WINAPI *GetThreadDescriptionFunction)(HANDLE, PWSTR*);
+            static GetThreadDescriptionFunction getDescription = (GetThreadDescriptionFunction)(void*)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "GetThreadDescription");
+            PWSTR description = nullptr;
+
+            if(!getDescription || FAILED(getDescription(GetCurrentThread(), &description)) || !description) {
+                return;
             }
-        }
 
-        void setColorCritical(std::ostream& outputStream) {
-            if(enableColor) {
-                outputStream << "\033[1m\033[31m"; //dark red
+            char text[256];
+            int length = WideCharToMultiByte(CP_UTF8, 0, description, -1, text, (int)sizeof(text), nullptr, nullptr);
+            LocalFree(description);
+
+            if(length > 0) {
+                size_t copied = std::min((size_t)length - 1, size - 1);
+
+                //a cut name ends on a whole UTF-8 character
+                while(copied > 0 && copied < (size_t)length - 1 && ((unsigned char)text[copied] & 0xc0) == 0x80) {
+                    copied--;
+                }
+
+                memcpy(name, text, copied);
+                name[copied] = 0;
             }
         }
+#endif
 
-        void resetColor(std::ostream& outputStream) {
-            if(enableColor) {
-                outputStream << "\033[0m";
+        /**
+         * Returns the CPU the calling thread runs on, or -1 if it can't be found
+         * Read from the area the kernel updates for restartable sequences when glibc registered one, which is a plain load,
+         * otherwise from sched_getcpu, which goes through the vDSO. On Windows GetCurrentProcessorNumber doesn't enter the kernel either
+         * */
+        static long long currentCpu() {
+#if defined(DEBUGLOGGER_RSEQ)
+            if(__rseq_size > 0) {
+                const volatile struct rseq* area = (const struct rseq*)((char*)__builtin_thread_pointer() + __rseq_offset);
+                int32_t cpu = (int32_t)area->cpu_id;
+
+                if(cpu >= 0) {
+                    return cpu;
+                }
             }
+#endif
+#if defined(__linux__)
+            return sched_getcpu();
+#elif defined(WIN32) | defined(__WIN32) || defined (_WIN32)
+            return (long long)GetCurrentProcessorNumber();
+#else
+            return -1;
+#endif
         }
 
-        void setColorEnabled() {
-            this->enableColor = true;
+        /**
+         * Returns the name printed by [pn]
+         * */
+        void* currentName() {
+            state.scratchText = state.nameOverride? state.nameOverride : loggerName.c_str();
+            return &state.scratchText;
         }
 
-        void setColorDisabled() {
-            this->enableColor = false;
+        /**
+         * Logs a message on behalf of a registry logger
+         * @param name the registry logger's name, printed by [pn]
+         * @param prefix the prefix to print instead of this logger's, or nullptr for this logger's prefix
+         * */
+        int logNamed(std::ostream& output, Level lev, const char* name, const char* prefix, const char* format, va_list& args) {
+            state.nameOverride = name;
+            state.prefixOverride = prefix;
+            int ret = logLevel(output, lev, format, args);
+            state.nameOverride = nullptr;
+            state.prefixOverride = nullptr;
+            return ret;
         }
 
-        bool getColorEnabled() {
-            return this->enableColor;
-        }
-        
         /**
-         * There exist various variables which the prefix uses
-         * To use a variable, use two braces and write the name of the variable inside; constrast from the {} used for printing parameters passed into the function
-         * [ var_name ] -> with or without the spaces, it doesn't matter
-         * Basic formatting options within the braces apply
-         * Applies the prefix to all levels if @param targetLevel is omitted
+         * Binary search for @param name in a table sorted by name
          * */
-        void setPrefix(const std::string& prefix, Level targetLevel = Level::LEVEL_COUNT) {
-            if(targetLevel == Level::LEVEL_COUNT) {
-                this->prefixFormat[(int)Level::LEVEL_TRACE] = prefix;
-                this->prefixFormat[(int)Level::LEVEL_WARNING] = prefix;
-                this->prefixFormat[(int)Level::LEVEL_ERROR] = prefix;
-                this->prefixFormat[(int)Level::CRITICAL_ERROR] = prefix;
-            }
-            else if(targetLevel < Level::LEVEL_COUNT && targetLevel >= Level::LEVEL_TRACE){
-                this->prefixFormat[(int)targetLevel] = prefix;
+        template<typename T>
+        static const T* findByName(const T* table, int count, const std::string& name) {
+            int low = 0, high = count - 1;
+
+            while(low <= high) {
+                int mid = (low + high) / 2;
+                int cmp = strcmp(table[mid].name, name.c_str());
+
+                if(cmp == 0) {
+                    return table + mid;
+                }
+                else if(cmp < 0) {
+                    low = mid + 1;
+                }
+                else {
+                    high = mid - 1;
+                }
             }
+
+            return nullptr;
         }
 
-        int trace(const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+        /**
+         * The stream a message is formatted into, a buffer kept between messages so formatting doesn't allocate once it is large enough
+         * Sub-formats are written straight into it, then case converted and padded where they are
+         * */
+        class LineStream : public std::ostream {
+            public:
+                //a buffer grown past this by one huge message is given back afterwards
+                static constexpr size_t KEPT_CAPACITY = 65536;
 
-            //set trace vars
-            if(updateLogger(Level::LEVEL_TRACE)) {
-                setTrace(*this->targetStream);
-                ret = logInternal(*this->targetStream, format, args);
-            }
+                //string arguments at least this long are referenced by the line instead of copied into it
+                static constexpr size_t REFERENCE_THRESHOLD = 4096;
 
-            resetColor(*this->targetStream);
+                LineStream()
+                    :std::ostream(&buffer)
+                {
+                }
 
-            va_end(args);
-            return ret;
-        }
+                /**
+                 * Returns the length of the line, including the referenced text
+                 * */
+                size_t size() const {
+                    return buffer.text.size() + referencedBytes;
+                }
 
-        int traceToStream(std::ostream& output, const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+                /**
+                 * Returns where the next character written goes in the line's own text, for changeCase() and pad()
+                 * */
+                size_t position() const {
+                    return buffer.text.size();
+                }
 
-            //set trace vars
-            if(updateLogger(Level::LEVEL_TRACE)) {
-                setTrace(output);
-                ret = logInternal(output, format, args);
-            }
+                /**
+                 * The line's own text, the whole line as long as nothing is referenced
+                 * */
+                const char* data() const {
+                    return buffer.text.data();
+                }
 
-            resetColor(output);
+                bool hasReferences() const {
+                    return !references.empty();
+                }
 
-            va_end(args);
-            return ret;
-        }
+                /**
+                 * Makes room for @param length more characters of the line's own text, so a long argument grows it once
+                 * */
+                void reserve(size_t length) {
+                    buffer.text.reserve(buffer.text.size() + length);
+                }
 
-        int warning(const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+                /**
+                 * Puts the @param length bytes at @param data in the line without copying them, they must stay valid until the line is written
+                 * */
+                void reference(const char* data, size_t length) {
+                    references.push_back({ buffer.text.size(), data, length });
+                    referencedBytes += length;
+                }
 
-            if(updateLogger(Level::LEVEL_WARNING)) {
-                setWarning(*this->targetStream);
-                ret = logInternal(*this->targetStream, format, args);
-            }
+                /**
+                 * Splits the line into @param segments: its own text, with the referenced text in between where it was written
+                 * */
+                void getSegments(std::vector<LogSegment>& segments) const {
+                    const std::string& text = buffer.text;
+                    size_t done = 0;
+
+                    for(const Reference& r : references) {
+                        if(r.offset > done) {
+                            segments.push_back({ text.data() + done, r.offset - done });
+                            done = r.offset;
+                        }
 
-            resetColor(*this->targetStream);
+                        segments.push_back({ r.data, r.length });
+                    }
 
-            va_end(args);
-            return ret;
-        }
+                    if(text.size() > done) {
+                        segments.push_back({ text.data() + done, text.size() - done });
+                    }
+                }
 
-        int warningToStream(std::ostream& output, const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+                /**
+                 * Writes the line to @param output, handing it to LogSink::writeMessage() in pieces when text is referenced
+                 * */
+                void writeTo(std::ostream& output) {
+                    if(references.empty()) {
+                        output.write(buffer.text.data(), (std::streamsize)buffer.text.size());
+                        return;
+                    }
 
-            if(updateLogger(Level::LEVEL_WARNING)) {
-                setWarning(output);
-                ret = logInternal(output, format, args);
-            }
+                    std::vector<LogSegment> segments;
+                    getSegments(segments);
+                    LogSink* sink = dynamic_cast<LogSink*>(&output);
 
-            resetColor(output);
+                    if(sink) {
+                        sink->writeMessage(segments.data(), segments.size());
+                        return;
+                    }
 
-            va_end(args);
-            return ret;
-        }
+                    for(const LogSegment& segment : segments) {
+                        output.write(segment.data, (std::streamsize)segment.length);
+                    }
+                }
 
-        int error(const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+                void reset() {
+                    if(buffer.text.capacity() > KEPT_CAPACITY) {
+                        std::string().swap(buffer.text);
+                    }
 
-            if(updateLogger(Level::LEVEL_ERROR)) {
-                setError(*this->targetStream);
-                ret = logInternal(*this->targetStream, format, args);
-            }
+                    buffer.text.clear();
+                    references.clear();
+                    referencedBytes = 0;
+                    clear();
+                }
 
-            resetColor(*this->targetStream);
+                /**
+                 * Converts what was written since @param start to upper or lower case, as given by @param cap
+                 * */
+                void changeCase(size_t start, int cap) {
+                    copyReferences(start);
+                    std::string& text = buffer.text;
 
-            va_end(args);
-            return ret;
-        }
+                    for(size_t i = start; i < text.size(); ++i) {
+                        if(cap == CAPITALIZEDFORMAT_CAPS) {
+                            text[i] = (char)std::toupper(text[i]);
+                        }
+                        else if(cap == CAPITALIZEDFORMAT_LOWER) {
+                            text[i] = (char)std::tolower(text[i]);
+                        }
+                    }
+                }
 
-        int errorToStream(std::ostream& output, const char* format, ...) {
-            int ret = 0;
-            va_list args;
-            va_start(args, format);
+                /**
+                 * Pads what was written since @param start to @param width characters,
+                 * shifting it right to put the spaces in front when @param right is set
+                 * */
+                void pad(size_t start, int width, bool right) {
+                    copyReferences(start);
+                    std::string& text = buffer.text;
+                    size_t written = text.size() - start;
+
+                    if(width <= 0 || written >= (size_t)width) {
+                        return;
+                    }
 
-            if(updateLogger(Level::LEVEL_ERROR)) {
-                setError(output);
-                ret = logInternal(output, format, args);
-            }
+                    if(right) {
+                        text.insert(start, (size_t)width - written, ' ');
+                    }
+                    else {
+                        text.append((size_t)width - written, ' ');
+                    }
+                }
 
-            resetColor(output);
+            private:
+                struct Buffer : public std::streambuf {
+                    std::string text;
 
-            va_end(args);
-            return ret;
-        }
+                    std::streamsize xsputn(const char* data, std::streamsize count) override {
+                        text.append(data, (size_t)count);
+                        return count;
+                    }
 
-        int critical(const char* format, ...) {
-            int ret = 0;
-            va_list(args);
-            va_start(args, format);
+                    int_type overflow(int_type c) override {
+                        if(!traits_type::eq_int_type(c, traits_type::eof())) {
+                            text.push_back(traits_type::to_char_type(c));
+                        }
 
-            if(updateLogger(Level::CRITICAL_ERROR)) {
-                setCritical(*this->targetStream);
-                ret = logInternal(*this->targetStream, format, args);
-            }
+                        return traits_type::not_eof(c);
+                    }
+                };
+
+                /**
+                 * Text that goes in the line at @param offset of its own text
+                 * */
+                struct Reference {
+                    size_t offset;
+                    const char* data;
+                    size_t length;
+                };
+
+                /**
+                 * Copies the text referenced from @param start on into the line, so it can be changed in place
+                 * */
+                void copyReferences(size_t start) {
+                    if(references.empty() || references.back().offset < start) {
+                        return;
+                    }
 
-            resetColor(*this->targetStream);
+                    std::string& text = buffer.text;
+                    size_t first = references.size();
 
-            va_end(args);
-            return ret;
-        }
+                    while(first > 0 && references[first - 1].offset >= start) {
+                        first--;
+                    }
 
-        int criticalToStream(std::ostream& output, const char* format, ...) {
-            int ret = 0;
-            va_list(args);
-            va_start(args, format);
+                    std::string tail(text, start);
+                    text.resize(start);
+                    size_t done = start;
 
-            if(updateLogger(Level::CRITICAL_ERROR)) {
-                setCritical(output);
-                ret = logInternal(output, format, args);
-            }
+                    for(size_t i = first; i < references.size(); ++i) {
+                        text.append(tail, done - start, references[i].offset - done);
+                        text.append(references[i].data, references[i].length);
+                        referencedBytes -= references[i].length;
+                        done = references[i].offset;
+                    }
 
-            resetColor(output);
+                    text.append(tail, done - start, std::string::npos);
+                    references.resize(first);
+                }
 
-            va_end(args);
-            return ret;
-        }
+                Buffer buffer;
+                std::vector<Reference> references;
+                size_t referencedBytes = 0;
+        };
 
         /**
-         * Updates times and message counts
+         * Hands out this thread's line streams, one per message being formatted at a time
+         * (a callback variable can log while its own message is being formatted)
          * */
-        inline bool updateLogger(Level lev) {
-            if(this->level <= lev) {
-                messageCount[(int)lev]++;
-                messageCount[(int)Level::LEVEL_COUNT]++;
-
-                //update timers (hrs, mins, seconds, millis, microseconds)
-                uint64_t elapsedNanos = timer.nanoseconds();
-                totalNanoseconds += elapsedNanos;
+        class LineLease {
+            public:
+                static constexpr int POOL_SIZE = 4;
 
-                timeVars[0] = (double)totalNanoseconds / 3.6e12;
-                timeVars[1] = (double)totalNanoseconds / 6e10;
-                timeVars[2] = (double)totalNanoseconds / 1e9;
-                timeVars[3] = (double)totalNanoseconds / 1e6;
-                timeVars[4] = (double)totalNanoseconds / 1000;
+                LineLease() {
+                    Pool& lines = pool();
 
-                elapsedTimeVars[0] = (double)elapsedNanos / 3.6e12;
-                elapsedTimeVars[1] = (double)elapsedNanos / 6e10;
-                elapsedTimeVars[2] = (double)elapsedNanos / 1e9;
-                elapsedTimeVars[3] = (double)elapsedNanos / 1e6;
-                elapsedTimeVars[4] = (double)elapsedNanos / 1000;
+                    if(lines.depth < POOL_SIZE) {
+                        line = &lines.streams[lines.depth];
+                    }
+                    else {
+                        overflow.reset(new LineStream());
+                        line = overflow.get();
+                    }
 
-                timer.reset();
-                return true;
-            }
+                    lines.depth++;
+                }
 
-            return false;
-        }
+                ~LineLease() {
+                    line->reset();
+                    pool().depth--;
+                }
 
-        inline void setTrace(std::ostream& output) {
-            //set trace vars
-            setColorTrace(output);
-            levelNames[(int)Level::LEVEL_COUNT] = levelNames[(int)Level::LEVEL_TRACE];
-            currentMessageCount = messageCount[(int)Level::LEVEL_TRACE];
-        }
+                LineLease(const LineLease&) = delete;
+                LineLease& operator=(const LineLease&) = delete;
 
-        inline void setWarning(std::ostream& output) {
-            setColorWarning(output);
-            levelNames[(int)Level::LEVEL_COUNT] = levelNames[(int)Level::LEVEL_WARNING];
-            currentMessageCount = messageCount[(int)Level::LEVEL_WARNING];
-        }
+                LineStream& get() {
+                    return *line;
+                }
 
-        inline void setError(std::ostream& output) {
-            setColorError(output);
-            levelNames[(int)Level::LEVEL_COUNT] = levelNames[(int)Level::LEVEL_ERROR];
-            currentMessageCount = messageCount[(int)Level::LEVEL_ERROR];
-        }
+            private:
+                struct Pool {
+                    LineStream streams[POOL_SIZE];
+                    int depth = 0;
+                };
+
+                static Pool& pool() {
+                    static thread_local Pool lines;
+                    return lines;
+                }
 
-        inline void setCritical(std::ostream& output) {
-            setColorCritical(output);
-            levelNames[(int)Level::LEVEL_COUNT] = levelNames[(int)Level::CRITICAL_ERROR];
-            currentMessageCount = messageCount[(int)Level::CRITICAL_ERROR];
-        }
+                LineStream* line;
+                std::unique_ptr<LineStream> overflow;
+        };
 
         /**
-         * adds a variable to the debugger
-         * @param name the name to which the variable will be referred
-         * @param variable the variable value as a void*
-         * @param type the variable type, one of the section from the enum
-         * @return true if the variable was added successfully, false if the variable is conflicting with other variables
+         * Internal method to handle logging
+         * @param output the output stream to write to
+         * @param format the print format
+         * @param args the va arguments as a reference
+         * @param recursive true when printing a sub-format (no prefix or new line)
+         * @param color the escape sequence to start the line with, or nullptr for no color
          * */
-        bool addVariable(const std::string& name, void* variable, DebugVarType type) {
-            //validate variable
-            const char* varName = name.c_str();
-            int index = 0;
-            if(isAlpha(varName, index) || varName[0] == '_') {
-                index++;
+        inline int logInternal(std::ostream& output, const char* format, va_list& args, bool recursive = false, const char* color = nullptr) {
+            //sub-formats are rendered straight into the line of the message they are part of
+            if(recursive) {
+                size_t length = strlen(format);
+                printFormat(output, format, length, args);
+                return (int)length;
+            }
 
-                while(varName[index] && (isAlpha(varName, index) || varName[index] == '_' || isNum(varName, index))) {
-                    index++;
-                }
-                
-                if(index == name.size()) {
-                    if(variables.find(name) == variables.end()) {
-                        variables.emplace(std::pair<std::string, DebugVar>({name, DebugVar(type, variable)}));
-                        return true;
-                    }
-                }
+            bool measure = (bool)instrumentation;
+            uint64_t start = measure? instrumentationClock() : 0;
+            LineLease lease;
+            LineStream& outputLine = lease.get();
+
+            //print prefix to message using only internal variables
+            if(color) {
+                outputLine << color;
             }
 
-            //improper var name or something
-            return false;
-        } 
+            printPrefix(outputLine, level, args);
+            printFormat(outputLine, format, strlen(format), args);
 
-        /**
-         * Removes a variable from the list
-         * @param name the name of the variable to remove
-         * @return true if the variable existed and is now removed, false if the variable never existed
-         * */
-        bool removeVariable(const std::string& name) {
-            std::map<std::string, DebugVar>::iterator v = variables.find(name);
+            if(color) {
+                outputLine << COLOR_RESET;
+            }
 
-            if(v != variables.end() && !v->second.getReadonly()) {
-                variables.erase(v);
-                return true;
+            outputLine << '\n';
+
+            if(targetSink && static_cast<std::ostream*>(targetSink) == &output) {
+                targetSink->beginMessage((uint64_t)state.totalNanoseconds, (uint64_t)state.messageCount[(int)Level::LEVEL_COUNT]);
             }
 
-            return false;
+            if(measure) {
+                uint64_t formatted = instrumentationClock();
+                outputLine.writeTo(output);
+                measureMessage(format, TscClock::toNanoseconds(formatted - start), TscClock::toNanoseconds(instrumentationClock() - formatted), outputLine.size());
+            }
+            else {
+                outputLine.writeTo(output);
+            }
+
+            return (int)outputLine.size();
         }
 
-    private:
         /**
-         * Adds a variable that cannot be removed
+         * Prints the first @param length characters of @param format with its arguments
+         * The text after them isn't read, so a sub-format is printed in place from the format it is part of
          * */
-        bool addInternalVariable(const std::string& name, void* variable, DebugVarType type) {
-            if(variables.find(name) == variables.end()) {
-                variables.emplace(std::pair<std::string, DebugVar>({name, DebugVar(type, variable, true)}));
-                return true;
+        void printFormat(std::ostream& output, const char* format, size_t length, va_list& args) {
+            int len = (int)length;
+            int formatIndex = 0;
+            int previousFormatIndex = -1;
+
+            if(len == 0) {
+                return;
             }
 
-            return false;
+            //process and print arguments
+            while(printNext(output, format, formatIndex, args) && formatIndex < len && formatIndex != previousFormatIndex) {
+                previousFormatIndex = formatIndex;
+            }
+        }
+
+        static uint64_t instrumentationClock() {
+            return TscClock::ticks();
         }
 
         /**
-         * Internal method to handle logging
-         * @param output the output stream to write to
-         * @param format the print format
-         * @param args the va arguments as a reference
-         * @param level the current log level
+         * Adds a printed message to the instrumentation
          * */
-        inline int logInternal(std::ostream& output, const char* format, va_list& args, bool recursive = false) {
-            std::stringstream outputLine;
+        void measureMessage(const char* format, uint64_t formatNanoseconds, uint64_t writeNanoseconds, size_t bytes) {
+            LoggerStats& stats = *instrumentation;
+            stats.formatNanoseconds += formatNanoseconds;
+            stats.writeNanoseconds += writeNanoseconds;
+            stats.bytes[(int)state.currentLevel] += bytes;
+            stats.bytes[(int)Level::LEVEL_COUNT] += bytes;
 
-            //print prefix to message using only internal variables
-            if(!recursive) {
-                printPrefix(outputLine, level, args);
+            //keep the slowest formats sorted, each format is listed once with its slowest time
+            LoggerStats::SlowFormat* slowest = stats.slowest;
+            const int count = LoggerStats::SLOW_FORMAT_COUNT;
+
+            if(formatNanoseconds <= slowest[count - 1].nanoseconds) {
+                return;
             }
 
-            //set color (trace color)
-            int len = (int)strlen(format);
-            int formatIndex = 0;
-            int previousFormatIndex = -1;
+            int position = count - 1;
 
-            //process and print arguments
-            while(printNext(outputLine, format, formatIndex, args) && formatIndex < len && formatIndex != previousFormatIndex) {
-                previousFormatIndex = formatIndex;
+            for(int i = 0; i < count; ++i) {
+                if(slowest[i].format == format) {
+                    if(formatNanoseconds <= slowest[i].nanoseconds) {
+                        return;
+                    }
+
+                    position = i;
+                    break;
+                }
             }
 
-            if(!recursive) {
-                outputLine << "\n";
+            while(position > 0 && slowest[position - 1].nanoseconds < formatNanoseconds) {
+                slowest[position] = slowest[position - 1];
+                position--;
             }
 
-            output << outputLine.str();
-            return (int)outputLine.str().size();
+            slowest[position].format = format;
+            slowest[position].nanoseconds = formatNanoseconds;
         }
 
         /**
@@ -574,7 +2443,10 @@ class DebugLogger {
                 DECIMAL,
                 HEX_MODIFIER,
                 CAPITAL_HEX_MODIFIER,
-                BINARY_MODIFIER
+                BINARY_MODIFIER,
+                ARRAY,
+                HEXDUMP,
+                STRING_LENGTH
             };
 
             const char* lexemeStart, *lexemeEnd;
@@ -582,6 +2454,66 @@ class DebugLogger {
         };
 
         Token currentToken;
+
+        /**
+         * A reserved argument type name
+         * */
+        struct Reserve {
+            const char* name;
+            Token::TokenType type;
+        };
+
+        /**
+         * The [] part of an array argument such as {.2f[; ]}
+         * */
+        struct ArrayFormat {
+            bool enabled = false;
+
+            //text between the brackets, empty for the logger's separator
+            std::string separator;
+        };
+
+        /**
+         * Returns the argument type named @param name, or nullptr if it isn't a reserve
+         * */
+        static const Reserve* findReserve(const std::string& name) {
+            //sorted by name for the binary search
+            static const Reserve reserves[] = {
+                //char pnemonics: char, ch, c
+                { "c", Token::TokenType::SIGNED_CHAR },
+                { "ch", Token::TokenType::SIGNED_CHAR },
+                { "char", Token::TokenType::SIGNED_CHAR },
+                //int pnemonics: int, i, d, uint, ui, u
+                { "d", Token::TokenType::SIGNED_INT },
+                //double pnemonics: double, dbl. As an array these read doubles instead of floats
+                { "dbl", Token::TokenType::FLOAT },
+                { "double", Token::TokenType::FLOAT },
+                //float pnemoinics: float, flt, f
+                { "f", Token::TokenType::FLOAT },
+                { "float", Token::TokenType::FLOAT },
+                { "flt", Token::TokenType::FLOAT },
+                //hexdump of a buffer, takes a pointer and a size_t length
+                { "hexdump", Token::TokenType::HEXDUMP },
+                { "i", Token::TokenType::SIGNED_INT },
+                { "int", Token::TokenType::SIGNED_INT },
+                //long pneumonics: long, llu, ulong, ul
+                { "llu", Token::TokenType::SIGNED_LONG },
+                { "long", Token::TokenType::SIGNED_LONG },
+                //str pneumonics: string, str, s
+                { "s", Token::TokenType::STRING },
+                { "str", Token::TokenType::STRING },
+                { "string", Token::TokenType::STRING },
+                //string with its length: strn, takes a pointer and a size_t length, the text doesn't need a terminating 0
+                { "strn", Token::TokenType::STRING_LENGTH },
+                { "u", Token::TokenType::SIGNED_INT },
+                { "ui", Token::TokenType::SIGNED_INT },
+                { "uint", Token::TokenType::SIGNED_INT },
+                { "ul", Token::TokenType::SIGNED_LONG },
+                { "ulong", Token::TokenType::SIGNED_LONG },
+            };
+
+            return findByName(reserves, sizeof(reserves) / sizeof(reserves[0]), name);
+        }
         
         /**
          * Loads the next identifier
@@ -596,7 +2528,8 @@ class DebugLogger {
             currentToken.type = Token::TokenType::VARIABLE_NAME;
             currentToken.lexemeStart = format + index;
 
-            while(format[index] && (isAlpha(format, index) || format[index] == '_' || isNum(format, index))) {
+            //a dot followed by a letter continues the name, as in ctx.request
+            while(format[index] && (isAlpha(format, index) || format[index] == '_' || isNum(format, index) || (format[index] == '.' && ((format[index + 1] >= 'a' && format[index + 1] <= 'z') || (format[index + 1] >= 'A' && format[index + 1] <= 'Z') || format[index + 1] == '_')))) {
                 index++;
             }
 
@@ -692,6 +2625,28 @@ class DebugLogger {
                 getNumber(format, index);
                 return true;
             }
+            else if(format[index] == '[' && end == '}') {
+                //array argument, the separator is the text up to the closing bracket
+                index++;
+                currentToken.type = Token::TokenType::ARRAY;
+                currentToken.lexemeStart = format + index;
+
+                while(format[index] && format[index] != ']') {
+                    if(format[index] == '\\' && format[index + 1]) {
+                        index++;
+                    }
+
+                    index++;
+                }
+
+                currentToken.lexemeEnd = format + index;
+
+                if(format[index]) {
+                    index++;
+                }
+
+                return true;
+            }
             else if(format[index] == '\'') {
                 char start = (end == ']')? '[' : '{';
                 //increment index because the start of the string doesn't include the quote
@@ -754,7 +2709,7 @@ class DebugLogger {
         /**
          * Enumerates all formatting options supplied by the user
          * */
-        void collectFormattingOptions(const char* format, int& index, int& capitalized, bool& rightAligned, bool& unsignedValue, std::string& v, int& spaceCount, int& spaceCount_dec, bool& fillZero, int& outputFormat, std::string& formattedString, char end) { 
+        void collectFormattingOptions(const char* format, int& index, int& capitalized, bool& rightAligned, bool& unsignedValue, std::string& v, int& spaceCount, int& spaceCount_dec, bool& fillZero, int& outputFormat, const char*& subFormat, const char*& subFormatEnd, char end, ArrayFormat* array = nullptr) {
             bool foundDecimal = false;
 
             //implement variable grammar here
@@ -807,10 +2762,28 @@ class DebugLogger {
                 else if(currentToken.type == Token::TokenType::BINARY_MODIFIER) {
                     outputFormat = OUTPUTFORMAT_BIN;
                 }
+                else if(currentToken.type == Token::TokenType::ARRAY) {
+                    if(array) {
+                        array->enabled = true;
+                        array->separator.clear();
+
+                        for(const char* c = currentToken.lexemeStart; c < currentToken.lexemeEnd; ++c) {
+                            if(*c == '\\' && c + 1 < currentToken.lexemeEnd) {
+                                c++;
+                            }
+
+                            array->separator += *c;
+                        }
+                    }
+                }
                 else if(currentToken.type == Token::TokenType::FORMATTED_STRING) {
-                    formattedString = std::string(currentToken.lexemeStart, currentToken.lexemeEnd);
-                    if(formattedString.size() == 0) {
-                        formattedString = " ";
+                    //points into the format, an empty sub-format prints a space
+                    subFormat = currentToken.lexemeStart;
+                    subFormatEnd = currentToken.lexemeEnd;
+
+                    if(subFormat == subFormatEnd) {
+                        subFormat = " ";
+                        subFormatEnd = subFormat + 1;
                     }
                 }
                 else {
@@ -821,6 +2794,30 @@ class DebugLogger {
             }
         }
 
+        /**
+         * Prints the sub-format from @param subFormat to @param subFormatEnd, then applies the case and padding of the variable it is in
+         * Inside a message it is rendered straight into the line, so nesting allocates nothing
+         * */
+        void printSubFormat(std::ostream& output, const char* subFormat, const char* subFormatEnd, va_list& args, int capitalized, bool rightAligned, int setSpaceCount) {
+            LineStream* line = dynamic_cast<LineStream*>(&output);
+
+            if(!line) {
+                LineLease lease;
+                printSubFormat(lease.get(), subFormat, subFormatEnd, args, capitalized, rightAligned, setSpaceCount);
+                lease.get().writeTo(output);
+                return;
+            }
+
+            size_t start = line->position();
+            printFormat(*line, subFormat, (size_t)(subFormatEnd - subFormat), args);
+
+            if(capitalized != CAPITALIZEDFORMAT_NONE) {
+                line->changeCase(start, capitalized);
+            }
+
+            line->pad(start, setSpaceCount, rightAligned);
+        }
+
         /**
          * Prints the variable
          * */
@@ -830,63 +2827,131 @@ class DebugLogger {
             bool rightAligned = false;
             bool unsignedValue = false;
             std::string variableName;
-            std::string formattedString;
+            const char* subFormat = nullptr;
+            const char* subFormatEnd = nullptr;
             int setSpaceCount = -1;
             int setSpaceCount_dec = -1;
             bool fillZero = false;
             int outputFormat = OUTPUTFORMAT_DECIMAL;
 
-            collectFormattingOptions(format, index, capitalized, rightAligned, unsignedValue, variableName, setSpaceCount, setSpaceCount_dec, fillZero, outputFormat, formattedString, ']');
+            collectFormattingOptions(format, index, capitalized, rightAligned, unsignedValue, variableName, setSpaceCount, setSpaceCount_dec, fillZero, outputFormat, subFormat, subFormatEnd, ']');
+
+            //if the formatted string specifier is set, it overrides the argument specifier
+            if(subFormat) {
+                printSubFormat(output, subFormat, subFormatEnd, args, capitalized, rightAligned, setSpaceCount);
+                return;
+            }
 
             //now that we have reached the end, we can go ahead and print the variable
-            //lets check if it exists first
-            std::map<std::string, DebugVar>::iterator var = variables.find(variableName);
+            //lets check if it exists first, internal variables take priority
+            DebugVar* var = nullptr;
+            DebugVar internalVar(DebugVarType::DEBUGVAR_TYPE_COUNT, nullptr);
+            uint64_t metricInteger = 0;
+            double metricNumber = 0;
+            const InternalVariable* internal = findInternalVariable(variableName);
+
+            if(internal) {
+                internalVar = DebugVar(internal->type, internal->resolve(*this));
+                var = &internalVar;
+            }
+            else if(variableName.compare(0, 4, "ctx.") == 0) {
+                //context variables print nothing while nothing by their name is pushed
+                const LogContext::Entry* entry = LogContext::find(variableName.c_str() + 4, variableName.size() - 4);
+
+                if(entry) {
+                    internalVar = DebugVar(entry->type, LogContext::valueOf(*entry));
+                    var = &internalVar;
+                }
+            }
+            else if(metrics && variableName.compare(0, 7, "metric.") == 0) {
+                DebugVarType type = metrics->getMetric(variableName.c_str() + 7, variableName.size() - 7, metricInteger, metricNumber);
 
-            //if the formatted string specifier is set, it overrides the argument specifier
-            if(formattedString.size() > 0) {
-                std::stringstream nextOutput;
+                if(type != DebugVarType::DEBUGVAR_TYPE_COUNT) {
+                    internalVar = DebugVar(type, type == DebugVarType::INTEGER64? (void*)&metricInteger : (void*)&metricNumber);
+                    var = &internalVar;
+                }
+            }
+            else {
+                std::map<std::string, DebugVar>::iterator v = variables.find(variableName);
 
-                logInternal(nextOutput, formattedString.c_str(), args, true);
-                printFormattedString(output, nextOutput.str().c_str(), capitalized, rightAligned, setSpaceCount);
+                if(v != variables.end()) {
+                    var = &v->second;
+                }
+            }
+
+            //callback variables are printed as the type of their result
+            if(var && var->getType() == DebugVarType::FUNCTION) {
+                CallbackVariable* callback = var->getCallback();
+                unsignedValue = unsignedValue || callback->isUnsigned();
+                internalVar = DebugVar(callback->getResultType(), callback->get(state.messageCount[(int)Level::LEVEL_COUNT]));
+                var = &internalVar;
             }
-            else if(var != variables.end()) {
-                switch(var->second.getType()) {
+
+            if(var) {
+                switch(var->getType()) {
                     case DebugVarType::CHAR:
                         {
-                            char value = var->second.getChar();
+                            char value = var->getChar();
                             printFormattedChar(output, value, capitalized, rightAligned, setSpaceCount);
                         }
                         break;
                     case DebugVarType::INTEGER32:
                         {
-                            uint32_t value = var->second.getInt32();
+                            uint32_t value = var->getInt32();
                             printFormattedInteger(output, value, rightAligned, setSpaceCount, outputFormat, unsignedValue, fillZero, false);
                         }
                         break;
                     case DebugVarType::INTEGER64:
                         {
-                            uint64_t value = var->second.getInt64();
+                            uint64_t value = var->getInt64();
                             printFormattedInteger(output, value, rightAligned, setSpaceCount, outputFormat, unsignedValue, fillZero, true);
                         }
                         break;
                     case DebugVarType::FLOAT32:
                         {
-                            float value = var->second.getFloat32();
+                            float value = var->getFloat32();
                             printFormattedFloat(output, value, rightAligned, setSpaceCount, setSpaceCount_dec, fillZero);
                         }
                         break;
                     case DebugVarType::FLOAT64:
                         {
-                            double value = var->second.getFloat64();
+                            double value = var->getFloat64();
                             printFormattedFloat(output, value, rightAligned, setSpaceCount, setSpaceCount_dec, fillZero);
                         }
                         break;
                     case DebugVarType::STRING:
                         {
-                            const char* value = var->second.getString();
+                            const char* value = var->getString();
+                            printFormattedString(output, value, capitalized, rightAligned, setSpaceCount);
+                        }
+                        break;
+                    case DebugVarType::CSTRING:
+                        {
+                            const char* value = var->getCString();
+                            printFormattedString(output, value, capitalized, rightAligned, setSpaceCount);
+                        }
+                        break;
+                    case DebugVarType::ATOMIC_INTEGER64:
+                        {
+                            uint64_t value = var->getAtomicInt64();
+                            printFormattedInteger(output, value, rightAligned, setSpaceCount, outputFormat, unsignedValue, fillZero, true);
+                        }
+                        break;
+                    case DebugVarType::ATOMIC_FLOAT64:
+                        {
+                            double value = var->getAtomicFloat64();
+                            printFormattedFloat(output, value, rightAligned, setSpaceCount, setSpaceCount_dec, fillZero);
+                        }
+                        break;
+                    case DebugVarType::SEQLOCK_STRING:
+                        {
+                            char value[SeqlockString::CAPACITY];
+                            var->getSeqlockString(value);
                             printFormattedString(output, value, capitalized, rightAligned, setSpaceCount);
                         }
                         break;
+                    default:
+                        break;
                 }
             }
         }
@@ -947,9 +3012,8 @@ class DebugLogger {
             return index;
         }
 
-        double powers10[6] = { 10, 100, 1000, 10000, 100000, 1000000 };
-
         void printFormattedFloat(std::ostream& output, double value, bool right, int spaces, int decSpaces, bool fillZero) {
+            static const double powers10[6] = { 10, 100, 1000, 10000, 100000, 1000000 };
             decSpaces = (decSpaces == -1)? 6 : decSpaces;
             int tmpDecSpaces = decSpaces;
             decSpaces = std::max(0, decSpaces);
@@ -1027,41 +3091,80 @@ class DebugLogger {
             }
         }
 
-        void printFormattedStringRaw(std::ostream& output, const char* toPrint, int cap, int len) {
-            std::string buffer(toPrint, toPrint + len);
+        void printFormattedStringRaw(std::ostream& output, const char* toPrint, int cap, size_t len) {
+            if(cap == CAPITALIZEDFORMAT_NONE) {
+                output.write(toPrint, (std::streamsize)len);
+                return;
+            }
 
-            for(int i = 0; i < len; ++i) {
-                char next = toPrint[i];
+            //converted a piece at a time on the stack
+            char buffer[256];
 
-                if(cap == CAPITALIZEDFORMAT_CAPS) {
-                    next = (char)std::toupper(next);
-                }
-                else if(cap == CAPITALIZEDFORMAT_LOWER) {
-                    next = (char)std::tolower(next);
+            for(size_t done = 0; done < len; done += sizeof(buffer)) {
+                size_t count = (len - done < sizeof(buffer))? len - done : sizeof(buffer);
+
+                for(size_t i = 0; i < count; ++i) {
+                    char next = toPrint[done + i];
+
+                    if(cap == CAPITALIZEDFORMAT_CAPS) {
+                        next = (char)std::toupper(next);
+                    }
+                    else if(cap == CAPITALIZEDFORMAT_LOWER) {
+                        next = (char)std::tolower(next);
+                    }
+
+                    buffer[i] = next;
                 }
 
-                buffer[i] = next;
+                output.write(buffer, (std::streamsize)count);
             }
-
-            output << buffer;
         }
 
         void printFormattedString(std::ostream& output, const char* toPrint, int cap, bool right, int space) {
-            int len = (int)strlen(toPrint);
+            printFormattedString(output, toPrint, strlen(toPrint), cap, right, space);
+        }
 
-            if(right) {
-                for(int i = 0; i < space - len; ++i) {
-                    output << ' ';
-                }
+        void printFormattedString(std::ostream& output, const char* toPrint, size_t len, int cap, bool right, int space) {
+            size_t padding = (space > 0 && (size_t)space > len)? (size_t)space - len : 0;
 
+            if(right) {
+                printPadding(output, padding);
                 printFormattedStringRaw(output, toPrint, cap, len);
             }
             else {
                 printFormattedStringRaw(output, toPrint, cap, len);
+                printPadding(output, padding);
+            }
+        }
 
-                for(int i = 0; i < space - len; ++i) {
-                    output << ' ';
-                }
+        void printPadding(std::ostream& output, size_t count) {
+            for(size_t i = 0; i < count; ++i) {
+                output << ' ';
+            }
+        }
+
+        /**
+         * Prints a {str} or {strn} argument of @param len characters
+         * A long one without a case change is referenced by the line instead of copied into it: the caller's text
+         * stays valid until the message is written. Variables are always copied, a callback can replace its text within a message
+         * */
+        void printStringArgument(std::ostream& output, const char* toPrint, size_t len, int cap, bool right, int space) {
+            LineStream* line = (cap == CAPITALIZEDFORMAT_NONE && len >= LineStream::REFERENCE_THRESHOLD)? dynamic_cast<LineStream*>(&output) : nullptr;
+
+            if(!line) {
+                printFormattedString(output, toPrint, len, cap, right, space);
+                return;
+            }
+
+            size_t padding = (space > 0 && (size_t)space > len)? (size_t)space - len : 0;
+
+            if(right) {
+                printPadding(output, padding);
+                line->reference(toPrint, len);
+            }
+            else {
+                line->reference(toPrint, len);
+                printPadding(output, padding);
             }
         }
 
@@ -1154,23 +3257,31 @@ class DebugLogger {
             bool rightAligned = false;
             bool unsignedValue = false;
             std::string type;
-            std::string formattedString;
+            const char* subFormat = nullptr;
+            const char* subFormatEnd = nullptr;
             int setSpaceCount = -1;
             int setSpaceCount_dec = -1;
             bool fillZero = false;
             int outputFormat = OUTPUTFORMAT_DECIMAL;
+            ArrayFormat array;
 
-            collectFormattingOptions(format, index, capitalized, rightAligned, unsignedValue, type, setSpaceCount, setSpaceCount_dec, fillZero, outputFormat, formattedString, '}');
+            collectFormattingOptions(format, index, capitalized, rightAligned, unsignedValue, type, setSpaceCount, setSpaceCount_dec, fillZero, outputFormat, subFormat, subFormatEnd, '}', &array);
 
             //lookup table to determine the variable type
-            std::map<std::string, Token::TokenType>::iterator t = reserves.find(type);
+            const Reserve* t = findReserve(type);
             Token::TokenType argumentType;
 
-            if(t != reserves.end()) {
+            if(t) {
                 //its actually a reserve word
-                argumentType = t->second;
+                argumentType = t->type;
 
-                if(argumentType == Token::TokenType::SIGNED_CHAR) {
+                if(array.enabled && argumentType != Token::TokenType::HEXDUMP && argumentType != Token::TokenType::STRING_LENGTH) {
+                    const void* elements = va_arg(args, const void*);
+                    size_t count = va_arg(args, size_t);
+                    printArray(output, elements, count, argumentType, type, array.separator.empty()? state.arraySeparator : array.separator.c_str(),
+                        capitalized, rightAligned, unsignedValue || type[0] == 'u', setSpaceCount, setSpaceCount_dec, fillZero, outputFormat);
+                }
+                else if(argumentType == Token::TokenType::SIGNED_CHAR) {
                     //collect char from VA args and print
                     char ch = (char)va_arg(args, int);
                     printFormattedChar(output, ch, capitalized, rightAligned, setSpaceCount);
@@ -1189,7 +3300,25 @@ class DebugLogger {
                 }
                 else if(argumentType == Token::TokenType::STRING) {
                     const char* strValue = (const char*)va_arg(args, void*);
-                    printFormattedString(output, strValue, capitalized, rightAligned, setSpaceCount);
+                    printStringArgument(output, strValue, strlen(strValue), capitalized, rightAligned, setSpaceCount);
+                }
+                else if(argumentType == Token::TokenType::STRING_LENGTH) {
+                    const char* strValue = (const char*)va_arg(args, void*);
+                    size_t length = va_arg(args, size_t);
+                    printStringArgument(output, strValue? strValue : "", strValue? length : 0, capitalized, rightAligned, setSpaceCount);
+                }
+                else if(argumentType == Token::TokenType::HEXDUMP) {
+                    const void* data = va_arg(args, const void*);
+                    size_t length = va_arg(args, size_t);
+                    int bytesPerLine = (setSpaceCount > 0)? setSpaceCount : 16;
+                    LineStream* line = (data && length > 0)? dynamic_cast<LineStream*>(&output) : nullptr;
+
+                    if(line) {
+                        line->reserve(hexdumpSize(length, bytesPerLine));
+                    }
+
+                    printHexdump(output, (const unsigned char*)data, length, bytesPerLine,
+                        outputFormat == OUTPUTFORMAT_UPPERHEX || capitalized == CAPITALIZEDFORMAT_CAPS);
                 }
                 else {
                     //unrecognized type, ignore it
@@ -1199,6 +3328,281 @@ class DebugLogger {
             //otherwise the type was not recognized, ignore it
         }
 
+        /**
+         * Prints the @param count elements at @param elements with the same formatting options, separated by @param separator
+         * The element type comes from the argument type: char, int32, int64, float (double for dbl and double) or const char*
+         * Numbers are written straight into one buffer that is written to @param output once
+         * */
+        void printArray(std::ostream& output, const void* elements, size_t count, Token::TokenType argumentType, const std::string& type, const char* separator,
+            int capitalized, bool rightAligned, bool unsignedValue, int setSpaceCount, int setSpaceCount_dec, bool fillZero, int outputFormat) {
+            std::string text;
+            size_t separatorLength = strlen(separator);
+            int wrap = state.arrayWrap;
+
+            //the separator ends lines without its trailing spaces when wrapping
+            size_t lineEndLength = separatorLength;
+            while(lineEndLength > 0 && separator[lineEndLength - 1] == ' ') {
+                lineEndLength--;
+            }
+
+            bool doubles = argumentType == Token::TokenType::FLOAT && (type == "dbl" || type == "double");
+            text.reserve(count * (std::max(setSpaceCount, 8) + separatorLength));
+
+            for(size_t i = 0; i < count && elements; ++i) {
+                if(i > 0) {
+                    if(wrap > 0 && i % wrap == 0) {
+                        text.append(separator, lineEndLength);
+                        text += '\n';
+                    }
+                    else {
+                        text.append(separator, separatorLength);
+                    }
+                }
+
+                switch(argumentType) {
+                    case Token::TokenType::SIGNED_CHAR:
+                        {
+                            char value = ((const char*)elements)[i];
+                            value = (capitalized == CAPITALIZEDFORMAT_CAPS)? (char)std::toupper(value) : (capitalized == CAPITALIZEDFORMAT_LOWER)? (char)std::tolower(value) : value;
+                            appendPadded(text, &value, 1, rightAligned, setSpaceCount, ' ');
+                        }
+                        break;
+                    case Token::TokenType::SIGNED_INT:
+                        {
+                            uint32_t value = ((const uint32_t*)elements)[i];
+                            appendInteger(text, (!unsignedValue && (int32_t)value < 0)? (uint64_t)-(int64_t)(int32_t)value : value, !unsignedValue && (int32_t)value < 0,
+                                value, rightAligned, setSpaceCount, outputFormat, fillZero);
+                        }
+                        break;
+                    case Token::TokenType::SIGNED_LONG:
+                        {
+                            uint64_t value = ((const uint64_t*)elements)[i];
+                            appendInteger(text, (!unsignedValue && (int64_t)value < 0)? 0 - value : value, !unsignedValue && (int64_t)value < 0,
+                                value, rightAligned, setSpaceCount, outputFormat, fillZero);
+                        }
+                        break;
+                    case Token::TokenType::FLOAT:
+                        {
+                            double value = doubles? ((const double*)elements)[i] : (double)((const float*)elements)[i];
+                            appendFloat(text, value, rightAligned, setSpaceCount, setSpaceCount_dec, fillZero);
+                        }
+                        break;
+                    case Token::TokenType::STRING:
+                        {
+                            const char* value = ((const char* const*)elements)[i];
+                            value = value? value : "";
+                            size_t start = text.size();
+                            appendPadded(text, value, (int)strlen(value), rightAligned, setSpaceCount, ' ');
+
+                            if(capitalized != CAPITALIZEDFORMAT_NONE) {
+                                for(size_t c = start; c < text.size(); ++c) {
+                                    text[c] = (capitalized == CAPITALIZEDFORMAT_CAPS)? (char)std::toupper(text[c]) : (char)std::tolower(text[c]);
+                                }
+                            }
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            output.write(text.data(), (std::streamsize)text.size());
+        }
+
+        /**
+         * Where the columns of a hexdump line go, the same for every line of a dump
+         * */
+        struct HexdumpLayout {
+            int bytesPerLine;
+            int offsetDigits;
+            int hexStart;
+            int asciiStart;
+            int lineLength;
+
+            HexdumpLayout(size_t length, int bytes) {
+                bytesPerLine = std::max(1, std::min(bytes, MAX_HEXDUMP_LINE));
+                offsetDigits = 8;
+
+                while(offsetDigits < 16 && (length >> (offsetDigits * 4)) > 0) {
+                    offsetDigits++;
+                }
+
+                //new line, offset, two spaces, 3 characters per byte with an extra space every 8 bytes, a space and the ascii column
+                hexStart = 1 + offsetDigits + 2;
+                asciiStart = hexStart + bytesPerLine * 3 + (bytesPerLine - 1) / 8 + 1;
+                lineLength = asciiStart + bytesPerLine + 2;
+            }
+        };
+
+        /**
+         * Converts 16 bytes at @param in to 32 hex digits in @param pairs and their printable characters in @param ascii
+         * Unprintable bytes become '.'
+         * */
+        static void hexBlock(const unsigned char* in, char* pairs, char* ascii, bool upper) {
+#ifdef DEBUGLOGGER_SSE2
+            __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+            __m128i nibbleMask = _mm_set1_epi8(0x0F);
+            __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+            __m128i low = _mm_and_si128(bytes, nibbleMask);
+
+            //nibble + '0', plus the distance from '9' + 1 to 'a' (or 'A') for nibbles above 9
+            __m128i zero = _mm_set1_epi8('0');
+            __m128i nine = _mm_set1_epi8(9);
+            __m128i letters = _mm_set1_epi8(upper? 'A' - '0' - 10 : 'a' - '0' - 10);
+            high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letters));
+            low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letters));
+
+            _mm_storeu_si128((__m128i*)pairs, _mm_unpacklo_epi8(high, low));
+            _mm_storeu_si128((__m128i*)(pairs + 16), _mm_unpackhi_epi8(high, low));
+
+            //printable is 0x20 to 0x7E, the signed compares also reject 0x80 and up
+            __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7F)));
+            __m128i text = _mm_or_si128(_mm_and_si128(printable, bytes), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+            _mm_storeu_si128((__m128i*)ascii, text);
+#else
+            const char* digits = upper? "0123456789ABCDEF" : "0123456789abcdef";
+
+            for(int i = 0; i < 16; ++i) {
+                pairs[i * 2] = digits[in[i] >> 4];
+                pairs[i * 2 + 1] = digits[in[i] & 0xF];
+                ascii[i] = (in[i] >= 0x20 && in[i] < 0x7F)? (char)in[i] : '.';
+            }
+#endif
+        }
+
+        /**
+         * Appends @param length characters of @param value padded to @param space characters with @param fill
+         * */
+        static void appendPadded(std::string& text, const char* value, int length, bool right, int space, char fill) {
+            int padding = space - length;
+
+            if(right && padding > 0) {
+                text.append((size_t)padding, fill);
+            }
+
+            text.append(value, (size_t)length);
+
+            if(!right && padding > 0) {
+                text.append((size_t)padding, fill);
+            }
+        }
+
+        /**
+         * Writes @param value in decimal ending at @param end, two digits at a time
+         * @return the first character written
+         * */
+        static char* writeDecimal(char* end, uint64_t value) {
+            static const char pairs[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+
+            while(value >= 100) {
+                int pair = (int)(value % 100) * 2;
+                value /= 100;
+                *--end = pairs[pair + 1];
+                *--end = pairs[pair];
+            }
+
+            if(value >= 10) {
+                int pair = (int)value * 2;
+                *--end = pairs[pair + 1];
+                *--end = pairs[pair];
+            }
+            else {
+                *--end = (char)('0' + value);
+            }
+
+            return end;
+        }
+
+        /**
+         * Appends an array element the way printFormattedInteger prints it
+         * @param magnitude the absolute value printed in decimal, @param negative whether a minus sign goes in front
+         * @param bits the raw value printed in hex and binary
+         * */
+        void appendInteger(std::string& text, uint64_t magnitude, bool negative, uint64_t bits, bool right, int space, int outputFormat, bool fillZero) {
+            char buffer[129];
+            char* start;
+            int length;
+
+            if(outputFormat == OUTPUTFORMAT_DECIMAL) {
+                start = writeDecimal(buffer + sizeof(buffer), magnitude);
+
+                if(negative) {
+                    *--start = '-';
+                }
+
+                length = (int)(buffer + sizeof(buffer) - start);
+            }
+            else {
+                start = buffer;
+                length = (outputFormat == OUTPUTFORMAT_BIN)? printBinToBuffer(buffer, bits) : printHexToBuffer(buffer, bits, outputFormat == OUTPUTFORMAT_UPPERHEX);
+            }
+
+            appendPadded(text, start, length, right, space, fillZero? '0' : ' ');
+        }
+
+        /**
+         * Appends an array element exactly the way printFormattedFloat prints it
+         * Values that fit in 15 significant digits are rounded and printed with integer arithmetic, the rest go through printFormattedFloat
+         * */
+        void appendFloat(std::string& text, double value, bool right, int spaces, int decSpaces, bool fillZero) {
+            static const uint64_t powers10[7] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+            int decimals = (decSpaces == -1)? 6 : decSpaces;
+            int rounding = std::min(5, std::max(0, decimals));
+
+            if(!(value > -1e9 && value < 1e9)) {
+                std::stringstream slow;
+                printFormattedFloat(slow, value, right, spaces, decSpaces, fillZero);
+                text += slow.str();
+                return;
+            }
+
+            //printFormattedFloat rounds by adding .5 and truncating toward zero
+            double scaled = value * (double)powers10[rounding] + .5;
+            int64_t rounded = (int64_t)scaled;
+            bool negative = rounded < 0 || (rounded == 0 && scaled < 0);
+            uint64_t magnitude = (uint64_t)(rounded < 0? -rounded : rounded);
+
+            char buffer[32];
+            char* end = buffer + sizeof(buffer);
+            char* start = end;
+
+            //digits past the rounding are always zeros
+            int zeros = std::max(0, decimals - rounding);
+
+            if(decimals > 0) {
+                uint64_t fraction = magnitude % powers10[rounding];
+
+                for(int i = 0; i < rounding; ++i) {
+                    *--start = (char)('0' + fraction % 10);
+                    fraction /= 10;
+                }
+
+                *--start = '.';
+            }
+
+            start = writeDecimal(start, magnitude / powers10[rounding]);
+
+            if(negative) {
+                *--start = '-';
+            }
+
+            int padding = spaces - (int)(end - start) - zeros;
+
+            if(right && padding > 0) {
+                text.append((size_t)padding, fillZero? '0' : ' ');
+            }
+
+            text.append(start, end);
+            text.append((size_t)zeros, '0');
+
+            if(!right && padding > 0) {
+                text.append((size_t)padding, fillZero? '0' : ' ');
+            }
+        }
+
         /**
          * Prints an argument and returns whether the entire string has been finished or not
          * Prints each character until a special one is found:
@@ -1229,7 +3633,7 @@ class DebugLogger {
                     while(format[index] != '[' && format[index] != '{' && format[index] != '}' && format[index] != ']' && format[index] != '\\' && format[index]) {
                         index++;
                     }
-                    outputStream << std::string(format + startIndex, format + index);
+                    outputStream.write(format + startIndex, index - startIndex);
                     index--;
                     break;
             }
@@ -1260,7 +3664,7 @@ class DebugLogger {
                         index++;
                     }
 
-                    outputStream << std::string(format + startIndex, format + index);
+                    outputStream.write(format + startIndex, index - startIndex);
                     index--;
                     break;
             }
@@ -1269,26 +3673,65 @@ class DebugLogger {
             return format[index];
         }
 
-        //raw values for total time
-        double timeVars[5] = { 0 };
-        long long totalNanoseconds = 0;
-
-        //raw values for total time
-        double elapsedTimeVars[5] = { 0 };
+        static constexpr char PREFIX_DEFAULT = -1;
 
         /**
-         * Stores the number of messages at each level
-         * messageCount[LEVEL_COUNT] is the total number of messages sent to the debugger
+         * Per logger values backing the internal variables
+         * Plain data only, so a logger is constructed without touching the heap
          * */
-        long long messageCount[(int)Level::LEVEL_COUNT + 1];
-        long long currentMessageCount = 0;
+        struct LoggerState {
+            //raw values for total time and time since the previous message
+            long long totalNanoseconds = 0;
+            long long elapsedNanoseconds = 0;
+
+            //holds the value of a computed internal variable while it is printed
+            double scratchFloat = 0;
+            long long scratchInteger = 0;
+            const char* scratchText = nullptr;
+
+            //wall clock time of the message in microseconds, read by the first wall clock variable of each message
+            long long wallClockMessage = -1;
+            long long wallClockMicroseconds = 0;
+
+            //separator and elements per line of array arguments, see setArrayFormat
+            char arraySeparator[8] = ", ";
+            int arrayWrap = 0;
+
+            //the call site being printed by traceSite, nullptr otherwise
+            const CallSite* callSite = nullptr;
+
+            //level of the message being printed
+            Level currentLevel = Level::LEVEL_TRACE;
+
+            //identity and prefix of the registry logger currently printing through this logger, nullptr when printing for itself
+            const char* nameOverride = nullptr;
+            const char* prefixOverride = nullptr;
+
+            /**
+             * Stores the number of messages at each level
+             * messageCount[LEVEL_COUNT] is the total number of messages sent to the debugger
+             * */
+            long long messageCount[(int)Level::LEVEL_COUNT + 1] = { 0 };
+            long long currentMessageCount = 0;
+
+            //an array of level names, levelNames[LEVEL_COUNT] is the current level
+            const char* levelNames[(int)Level::LEVEL_COUNT + 1] = { "", "TCE", "WNG", "ERR", "CRT", "TCE" };
+
+            /**
+             * Index into prefixStorage of each level's prefix, PREFIX_DEFAULT for DEFAULT_PREFIX
+             * */
+            char prefixSource[(int)Level::LEVEL_COUNT] = { PREFIX_DEFAULT, PREFIX_DEFAULT, PREFIX_DEFAULT, PREFIX_DEFAULT, PREFIX_DEFAULT };
+
+            //special characters as internal variables
+            char specialCharacters[6] = "{}[]\\";
+        };
 
         /*
         * prints to the output stream the debug format
         */
         void printPrefix(std::ostream& output, Level level, va_list& args) {
-            const char* format = prefixFormat[(int)level].c_str();
-            int len = (int)prefixFormat[(int)level].size();
+            const char* format = state.prefixOverride? state.prefixOverride : getPrefix(level);
+            int len = (int)strlen(format);
             int formatIndex = 0;
             int previousFormatIndex = -1;
 
@@ -1305,25 +3748,47 @@ class DebugLogger {
         struct DebugVar {
             public:
 
-                DebugVar(DebugVarType type, void* value, bool readOnly = false) 
+                DebugVar(DebugVarType type, void* value) 
                     :type(type),
-                    value(value),
-                    readonly(readOnly)
+                    value(value)
+                {
+                }
+
+                /**
+                 * Takes ownership of @param callback
+                 * */
+                DebugVar(CallbackVariable* callback)
+                    :type(DebugVarType::FUNCTION),
+                    value(callback),
+                    callback(callback)
                 {
                 }
 
+                //a copy of a callback variable gets its own, so two loggers never share a memoized value
                 DebugVar(const DebugVar& var)
                     :type(var.type),
-                    value(var.value)
+                    value(var.value),
+                    callback(var.callback? var.callback->clone() : nullptr)
                 {
+                    if(callback) {
+                        value = callback.get();
+                    }
                 }
 
+                DebugVar(DebugVar&&) = default;
+
                 DebugVar& operator=(const DebugVar& var) {
-                    this->type = var.type;
-                    this->value = var.value;
+                    if(this != &var) {
+                        this->type = var.type;
+                        this->callback.reset(var.callback? var.callback->clone() : nullptr);
+                        this->value = this->callback? this->callback.get() : var.value;
+                    }
+
                     return *this;
                 }
 
+                DebugVar& operator=(DebugVar&&) = default;
+
                 char getChar() {
                     return *(char*)value;
                 }
@@ -1348,20 +3813,64 @@ class DebugLogger {
                     return &(*(std::string*)value)[0];
                 }
 
-                DebugVarType getType() const {
-                    return type;
+                const char* getCString() {
+                    return *(const char**)value;
+                }
+
+                int64_t getAtomicInt64() {
+                    return ((std::atomic<int64_t>*)value)->load(std::memory_order_relaxed);
+                }
+
+                double getAtomicFloat64() {
+                    return ((std::atomic<double>*)value)->load(std::memory_order_relaxed);
                 }
 
-                bool getReadonly() {
-                    return readonly;
+                void getSeqlockString(char* out) {
+                    ((SeqlockString*)value)->get(out);
+                }
+
+                CallbackVariable* getCallback() {
+                    return (CallbackVariable*)value;
+                }
+
+                DebugVarType getType() const {
+                    return type;
                 }
 
             private:
                 DebugVarType type;
                 void* value;
-                bool readonly = false;
+
+                //owns a callback variable, value points to it
+                std::unique_ptr<CallbackVariable> callback;
         };
 
+        /**
+         * Adds @param var as @param name if the name is a valid identifier that isn't taken
+         * */
+        bool insertVariable(const std::string& name, DebugVar var) {
+            //validate variable
+            const char* varName = name.c_str();
+            int index = 0;
+            if(isAlpha(varName, index) || varName[0] == '_') {
+                index++;
+
+                while(varName[index] && (isAlpha(varName, index) || varName[index] == '_' || isNum(varName, index))) {
+                    index++;
+                }
+                
+                if(index == name.size()) {
+                    if(findInternalVariable(name) == nullptr && variables.find(name) == variables.end()) {
+                        variables.emplace(name, std::move(var));
+                        return true;
+                    }
+                }
+            }
+
+            //improper var name or something
+            return false;
+        }
+
         bool isNum(const char* format, int& index) {
             return (format[index] >= '0' && format[index] <= '9');
         }
@@ -1386,25 +3895,24 @@ class DebugLogger {
         //the logger's name
         std::string loggerName;
 
-        //special characters as internal variables
-        char specialCharacters[6] = "{}[]\\";
+        //counters, times and names backing the internal variables
+        LoggerState state;
 
-        //list of every usable variable
+        //list of every user variable, internal variables live in the shared table of findInternalVariable
         std::map<std::string, DebugVar> variables;
 
-        //list of reserves
-        std::map<std::string, Token::TokenType> reserves;
-
-        //an array of level names
-        std::string levelNames[(int)Level::LEVEL_COUNT + 1];
-
         /**
          * A string representing the prefix of each debug
          * Can access internal variables and is updated on each print
          * You can use a different format for each debug level if you want, but you have to specify it with specific function calls
          * Calling the funciton to set the prefix format globally will overwrite it for all level counts!
+         * prefixes[NONE] holds the prefix shared by all levels, the rest are set per level. Null until a prefix is set
          * */
-        std::string prefixFormat[(int)Level::LEVEL_COUNT];
+        struct PrefixStorage {
+            std::string prefixes[(int)Level::LEVEL_COUNT];
+        };
+
+        CopiedPointer<PrefixStorage> prefixStorage;
 
         /**
          * Timer to keep track of time and changes in it
@@ -1412,14 +3920,39 @@ class DebugLogger {
         Timer timer;
 
         /**
-         * Whether it prints colors to the scren
+         * When it prints colors to the screen
+         * */
+        ColorMode colorMode = ColorMode::AUTO;
+
+        /**
+         * Whether colors are printed to the target stream, cached from colorMode and the target stream
          * */
-        bool enableColor = true;
+        bool colorActive = false;
 
         /**
          * The target output stream
          * */
         std::ostream* targetStream;
+
+        /**
+         * The target output stream when it is a LogSink, which is told about each message before it is written
+         * */
+        LogSink* targetSink = nullptr;
+
+        /**
+         * Receives every log call when set
+         * */
+        LogRecorder* recorder = nullptr;
+
+        /**
+         * Resolves [metric.name] variables when set
+         * */
+        MetricSource* metrics = nullptr;
+
+        /**
+         * Measurements of the logger itself, null while instrumentation is disabled
+         * */
+        CopiedPointer<LoggerStats> instrumentation;
 };
 
 #endif
\ No newline at end of file
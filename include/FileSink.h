@@ -0,0 +1,163 @@
+#ifndef INCLUDE_FILE_SINK_H
+#define INCLUDE_FILE_SINK_H
+
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+
+#include "LogSink.h"
+#include "TimeIndex.h"
+
+/**
+ * Output that writes plain text to a file, with an optional sidecar time index (see TimeIndex.h)
+ * ```
+ * FileSink sink("trace.log");
+ * sink.enableTimeIndex("trace.log.idx");
+ * logger.setTargetOutput(&sink);
+ * ```
+ * Each message is one buffered write under a lock, so several loggers and threads can share the sink
+ * The file is written when its buffer fills and when the sink is flushed (std::flush)
+ * @author Bryce Young
+ * */
+class FileSink : public LogSink {
+    public:
+        /**
+         * @param path the file to create, replacing any file already there
+         * @param bufferSize bytes buffered before they are written to the file
+         * */
+        FileSink(const char* path, size_t bufferSize = 65536)
+            :LogSink(&buffer),
+            buffer(*this)
+        {
+            file = fopen(path, "wb");
+
+            if(!file) {
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            setvbuf(file, nullptr, _IOFBF, bufferSize);
+        }
+
+        ~FileSink() {
+            if(file) {
+                fclose(file);
+            }
+        }
+
+        FileSink(const FileSink&) = delete;
+        FileSink& operator=(const FileSink&) = delete;
+
+        /**
+         * Returns whether the file could be created
+         * */
+        bool isOpen() const {
+            return file != nullptr;
+        }
+
+        /**
+         * Writes an index of the messages of the logger writing to this sink to @param path, see TimeIndex.h
+         * An entry is added every @param everyMessages messages or @param everyMilliseconds of logger time, whichever comes first
+         * */
+        bool enableTimeIndex(const char* path, uint64_t everyMessages = 1000, uint64_t everyMilliseconds = 1000) {
+            std::lock_guard<std::mutex> guard(lock);
+            bool opened = file && index.open(path, false, everyMessages, everyMilliseconds);
+            indexing.store(opened, std::memory_order_relaxed);
+            return opened;
+        }
+
+        void beginMessage(uint64_t nanoseconds, uint64_t messageCount) override {
+            //the entry is made by the write of the message, under its lock
+            if(indexing.load(std::memory_order_relaxed)) {
+                setPendingMessage(nanoseconds, messageCount);
+            }
+        }
+
+        /**
+         * Writes the pieces straight from where they are, under one lock so the message stays whole
+         * */
+        bool writeMessage(const LogSegment* segments, size_t count) override {
+            if(!file) {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            indexMessage();
+            bool complete = true;
+
+            for(size_t i = 0; i < count; ++i) {
+                size_t written = fwrite(segments[i].data, 1, segments[i].length, file);
+                offset.fetch_add(written, std::memory_order_relaxed);
+                complete = complete && written == segments[i].length;
+            }
+
+            return complete;
+        }
+
+        /**
+         * Returns the number of bytes written to the sink
+         * */
+        uint64_t getBytes() const {
+            return offset.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class SinkBuffer<FileSink>;
+
+        bool write(const char* data, size_t length) {
+            if(!file) {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            indexMessage();
+            size_t written = fwrite(data, 1, length, file);
+            offset.fetch_add(written, std::memory_order_relaxed);
+            return written == length;
+        }
+
+        /**
+         * Adds an index entry at the current offset if the message about to be written is due one, the lock must be held
+         * The log is flushed first, so the index never points past what is in the file, even after a crash
+         * */
+        void indexMessage() {
+            uint64_t nanoseconds;
+            uint64_t messageCount;
+
+            if(!takePendingMessage(nanoseconds, messageCount) || !index.isDue(nanoseconds, messageCount)) {
+                return;
+            }
+
+            fflush(file);
+
+            TimeIndex::Entry entry;
+            entry.nanoseconds = nanoseconds;
+            entry.messageCount = messageCount;
+            entry.fileOffset = offset.load(std::memory_order_relaxed);
+            index.markDue(entry);
+            index.write(entry);
+        }
+
+        /**
+         * Flushing the stream writes the file's buffer and the index
+         * */
+        void sync() {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if(file) {
+                fflush(file);
+            }
+
+            index.flush();
+        }
+
+        SinkBuffer<FileSink> buffer;
+        FILE* file = nullptr;
+
+        std::mutex lock;
+        std::atomic<uint64_t> offset{ 0 };
+        TimeIndex::Writer index;
+        std::atomic<bool> indexing{ false };
+};
+
+#endif
@@ -0,0 +1,710 @@
+#ifndef INCLUDE_FLIGHT_RECORDER_H
+#define INCLUDE_FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdarg.h>
+
+#include "DebugLogger.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#define FLIGHT_RECORDER_SIGNALS 1
+#endif
+
+/**
+ * Always on in-memory ring of the most recent log calls on every level, for postmortems
+ * Attach it to a logger with setRecorder(). Every call is recorded, even when the level filters it out
+ * Records are binary: the format pointer plus the raw arguments (strings are copied, up to the space left in the record)
+ * [ctx.name] values (see LogContext) are captured into the record too, since the context is gone by the time the ring is dumped
+ * The ring is dumped as text when critical() is called or when SIGSEGV/SIGABRT arrives, using only async-signal-safe calls
+ * ```
+ * FlightRecorder recorder(8192, "flight.log");
+ * recorder.installSignalHandlers();
+ * logger.setRecorder(&recorder);
+ * ```
+ * @author Bryce Young
+ * */
+class FlightRecorder : public LogRecorder {
+    public:
+        static constexpr int MAX_ARGUMENTS = 8;
+        static constexpr int RECORD_SIZE = 256;
+        //slots a thread claims from the ring at a time, so the shared head is only touched once per CLAIM_SIZE records
+        static constexpr uint64_t CLAIM_SIZE = 16;
+
+        /**
+         * @param capacity the number of records kept, rounded up to a power of two
+         * @param dumpPath the file the ring is dumped to on critical() and fatal signals, nullptr to only dump manually
+         * */
+        FlightRecorder(size_t capacity = 8192, const char* dumpPath = nullptr)
+            :id(nextId().fetch_add(1, std::memory_order_relaxed))
+        {
+            size_t size = 1;
+
+            while(size < capacity || size < CLAIM_SIZE) {
+                size *= 2;
+            }
+
+            mask = size - 1;
+            records = new Record[size];
+            tsc = TscClock::isInvariant();
+
+            for(size_t i = 0; i < size; ++i) {
+                records[i].sequence.store(0, std::memory_order_relaxed);
+            }
+
+            setDumpPath(dumpPath);
+        }
+
+        ~FlightRecorder() {
+            if(signalRecorderStorage() == this) {
+                signalRecorderStorage() = nullptr;
+            }
+
+            delete[] records;
+        }
+
+        FlightRecorder(const FlightRecorder&) = delete;
+        FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+        /**
+         * Sets the file the ring is dumped to on critical() and fatal signals
+         * The path is copied into a fixed buffer so the signal handler doesn't need to allocate
+         * */
+        void setDumpPath(const char* path) {
+            dumpPath[0] = 0;
+
+            if(path) {
+                strncpy(dumpPath, path, sizeof(dumpPath) - 1);
+                dumpPath[sizeof(dumpPath) - 1] = 0;
+            }
+        }
+
+        /**
+         * Records one log call, lock free and safe to call from any thread
+         * Each thread takes its slots CLAIM_SIZE at a time, so records of different threads are only in order to within a claim:
+         * sort a dump by time to interleave threads exactly
+         * */
+        void record(Level lev, const char* format, va_list& args) override {
+            uint64_t index = claimSlot();
+            Record& r = records[index & mask];
+
+            if(!beginWrite(r, index)) {
+                return;
+            }
+
+            //raw ticks, converted to nanoseconds when the ring is dumped
+            r.ticks = readTicks();
+            r.format = format;
+            r.level = (uint8_t)lev;
+
+            const Signature& signature = getSignature(format);
+            r.argumentCount = signature.count;
+            int textUsed = 0;
+
+            va_list copy;
+            va_copy(copy, args);
+
+            for(int i = 0; i < signature.count; ++i) {
+                char type = signature.types[i];
+                r.types[i] = type;
+
+                switch(type) {
+                    case 'c':
+                        r.arguments[i] = (uint64_t)va_arg(copy, int);
+                        break;
+                    case 'i':
+                    case 'u':
+                        r.arguments[i] = (uint64_t)va_arg(copy, uint32_t);
+                        break;
+                    case 'l':
+                    case 'L':
+                        r.arguments[i] = va_arg(copy, uint64_t);
+                        break;
+                    case 'f':
+                        {
+                            double value = va_arg(copy, double);
+                            memcpy(&r.arguments[i], &value, sizeof(value));
+                        }
+                        break;
+                    case 'p':
+                        //the elements may be gone by the time the ring is dumped, only the count is printed
+                        r.arguments[i] = (uint64_t)(uintptr_t)va_arg(copy, const void*);
+                        break;
+                    case 'z':
+                        r.arguments[i] = (uint64_t)va_arg(copy, size_t);
+                        break;
+                    case 's':
+                        r.arguments[i] = copyText(r, textUsed, (const char*)va_arg(copy, void*));
+                        break;
+                }
+            }
+
+            va_end(copy);
+
+            //the thread's context is gone by the time the ring is dumped, so [ctx.name] values are captured now, after the arguments
+            int contextCount = signature.contextCount < MAX_ARGUMENTS - signature.count? signature.contextCount : MAX_ARGUMENTS - signature.count;
+            r.contextCount = (uint8_t)contextCount;
+
+            for(int i = 0; i < contextCount; ++i) {
+                int slot = signature.count + i;
+                const LogContext::Entry* entry = LogContext::find(signature.contextNames[i], signature.contextLengths[i]);
+
+                if(!entry) {
+                    //nothing by that name is pushed, prints nothing like the logger does
+                    r.types[slot] = 0;
+                }
+                else if(entry->type == DebugVarType::INTEGER64) {
+                    r.types[slot] = 'l';
+                    r.arguments[slot] = (uint64_t)entry->integer;
+                }
+                else if(entry->type == DebugVarType::FLOAT64) {
+                    r.types[slot] = 'f';
+                    memcpy(&r.arguments[slot], &entry->number, sizeof(entry->number));
+                }
+                else {
+                    r.types[slot] = 's';
+                    r.arguments[slot] = copyText(r, textUsed, entry->text);
+                }
+            }
+
+            endWrite(r, index);
+
+            if(lev == Level::CRITICAL_ERROR && dumpPath[0]) {
+                dump(dumpPath);
+            }
+        }
+
+        /**
+         * Writes every record in the ring to @param path, oldest first
+         * Only uses async-signal-safe calls
+         * @return false if the file couldn't be opened
+         * */
+        bool dump(const char* path) const {
+#ifdef FLIGHT_RECORDER_SIGNALS
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            if(fd < 0) {
+                return false;
+            }
+
+            dumpToFd(fd);
+            close(fd);
+            return true;
+#else
+            (void)path;
+            return false;
+#endif
+        }
+
+        /**
+         * Writes every record in the ring to the file descriptor @param fd, oldest first
+         * One line per record: #sequence nanoseconds level message
+         * Arguments are printed without their formatting options, [ctx.name] values as captured and other variables as written
+         * Only uses async-signal-safe calls
+         * */
+        void dumpToFd(int fd) const {
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t start = (end > mask + 1)? end - (mask + 1) : 0;
+            static const char* const names[(int)Level::LEVEL_COUNT] = { "NON", "TCE", "WNG", "ERR", "CRT" };
+
+            for(uint64_t index = start; index < end; ++index) {
+                const Record& r = records[index & mask];
+                Record copy;
+
+                //copy the record and make sure it wasn't rewritten while copying
+                if(r.sequence.load(std::memory_order_acquire) != written(index)) {
+                    continue;
+                }
+
+                copy.ticks = r.ticks;
+                copy.format = r.format;
+                copy.level = r.level;
+                copy.argumentCount = r.argumentCount;
+                copy.contextCount = r.contextCount;
+                memcpy(copy.types, r.types, sizeof(copy.types));
+                memcpy(copy.arguments, r.arguments, sizeof(copy.arguments));
+                memcpy(copy.text, r.text, sizeof(copy.text));
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                //a writer marks the slot before it writes to it, see beginWrite()
+                if(r.sequence.load(std::memory_order_relaxed) != written(index)) {
+                    continue;
+                }
+
+                Writer out(fd);
+                out.put('#');
+                out.putUnsigned(index);
+                out.put(' ');
+                out.putUnsigned(TscClock::toNanoseconds(copy.ticks));
+                out.put(' ');
+                out.putText(copy.level < (int)Level::LEVEL_COUNT? names[copy.level] : "???");
+                out.put(' ');
+                writeMessage(out, copy);
+                out.put('\n');
+                out.flush();
+            }
+        }
+
+        /**
+         * Dumps the ring to the dump path when SIGSEGV or SIGABRT arrives, then lets the signal kill the process
+         * Only one recorder can own the signal handlers
+         * */
+        void installSignalHandlers() {
+#ifdef FLIGHT_RECORDER_SIGNALS
+            signalRecorderStorage() = this;
+
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = &FlightRecorder::onFatalSignal;
+            action.sa_flags = SA_RESETHAND;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGSEGV, &action, nullptr);
+            sigaction(SIGABRT, &action, nullptr);
+#endif
+        }
+
+        /**
+         * Returns the number of slots handed out so far, including the ones overwritten
+         * This is ahead of the calls recorded by the slots each thread has claimed and not used yet, up to CLAIM_SIZE per thread
+         * */
+        uint64_t getRecordCount() const {
+            return head.load(std::memory_order_relaxed);
+        }
+
+    private:
+        //the text fills what is left after the 40 byte header and the arguments
+        static constexpr int TEXT_SIZE = RECORD_SIZE - 40 - MAX_ARGUMENTS * 8;
+
+        struct Record {
+            //(index + 1) * 2 once written, odd while a writer is writing it, see beginWrite()
+            std::atomic<uint64_t> sequence;
+            //TscClock ticks when the TSC is invariant, steady_clock nanoseconds otherwise
+            uint64_t ticks;
+            const char* format;
+            uint8_t level;
+            uint8_t argumentCount;
+            //[ctx.name] values captured after the arguments
+            uint8_t contextCount;
+            char types[MAX_ARGUMENTS];
+            uint64_t arguments[MAX_ARGUMENTS];
+            char text[TEXT_SIZE];
+        };
+
+        static_assert(sizeof(Record) == RECORD_SIZE, "flight recorder records should fill their size exactly");
+
+        /**
+         * The argument types of a format, cached per thread by format pointer
+         * */
+        struct Signature {
+            const char* format = nullptr;
+            int count = 0;
+            char types[MAX_ARGUMENTS] = { 0 };
+            //the names of the [ctx.name] references, without "ctx.", pointing into the format
+            int contextCount = 0;
+            const char* contextNames[MAX_ARGUMENTS] = { nullptr };
+            int contextLengths[MAX_ARGUMENTS] = { 0 };
+        };
+
+        static const Signature& getSignature(const char* format) {
+            static thread_local Signature cache[256];
+            Signature& signature = cache[((uintptr_t)format >> 3) & 255];
+
+            if(signature.format != format) {
+                int count = DebugLogger::getArgumentTypes(format, signature.types, MAX_ARGUMENTS);
+                signature.count = count < MAX_ARGUMENTS? count : MAX_ARGUMENTS;
+                signature.contextCount = 0;
+
+                for(int index = 0; format[index] && signature.contextCount < MAX_ARGUMENTS; ++index) {
+                    if(format[index] == '\\' && format[index + 1]) {
+                        index++;
+                        continue;
+                    }
+
+                    const char* name;
+                    int length;
+                    int end = findContextReference(format, index, name, length);
+
+                    if(end >= 0) {
+                        signature.contextNames[signature.contextCount] = name;
+                        signature.contextLengths[signature.contextCount] = length;
+                        signature.contextCount++;
+                        index = end;
+                    }
+                }
+
+                signature.format = format;
+            }
+
+            return signature;
+        }
+
+        /**
+         * Returns where the [ctx.name] reference starting at @param index of @param format ends (its ']'), -1 if there is none there
+         * @param name and @param length are set to the name after "ctx."
+         * */
+        static int findContextReference(const char* format, int index, const char*& name, int& length) {
+            if(format[index] != '[') {
+                return -1;
+            }
+
+            int end = index + 1;
+
+            //sub-formats and nested brackets are never a plain variable reference
+            while(format[end] && format[end] != ']' && format[end] != '[' && format[end] != '{' && format[end] != '\'') {
+                end++;
+            }
+
+            if(format[end] != ']') {
+                return -1;
+            }
+
+            //the name is the run of identifier characters before the ']', after any print options
+            int start = end;
+
+            while(start > index + 1 && isNameCharacter(format[start - 1])) {
+                start--;
+            }
+
+            if(end - start <= 4 || strncmp(format + start, "ctx.", 4) != 0) {
+                return -1;
+            }
+
+            name = format + start + 4;
+            length = end - start - 4;
+            return end;
+        }
+
+        static bool isNameCharacter(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+        }
+
+        /**
+         * Copies as much of @param text as fits in the text buffer of @param r after @param textUsed
+         * @return the offset and length in the text buffer, as stored in the arguments
+         * */
+        static uint64_t copyText(Record& r, int& textUsed, const char* text) {
+            int length = text? (int)strnlen(text, TEXT_SIZE - textUsed) : 0;
+            memcpy(r.text + textUsed, text, length);
+
+            uint64_t packed = ((uint64_t)textUsed << 16) | (uint64_t)length;
+            textUsed += length;
+            return packed;
+        }
+
+        /**
+         * Small buffered writer for the dump, async-signal-safe
+         * */
+        class Writer {
+            public:
+                Writer(int fd)
+                    :fd(fd)
+                {
+                }
+
+                void put(char c) {
+                    if(used == sizeof(buffer)) {
+                        flush();
+                    }
+
+                    buffer[used++] = c;
+                }
+
+                void putText(const char* text, int length = -1) {
+                    for(int i = 0; (length < 0)? text[i] != 0 : i < length; ++i) {
+                        put(text[i]);
+                    }
+                }
+
+                void putUnsigned(uint64_t value) {
+                    char digits[20];
+                    int count = 0;
+
+                    do {
+                        digits[count++] = (char)('0' + value % 10);
+                        value /= 10;
+                    } while(value);
+
+                    while(count) {
+                        put(digits[--count]);
+                    }
+                }
+
+                void putSigned(int64_t value) {
+                    if(value < 0) {
+                        put('-');
+                        putUnsigned((uint64_t)0 - (uint64_t)value);
+                    }
+                    else {
+                        putUnsigned((uint64_t)value);
+                    }
+                }
+
+                void putFloat(double value) {
+                    if(value != value) {
+                        putText("nan");
+                        return;
+                    }
+
+                    if(value < 0) {
+                        put('-');
+                        value = -value;
+                    }
+
+                    if(value >= 1e19) {
+                        putText("inf");
+                        return;
+                    }
+
+                    uint64_t whole = (uint64_t)value;
+                    uint64_t fraction = (uint64_t)((value - (double)whole) * 1e6 + .5);
+
+                    if(fraction >= 1000000) {
+                        whole++;
+                        fraction -= 1000000;
+                    }
+
+                    putUnsigned(whole);
+                    put('.');
+
+                    for(uint64_t digit = 100000; digit; digit /= 10) {
+                        put((char)('0' + (fraction / digit) % 10));
+                    }
+                }
+
+                void flush() {
+#ifdef FLIGHT_RECORDER_SIGNALS
+                    const char* next = buffer;
+
+                    while(used > 0) {
+                        ssize_t written = write(fd, next, used);
+
+                        if(written <= 0) {
+                            break;
+                        }
+
+                        next += written;
+                        used -= (int)written;
+                    }
+#endif
+                    used = 0;
+                }
+
+            private:
+                int fd;
+                char buffer[512];
+                int used = 0;
+        };
+
+        /**
+         * Prints the format of @param r with its arguments in place of each {} and its captured context in place of each [ctx.name]
+         * */
+        static void writeMessage(Writer& out, const Record& r) {
+            const char* format = r.format;
+            int argument = 0;
+            int context = 0;
+
+            for(int index = 0; format[index]; ++index) {
+                char c = format[index];
+
+                if(c == '\\' && format[index + 1]) {
+                    out.put(format[++index]);
+                }
+                else if(c == '{') {
+                    //skip to the end of the argument, sub-formats are printed as text
+                    int end = index + 1;
+
+                    while(format[end] && format[end] != '}' && format[end] != '\'') {
+                        end++;
+                    }
+
+                    if(format[end] == '\'') {
+                        index = end;
+                        continue;
+                    }
+
+                    if(argument < r.argumentCount) {
+                        argument += writeArgument(out, r, argument);
+                    }
+
+                    if(!format[end]) {
+                        break;
+                    }
+
+                    index = end;
+                }
+                else if(c == '[') {
+                    const char* name;
+                    int length;
+                    int end = findContextReference(format, index, name, length);
+
+                    if(end < 0) {
+                        out.put(c);
+                        continue;
+                    }
+
+                    //print options are not applied to captured values
+                    if(context < r.contextCount) {
+                        writeArgument(out, r, r.argumentCount + context);
+                    }
+
+                    context++;
+                    index = end;
+                }
+                else {
+                    out.put(c);
+                }
+            }
+        }
+
+        /**
+         * Writes argument number @param argument of @param r
+         * @return the number of recorded arguments it used, 2 for arrays
+         * */
+        static int writeArgument(Writer& out, const Record& r, int argument) {
+            uint64_t value = r.arguments[argument];
+
+            switch(r.types[argument]) {
+                case 'c':
+                    out.put((char)value);
+                    break;
+                case 'i':
+                    out.putSigned((int32_t)(uint32_t)value);
+                    break;
+                case 'u':
+                    out.putUnsigned((uint32_t)value);
+                    break;
+                case 'l':
+                    out.putSigned((int64_t)value);
+                    break;
+                case 'L':
+                    out.putUnsigned(value);
+                    break;
+                case 'f':
+                    {
+                        double number;
+                        memcpy(&number, &value, sizeof(number));
+                        out.putFloat(number);
+                    }
+                    break;
+                case 's':
+                    out.putText(r.text + (value >> 16), (int)(value & 0xFFFF));
+                    break;
+                case 'p':
+                    out.putText("<array of ");
+                    out.putUnsigned((argument + 1 < r.argumentCount)? r.arguments[argument + 1] : 0);
+                    out.putText(">");
+                    return 2;
+            }
+
+            return 1;
+        }
+
+#ifdef FLIGHT_RECORDER_SIGNALS
+        static void onFatalSignal(int signal) {
+            FlightRecorder* recorder = signalRecorderStorage();
+
+            if(recorder && recorder->dumpPath[0]) {
+                recorder->dump(recorder->dumpPath);
+            }
+
+            //SA_RESETHAND restored the default action, raise it again to terminate
+            raise(signal);
+        }
+#endif
+
+        //the recorder dumped by the signal handlers
+        static FlightRecorder*& signalRecorderStorage() {
+            static FlightRecorder* recorder = nullptr;
+            return recorder;
+        }
+
+        /**
+         * Reads the clock for a record. Whether the TSC is used is looked up once, when the recorder is created
+         * */
+        uint64_t readTicks() const {
+#ifdef TIMER_HAS_TSC
+            if(tsc) {
+                return __rdtsc();
+            }
+#endif
+            return SteadyClock::ticks();
+        }
+
+        /**
+         * The slots a thread has claimed and not used yet, from the recorder with the id
+         * Plain data, so the thread_local needs no constructor or guard
+         * */
+        struct Claim {
+            uint64_t recorder;
+            uint64_t next;
+            uint64_t end;
+        };
+
+        /**
+         * Returns the index of the next slot for the calling thread, claiming CLAIM_SIZE more from the ring when it has used its claim
+         * A claim the ring has lapped since is given up, writing to it would overwrite newer records
+         * */
+        uint64_t claimSlot() {
+            static thread_local Claim claim = { 0, 0, 0 };
+
+            if(claim.recorder != id || claim.next == claim.end || claim.next + mask + 1 <= head.load(std::memory_order_relaxed)) {
+                claim.next = head.fetch_add(CLAIM_SIZE, std::memory_order_relaxed);
+                claim.end = claim.next + CLAIM_SIZE;
+                claim.recorder = id;
+            }
+
+            return claim.next++;
+        }
+
+        static uint64_t written(uint64_t index) {
+            return (index + 1) * 2;
+        }
+
+        /**
+         * Marks @param r as being written for slot @param index, so the dump skips it until endWrite()
+         * A writer that stalled for a whole lap of the ring can find a newer record in its slot, or a writer in the middle of it:
+         * it gives its record up then, rather than tear or overwrite the other one. Plain stores, a locked instruction per record
+         * costs more than the rest of the record
+         * @return false if the record must not be written
+         * */
+        static bool beginWrite(Record& r, uint64_t index) {
+            uint64_t previous = r.sequence.load(std::memory_order_relaxed);
+
+            if((previous & 1) || previous >= written(index)) {
+                return false;
+            }
+
+            r.sequence.store(written(index) - 1, std::memory_order_relaxed);
+            //the mark is visible before any of the record is, like the writer of a seqlock
+            std::atomic_thread_fence(std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Publishes the record of slot @param index, unless a writer of a later lap marked @param r since beginWrite()
+         * */
+        static void endWrite(Record& r, uint64_t index) {
+            if(r.sequence.load(std::memory_order_relaxed) == written(index) - 1) {
+                r.sequence.store(written(index), std::memory_order_release);
+            }
+        }
+
+        //ids tell recorders apart in the claims of threads, even one created where a destroyed one was
+        static std::atomic<uint64_t>& nextId() {
+            static std::atomic<uint64_t> next{ 1 };
+            return next;
+        }
+
+        uint64_t id;
+        Record* records;
+        size_t mask;
+        bool tsc;
+        std::atomic<uint64_t> head{ 0 };
+        char dumpPath[256];
+};
+
+#endif
@@ -0,0 +1,497 @@
+#ifndef INCLUDE_LOG_COMPRESSION_H
+#define INCLUDE_LOG_COMPRESSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/**
+ * Block compression used by CompressedSink and the LogCat tool
+ * The compressor is a small LZ77 in the style of LZ4: greedy matching through a hash table of 4 byte sequences,
+ * a 64KB window and byte aligned tokens, so both directions run at hundreds of MB/s. Log lines repeat their prefix
+ * and most of their format, which is exactly what it finds
+ *
+ * A compressed file is the magic "DLZ1" followed by independent blocks:
+ * ```
+ * uint32 raw size | uint32 stored size (top bit set when the block is stored uncompressed) | uint32 checksum of the raw bytes | stored bytes
+ * ```
+ * Integers are little endian. Every block decodes on its own, so a file cut off in the middle of a write
+ * only loses its last block, and a reader can start at any block offset
+ * @author Bryce Young
+ * */
+class LogCompression {
+    public:
+        static constexpr uint32_t FILE_MAGIC = 0x315a4c44;
+        static constexpr size_t FILE_HEADER_SIZE = 4;
+        static constexpr size_t BLOCK_HEADER_SIZE = 12;
+        static constexpr uint32_t STORED_FLAG = 0x80000000u;
+        static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;
+
+        /**
+         * The header in front of each block
+         * */
+        struct BlockHeader {
+            uint32_t rawSize = 0;
+            uint32_t storedSize = 0;
+            uint32_t checksum = 0;
+            bool compressed = false;
+        };
+
+        /**
+         * The largest output compressBlock() can produce for @param length bytes of input
+         * */
+        static size_t maxCompressedSize(size_t length) {
+            return length + length / 255 + 16;
+        }
+
+        /**
+         * Compresses @param length bytes of @param input into @param output
+         * @return the compressed size, or 0 if it doesn't fit in @param capacity bytes
+         * */
+        static size_t compressBlock(const char* input, size_t length, char* output, size_t capacity) {
+            const uint8_t* in = (const uint8_t*)input;
+            uint8_t* out = (uint8_t*)output;
+            uint8_t* outEnd = out + capacity;
+            size_t anchor = 0;
+
+            if(length >= MIN_MATCH_INPUT) {
+                uint32_t table[HASH_SIZE];
+                memset(table, 0, sizeof(table));
+
+                //the last bytes are always literals, so matching never reads past the end
+                size_t matchLimit = length - LAST_LITERALS;
+                size_t searchLimit = length - MATCH_SEARCH_MARGIN;
+                size_t position = 1;
+                uint32_t misses = 0;
+
+                while(position < searchLimit) {
+                    uint32_t sequence = read32(in + position);
+                    uint32_t& slot = table[hash(sequence)];
+                    size_t candidate = slot;
+                    slot = (uint32_t)position;
+
+                    if(position - candidate > MAX_OFFSET || read32(in + candidate) != sequence) {
+                        //skip faster through data that doesn't compress
+                        position += 1 + (misses++ >> 6);
+                        continue;
+                    }
+
+                    while(position > anchor && candidate > 0 && in[position - 1] == in[candidate - 1]) {
+                        position--;
+                        candidate--;
+                    }
+
+                    size_t matchLength = MIN_MATCH + countMatching(in + position + MIN_MATCH, in + candidate + MIN_MATCH, in + matchLimit);
+
+                    if(!writeSequence(out, outEnd, in + anchor, position - anchor, position - candidate, matchLength)) {
+                        return 0;
+                    }
+
+                    position += matchLength;
+                    anchor = position;
+                    misses = 0;
+
+                    if(position < searchLimit) {
+                        table[hash(read32(in + position - 2))] = (uint32_t)(position - 2);
+                    }
+                }
+            }
+
+            if(!writeSequence(out, outEnd, in + anchor, length - anchor, 0, 0)) {
+                return 0;
+            }
+
+            return (size_t)(out - (uint8_t*)output);
+        }
+
+        /**
+         * Decompresses @param length bytes of @param input into exactly @param rawLength bytes of @param output
+         * Every read and write is bounds checked, so damaged input returns false rather than overrunning
+         * */
+        static bool decompressBlock(const char* input, size_t length, char* output, size_t rawLength) {
+            const uint8_t* in = (const uint8_t*)input;
+            const uint8_t* inEnd = in + length;
+            uint8_t* out = (uint8_t*)output;
+            uint8_t* outStart = out;
+            uint8_t* outEnd = out + rawLength;
+
+            while(in < inEnd) {
+                unsigned token = *in++;
+                size_t literals = token >> 4;
+
+                if(literals == 15 && !readLength(in, inEnd, literals)) {
+                    return false;
+                }
+
+                if(literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out)) {
+                    return false;
+                }
+
+                memcpy(out, in, literals);
+                in += literals;
+                out += literals;
+
+                //the last sequence has no match
+                if(in == inEnd) {
+                    return out == outEnd;
+                }
+
+                if(inEnd - in < 2) {
+                    return false;
+                }
+
+                size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+                in += 2;
+                size_t matchLength = token & 15;
+
+                if(matchLength == 15 && !readLength(in, inEnd, matchLength)) {
+                    return false;
+                }
+
+                matchLength += MIN_MATCH;
+
+                if(offset == 0 || offset > (size_t)(out - outStart) || matchLength > (size_t)(outEnd - out)) {
+                    return false;
+                }
+
+                const uint8_t* match = out - offset;
+
+                if(offset >= 8) {
+                    //8 byte steps never overlap when the match is at least 8 bytes back
+                    while(matchLength >= 8) {
+                        memcpy(out, match, 8);
+                        out += 8;
+                        match += 8;
+                        matchLength -= 8;
+                    }
+                }
+
+                while(matchLength > 0) {
+                    *out++ = *match++;
+                    matchLength--;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * 32 bit hash of @param length bytes of @param data, stored with each block to detect torn or damaged blocks
+         * */
+        static uint32_t checksum(const char* data, size_t length) {
+            uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+            size_t i = 0;
+
+            for(; i + 8 <= length; i += 8) {
+                uint64_t word;
+                memcpy(&word, data + i, 8);
+                hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+                hash ^= hash >> 32;
+            }
+
+            for(; i < length; ++i) {
+                hash = (hash ^ (uint8_t)data[i]) * 0x100000001b3ull;
+            }
+
+            hash ^= hash >> 29;
+            hash *= 0xc4ceb9fe1a85ec53ull;
+            return (uint32_t)(hash ^ (hash >> 32));
+        }
+
+        /**
+         * Writes the file magic into @param output, which must hold FILE_HEADER_SIZE bytes
+         * */
+        static void writeFileHeader(char* output) {
+            write32(output, FILE_MAGIC);
+        }
+
+        static bool checkFileHeader(const char* input) {
+            return read32((const uint8_t*)input) == FILE_MAGIC;
+        }
+
+        /**
+         * Appends the header and stored bytes of one block holding @param length bytes of @param data to @param output
+         * The block is stored uncompressed when compressing doesn't make it smaller
+         * */
+        static void encodeBlock(const char* data, size_t length, std::vector<char>& output) {
+            size_t start = output.size();
+            output.resize(start + BLOCK_HEADER_SIZE + maxCompressedSize(length));
+
+            size_t stored = compressBlock(data, length, &output[start + BLOCK_HEADER_SIZE], maxCompressedSize(length));
+            uint32_t flags = 0;
+
+            if(stored == 0 || stored >= length) {
+                memcpy(&output[start + BLOCK_HEADER_SIZE], data, length);
+                stored = length;
+                flags = STORED_FLAG;
+            }
+
+            write32(&output[start], (uint32_t)length);
+            write32(&output[start + 4], (uint32_t)stored | flags);
+            write32(&output[start + 8], checksum(data, length));
+            output.resize(start + BLOCK_HEADER_SIZE + stored);
+        }
+
+        /**
+         * Reads a block header from @param input, which must hold BLOCK_HEADER_SIZE bytes
+         * Returns false if the sizes can't belong to a block
+         * */
+        static bool readBlockHeader(const char* input, BlockHeader& header) {
+            uint32_t stored = read32((const uint8_t*)input + 4);
+            header.rawSize = read32((const uint8_t*)input);
+            header.compressed = !(stored & STORED_FLAG);
+            header.storedSize = stored & ~STORED_FLAG;
+            header.checksum = read32((const uint8_t*)input + 8);
+
+            if(header.rawSize > MAX_BLOCK_SIZE || header.storedSize > maxCompressedSize(header.rawSize)) {
+                return false;
+            }
+
+            return header.compressed || header.storedSize == header.rawSize;
+        }
+
+        /**
+         * fseek with a 64 bit offset, so files past 2GB work where long is 32 bits (Windows, 32 bit builds)
+         * @return true if the position was moved
+         * */
+        static bool seekFile(FILE* file, uint64_t offset, int origin = SEEK_SET) {
+#ifdef _WIN32
+            return _fseeki64(file, (long long)offset, origin) == 0;
+#else
+            return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+        }
+
+        /**
+         * ftell with a 64 bit result, see seekFile()
+         * @return the position, or -1 on an error
+         * */
+        static int64_t tellFile(FILE* file) {
+#ifdef _WIN32
+            return (int64_t)_ftelli64(file);
+#else
+            return (int64_t)ftello(file);
+#endif
+        }
+
+        /**
+         * Reads the blocks of a compressed file one at a time
+         * ```
+         * LogCompression::Reader reader(file);
+         * std::string text;
+         * while(reader.next(text) == LogCompression::Reader::BLOCK) {
+         *     fwrite(text.data(), 1, text.size(), stdout);
+         * }
+         * ```
+         * */
+        class Reader {
+            public:
+                enum Result {
+                    BLOCK,      //text holds the next block
+                    END,        //the file ended after a whole block
+                    TRUNCATED,  //the file ends inside a block, as it does after a crash
+                    DAMAGED     //a block header, its contents or its checksum is wrong
+                };
+
+                /**
+                 * @param file an open file positioned at the start of a compressed file, not closed by the reader
+                 * */
+                Reader(FILE* file)
+                    :file(file)
+                {
+                    char header[FILE_HEADER_SIZE];
+                    valid = fread(header, 1, FILE_HEADER_SIZE, file) == FILE_HEADER_SIZE && checkFileHeader(header);
+                    offset = FILE_HEADER_SIZE;
+                }
+
+                /**
+                 * Returns whether the file starts with the magic
+                 * */
+                bool isValid() const {
+                    return valid;
+                }
+
+                /**
+                 * Returns the file offset of the next block
+                 * */
+                uint64_t getOffset() const {
+                    return offset;
+                }
+
+                /**
+                 * Moves to the block at @param blockOffset, a value returned by getOffset()
+                 * */
+                bool seek(uint64_t blockOffset) {
+                    if(!seekFile(file, blockOffset)) {
+                        return false;
+                    }
+
+                    offset = blockOffset;
+                    return true;
+                }
+
+                /**
+                 * Decodes the next block into @param text
+                 * */
+                Result next(std::string& text) {
+                    char headerBytes[BLOCK_HEADER_SIZE];
+                    size_t headerRead = valid? fread(headerBytes, 1, BLOCK_HEADER_SIZE, file) : 0;
+
+                    if(headerRead == 0) {
+                        return valid? END : DAMAGED;
+                    }
+
+                    if(headerRead < BLOCK_HEADER_SIZE) {
+                        return TRUNCATED;
+                    }
+
+                    BlockHeader header;
+
+                    if(!readBlockHeader(headerBytes, header)) {
+                        return DAMAGED;
+                    }
+
+                    stored.resize(header.storedSize);
+
+                    if(fread(stored.data(), 1, header.storedSize, file) != header.storedSize) {
+                        return TRUNCATED;
+                    }
+
+                    offset += BLOCK_HEADER_SIZE + header.storedSize;
+
+                    if(header.compressed) {
+                        text.resize(header.rawSize);
+
+                        if(!decompressBlock(stored.data(), stored.size(), &text[0], text.size())) {
+                            return DAMAGED;
+                        }
+                    }
+                    else {
+                        text.assign(stored.data(), stored.size());
+                    }
+
+                    return checksum(text.data(), text.size()) == header.checksum? BLOCK : DAMAGED;
+                }
+
+            private:
+                FILE* file;
+                bool valid;
+                uint64_t offset;
+                std::vector<char> stored;
+        };
+
+    private:
+        static constexpr int HASH_BITS = 13;
+        static constexpr int HASH_SIZE = 1 << HASH_BITS;
+        static constexpr size_t MIN_MATCH = 4;
+        static constexpr size_t MAX_OFFSET = 65535;
+        static constexpr size_t LAST_LITERALS = 5;
+        static constexpr size_t MATCH_SEARCH_MARGIN = 12;
+        static constexpr size_t MIN_MATCH_INPUT = 13;
+
+        static uint32_t read32(const uint8_t* data) {
+            return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        }
+
+        static void write32(char* data, uint32_t value) {
+            data[0] = (char)value;
+            data[1] = (char)(value >> 8);
+            data[2] = (char)(value >> 16);
+            data[3] = (char)(value >> 24);
+        }
+
+        static uint32_t hash(uint32_t sequence) {
+            return (sequence * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        /**
+         * Counts the bytes @param a and @param match have in common, stopping at @param limit
+         * */
+        static size_t countMatching(const uint8_t* a, const uint8_t* match, const uint8_t* limit) {
+            const uint8_t* start = a;
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            while(a + 8 <= limit) {
+                uint64_t x, y;
+                memcpy(&x, a, 8);
+                memcpy(&y, match, 8);
+
+                if(x != y) {
+                    return (size_t)(a - start) + (size_t)(__builtin_ctzll(x ^ y) >> 3);
+                }
+
+                a += 8;
+                match += 8;
+            }
+#endif
+
+            while(a < limit && *a == *match) {
+                a++;
+                match++;
+            }
+
+            return (size_t)(a - start);
+        }
+
+        static bool readLength(const uint8_t*& in, const uint8_t* inEnd, size_t& length) {
+            uint8_t next;
+
+            do {
+                if(in >= inEnd) {
+                    return false;
+                }
+
+                next = *in++;
+                length += next;
+            } while(next == 255);
+
+            return true;
+        }
+
+        static void writeLength(uint8_t*& out, size_t length) {
+            while(length >= 255) {
+                *out++ = 255;
+                length -= 255;
+            }
+
+            *out++ = (uint8_t)length;
+        }
+
+        /**
+         * Writes @param literalCount literals followed by a match, or only the literals when @param matchLength is 0
+         * */
+        static bool writeSequence(uint8_t*& out, uint8_t* outEnd, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+            size_t worstCase = 1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1;
+
+            if(worstCase > (size_t)(outEnd - out)) {
+                return false;
+            }
+
+            size_t matchCode = matchLength? matchLength - MIN_MATCH : 0;
+            *out++ = (uint8_t)(((literalCount < 15? literalCount : 15) << 4) | (matchCode < 15? matchCode : 15));
+
+            if(literalCount >= 15) {
+                writeLength(out, literalCount - 15);
+            }
+
+            memcpy(out, literals, literalCount);
+            out += literalCount;
+
+            if(matchLength == 0) {
+                return true;
+            }
+
+            *out++ = (uint8_t)offset;
+            *out++ = (uint8_t)(offset >> 8);
+
+            if(matchCode >= 15) {
+                writeLength(out, matchCode - 15);
+            }
+
+            return true;
+        }
+};
+
+#endif
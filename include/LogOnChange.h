@@ -0,0 +1,220 @@
+#ifndef INCLUDE_LOGONCHANGE_H
+#define INCLUDE_LOGONCHANGE_H
+
+#include <atomic>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "DebugLogger.h"
+
+/**
+ * Traces a message only when its arguments or the variables it prints differ from the last time this call site printed,
+ * so a loop can trace its state every iteration and only the changes are written
+ * Each use creates a static ChangeSite. A call that changes nothing hashes its values, compares and returns without formatting
+ * ```
+ * DEBUG_TRACE_CHANGED(logger, "state=[st] retries={int}", retries);
+ * ```
+ * The arguments are evaluated once, like a normal trace call
+ * */
+#define DEBUG_TRACE_CHANGED(logger, format, ...) \
+    do { \
+        static ChangeSite debugChangeSite(__FILE__, __LINE__, __func__, format); \
+        debugChangeSite.trace((logger), ##__VA_ARGS__); \
+    } while(0)
+
+/**
+ * A static descriptor of one DEBUG_TRACE_CHANGED call site, holding the hash of what it printed last
+ * Threads can share the site: when several of them see the same change, only the first one prints it.
+ * A site used with several loggers compares their values with each other, give each logger its own site
+ * Hashes cover the values the message prints: numbers, text of strings, and the elements of arrays, {strn} and {hexdump}.
+ * Internal variables like times and counts are left out, they change on every message
+ * @author Bryce Young
+ * */
+struct ChangeSite : public CallSite {
+    constexpr ChangeSite(const char* file, int line, const char* function, const char* format)
+        :CallSite(file, line, function, format),
+        lastHash(0),
+        parsed(nullptr)
+    {
+    }
+
+    /**
+     * Traces the message through @param logger if the values differ from the last message of the site
+     * @return what the trace call returned, 0 if nothing was printed
+     * */
+    template<typename... Args>
+    int trace(DebugLogger& logger, Args... args) {
+        //filtered messages aren't compared either, so the first one printed after the level changes isn't skipped
+        if(logger.getLevel() > Level::LEVEL_TRACE) {
+            return 0;
+        }
+
+        //never 0, so the first call always prints
+        const ParsedFormat& parsedFormat = getParsed(logger);
+        uint64_t hash = logger.hashVariables(parsedFormat.names, hashArguments(0, parsedFormat.types.c_str(), args...)) | 1;
+
+        if(lastHash.load(std::memory_order_relaxed) == hash || lastHash.exchange(hash, std::memory_order_relaxed) == hash) {
+            return 0;
+        }
+
+        return logger.traceSite(*this, format, args...);
+    }
+
+    /**
+     * Forgets the last message, so the next call prints
+     * */
+    void reset() {
+        lastHash.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> lastHash;
+
+    /**
+     * What the site needs from its format: the variables it prints and the types of its arguments, see DebugLogger::getArgumentTypes
+     * */
+    struct ParsedFormat {
+        std::vector<std::string> names;
+        std::string types;
+    };
+
+    //parsed on the first call
+    std::atomic<ParsedFormat*> parsed;
+
+    private:
+        const ParsedFormat& getParsed(DebugLogger& logger) {
+            ParsedFormat* current = parsed.load(std::memory_order_acquire);
+
+            if(current) {
+                return *current;
+            }
+
+            ParsedFormat* fresh = new ParsedFormat();
+
+            for(const std::string& name : logger.getVariableNames(format)) {
+                if(!DebugLogger::isInternalVariable(name)) {
+                    fresh->names.push_back(name);
+                }
+            }
+
+            fresh->types.resize(DebugLogger::getArgumentTypes(format, nullptr, 0));
+            DebugLogger::getArgumentTypes(format, &fresh->types[0], (int)fresh->types.size());
+
+            //threads racing on the first call each parse, the first one to finish is kept for the life of the program
+            if(!parsed.compare_exchange_strong(current, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                delete fresh;
+                return *current;
+            }
+
+            return *fresh;
+        }
+
+        /**
+         * Mixes the arguments into @param hash, @param types tells which pointers are arrays, to be hashed with the count after them
+         * */
+        static uint64_t hashArguments(uint64_t hash, const char*) {
+            return hash;
+        }
+
+        template<typename T, typename... Rest>
+        static uint64_t hashArguments(uint64_t hash, const char* types, T value, Rest... rest) {
+            if(*types == 'p') {
+                return hashArray(hash, types, value, rest...);
+            }
+
+            return hashArguments(hashArgument(hash, value), *types? types + 1 : types, rest...);
+        }
+
+        //an array and its count, the elements are hashed so a change to them prints the message again
+        template<typename T, typename Count, typename... Rest>
+        static typename std::enable_if<std::is_integral<Count>::value, uint64_t>::type hashArray(uint64_t hash, const char* types, T* elements, Count count, Rest... rest) {
+            hash = hashElements(DebugLogger::mixHash(hash, (uint64_t)count), elements, (size_t)count);
+            return hashArguments(hash, types[1]? types + 2 : types + 1, rest...);
+        }
+
+        //arguments that don't match the format, hashed one by one
+        template<typename T, typename... Rest>
+        static uint64_t hashArray(uint64_t hash, const char* types, T value, Rest... rest) {
+            return hashArguments(hashArgument(hash, value), types + 1, rest...);
+        }
+
+        template<typename T>
+        static uint64_t hashElements(uint64_t hash, T* elements, size_t count) {
+            return hashBytes(hash, elements, count * sizeof(T));
+        }
+
+        //{hexdump} takes any pointer, the count is in bytes
+        static uint64_t hashElements(uint64_t hash, const void* elements, size_t count) {
+            return hashBytes(hash, elements, count);
+        }
+
+        static uint64_t hashElements(uint64_t hash, void* elements, size_t count) {
+            return hashBytes(hash, elements, count);
+        }
+
+        //string arrays, compared by their text like string arguments
+        static uint64_t hashElements(uint64_t hash, const char** elements, size_t count) {
+            for(size_t i = 0; i < count; ++i) {
+                hash = DebugLogger::mixHash(hash, elements[i]);
+            }
+
+            return hash;
+        }
+
+        static uint64_t hashElements(uint64_t hash, const char* const* elements, size_t count) {
+            return hashElements(hash, const_cast<const char**>(elements), count);
+        }
+
+        static uint64_t hashElements(uint64_t hash, char** elements, size_t count) {
+            return hashElements(hash, const_cast<const char**>(elements), count);
+        }
+
+        /**
+         * Mixes @param length bytes at @param data into @param hash, 8 at a time
+         * */
+        static uint64_t hashBytes(uint64_t hash, const void* data, size_t length) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            size_t index = 0;
+
+            for(; index + 8 <= length; index += 8) {
+                uint64_t word;
+                memcpy(&word, bytes + index, 8);
+                hash = DebugLogger::mixHash(hash, word);
+            }
+
+            uint64_t tail = 0;
+
+            if(index < length) {
+                memcpy(&tail, bytes + index, length - index);
+            }
+
+            return DebugLogger::mixHash(hash, tail);
+        }
+
+        static uint64_t hashArgument(uint64_t hash, const char* text) {
+            return DebugLogger::mixHash(hash, text);
+        }
+
+        static uint64_t hashArgument(uint64_t hash, char* text) {
+            return DebugLogger::mixHash(hash, text);
+        }
+
+        template<typename T>
+        static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type hashArgument(uint64_t hash, T value) {
+            return DebugLogger::mixHash(hash, (uint64_t)value);
+        }
+
+        template<typename T>
+        static typename std::enable_if<std::is_floating_point<T>::value, uint64_t>::type hashArgument(uint64_t hash, T value) {
+            return DebugLogger::mixHash(hash, DebugLogger::doubleBits((double)value));
+        }
+
+        //pointers the format doesn't read as arrays, compared by where they point
+        template<typename T>
+        static uint64_t hashArgument(uint64_t hash, const T* pointer) {
+            return DebugLogger::mixHash(hash, (uint64_t)(uintptr_t)pointer);
+        }
+};
+
+#endif
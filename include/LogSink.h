@@ -0,0 +1,185 @@
+#ifndef INCLUDE_LOG_SINK_H
+#define INCLUDE_LOG_SINK_H
+
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+
+/**
+ * A piece of a message, see LogSink::writeMessage()
+ * */
+struct LogSegment {
+    const char* data;
+    size_t length;
+};
+
+/**
+ * Base class for output streams that queue messages before writing them somewhere
+ * A DebugLogger writing to a LogSink reports the sink's queue depth, high water mark and dropped messages
+ * in its internal variables qd, qhw and drp and in DebugLogger::getStats()
+ * @author Bryce Young
+ * */
+class LogSink : public std::ostream {
+    public:
+        LogSink(std::streambuf* buffer)
+            :std::ostream(buffer)
+        {
+        }
+
+        virtual ~LogSink() {
+        }
+
+        /**
+         * Called by a DebugLogger writing to this sink just before it writes each message,
+         * with the logger's total time in nanoseconds (tl) and the number of the message (dmc)
+         * */
+        virtual void beginMessage(uint64_t nanoseconds, uint64_t messageCount) {
+            (void)nanoseconds;
+            (void)messageCount;
+        }
+
+        /**
+         * Writes one message made of the @param count pieces at @param segments, in order
+         * A DebugLogger hands a message over in pieces when it has long string arguments, which point into the caller's memory
+         * instead of being copied into the line. The default joins the pieces and writes the message in one piece,
+         * sinks that can write the pieces as they are override it
+         * @return false if the message couldn't be written
+         * */
+        virtual bool writeMessage(const LogSegment* segments, size_t count) {
+            std::string message;
+            size_t length = 0;
+
+            for(size_t i = 0; i < count; ++i) {
+                length += segments[i].length;
+            }
+
+            message.reserve(length);
+
+            for(size_t i = 0; i < count; ++i) {
+                message.append(segments[i].data, segments[i].length);
+            }
+
+            write(message.data(), (std::streamsize)message.size());
+            return good();
+        }
+
+        /**
+         * Returns the number of messages (or blocks, depending on the sink) waiting to be written
+         * */
+        uint64_t getQueueDepth() const {
+            return queueDepth.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the largest queue depth seen so far
+         * */
+        uint64_t getQueueHighWater() const {
+            return queueHighWater.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the number of messages the sink had to throw away
+         * */
+        uint64_t getDropped() const {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+    protected:
+        void setQueueDepth(uint64_t depth) {
+            queueDepth.store(depth, std::memory_order_relaxed);
+
+            if(depth > queueHighWater.load(std::memory_order_relaxed)) {
+                queueHighWater.store(depth, std::memory_order_relaxed);
+            }
+        }
+
+        void addDropped(uint64_t count) {
+            dropped.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /**
+         * Keeps the time and number of the message the calling thread is about to write, for a sink that indexes its messages
+         * Call it from beginMessage() and take it back with takePendingMessage() under the lock the message is written with,
+         * so the index entry and the message can't have another thread's message in between
+         * */
+        void setPendingMessage(uint64_t nanoseconds, uint64_t messageCount) {
+            PendingMessage& pending = pendingMessage();
+            pending.sink = this;
+            pending.nanoseconds = nanoseconds;
+            pending.messageCount = messageCount;
+        }
+
+        /**
+         * Returns true with the time and number given to setPendingMessage() if the calling thread's next write to this sink starts a message
+         * */
+        bool takePendingMessage(uint64_t& nanoseconds, uint64_t& messageCount) {
+            PendingMessage& pending = pendingMessage();
+
+            if(pending.sink != this) {
+                return false;
+            }
+
+            pending.sink = nullptr;
+            nanoseconds = pending.nanoseconds;
+            messageCount = pending.messageCount;
+            return true;
+        }
+
+    private:
+        /**
+         * The message a thread announced with beginMessage() and hasn't written yet, plain data so the thread_local needs no guard
+         * */
+        struct PendingMessage {
+            const LogSink* sink;
+            uint64_t nanoseconds;
+            uint64_t messageCount;
+        };
+
+        static PendingMessage& pendingMessage() {
+            static thread_local PendingMessage pending = { nullptr, 0, 0 };
+            return pending;
+        }
+
+        std::atomic<uint64_t> queueDepth{ 0 };
+        std::atomic<uint64_t> queueHighWater{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+};
+
+/**
+ * The streambuf of a sink: hands every write to Sink::write(data, length) in one piece, no characters are buffered in the streambuf itself,
+ * and flushing the stream calls Sink::sync(). Make it a friend when those are private
+ * */
+template<class Sink>
+class SinkBuffer : public std::streambuf {
+    public:
+        SinkBuffer(Sink& sink)
+            :sink(sink)
+        {
+        }
+
+    protected:
+        std::streamsize xsputn(const char* data, std::streamsize count) override {
+            return sink.write(data, (size_t)count)? count : 0;
+        }
+
+        int_type overflow(int_type c) override {
+            if(traits_type::eq_int_type(c, traits_type::eof())) {
+                return traits_type::not_eof(c);
+            }
+
+            char character = traits_type::to_char_type(c);
+            return sink.write(&character, 1)? c : traits_type::eof();
+        }
+
+        int sync() override {
+            sink.sync();
+            return 0;
+        }
+
+    private:
+        Sink& sink;
+};
+
+#endif
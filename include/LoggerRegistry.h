@@ -0,0 +1,298 @@
+#ifndef INCLUDE_LOGGER_REGISTRY_H
+#define INCLUDE_LOGGER_REGISTRY_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "DebugLogger.h"
+
+class LoggerRegistry;
+
+/**
+ * A handle to a named logger in a LoggerRegistry
+ * Handles are a single pointer, so they can be created per subsystem or per request and copied freely
+ * Level checks are lock free, only messages that pass the level are printed under the registry's lock
+ * @author Bryce Young
+ * */
+class NamedLogger {
+    public:
+        /**
+         * The shared state of one name in the registry
+         * */
+        struct Node {
+            std::string name;
+            Node* parent = nullptr;
+            LoggerRegistry* registry = nullptr;
+
+            /**
+             * Level set on this name packed as (stamp << 8) | level, 0 if the level is inherited
+             * The setting with the newest stamp along the path to the root wins
+             * */
+            std::atomic<uint64_t> levelSetting{ 0 };
+
+            //prefix and output set on this name, inherited from the nearest parent when not set
+            bool hasPrefix = false;
+            std::string prefix;
+            std::ostream* targetStream = nullptr;
+        };
+
+        /**
+         * A default handle is disabled: it logs nothing until a handle from LoggerRegistry::getLogger() is assigned to it
+         * */
+        NamedLogger(Node* node = nullptr)
+            :node(node)
+        {
+        }
+
+        /**
+         * Returns the full name of the logger such as net.http, empty for a disabled handle
+         * */
+        const std::string& getName() const {
+            static const std::string none;
+            return node? node->name : none;
+        }
+
+        /**
+         * Returns the effective level: the newest level set on this name or one of its parents, NONE for a disabled handle
+         * */
+        Level getLevel() const {
+            uint64_t newest = 0;
+
+            for(const Node* n = node; n; n = n->parent) {
+                uint64_t setting = n->levelSetting.load(std::memory_order_acquire);
+
+                if(setting > newest) {
+                    newest = setting;
+                }
+            }
+
+            return (Level)(newest & 0xFF);
+        }
+
+        /**
+         * Returns whether a message on @param lev would be printed
+         * */
+        bool isEnabled(Level lev) const {
+            return node && getLevel() <= lev;
+        }
+
+        int trace(const char* format, ...);
+        int warning(const char* format, ...);
+        int error(const char* format, ...);
+        int critical(const char* format, ...);
+
+    private:
+        Node* node;
+};
+
+/**
+ * Registry of hierarchical named loggers that share one backend DebugLogger
+ * Names are separated with dots: net.http is a child of net, which is a child of the root logger ""
+ * Children inherit the level, prefix and target output of their parents unless set on the child
+ * Setting a level on a name applies to the whole subtree with a single atomic store, overriding older levels set below it
+ * @author Bryce Young
+ * */
+class LoggerRegistry {
+    public:
+        LoggerRegistry()
+            :backend("Debug", Level::LEVEL_TRACE)
+        {
+            //filtering is done per name, the backend prints everything it is given
+            backend.setLevel(Level::LEVEL_TRACE);
+
+            root = createNode("", nullptr);
+            root->targetStream = &std::cout;
+            root->levelSetting.store(nextStamp() | (uint64_t)Level::LEVEL_TRACE);
+        }
+
+        ~LoggerRegistry() {
+        }
+
+        /**
+         * The registry used by the whole program
+         * */
+        static LoggerRegistry& global() {
+            static LoggerRegistry registry;
+            return registry;
+        }
+
+        /**
+         * Returns the logger named @param name, creating it and its parents if they don't exist
+         * Look the handle up once and keep it, this locks the registry
+         * */
+        NamedLogger getLogger(const std::string& name) {
+            std::lock_guard<std::mutex> guard(lock);
+            return NamedLogger(findOrCreate(name));
+        }
+
+        /**
+         * Sets the level of @param name and every logger under it
+         * Loggers under it that are set afterwards keep their own level
+         * */
+        void setLevel(const std::string& name, Level newLevel) {
+            std::lock_guard<std::mutex> guard(lock);
+            findOrCreate(name)->levelSetting.store(nextStamp() | (uint64_t)newLevel, std::memory_order_release);
+        }
+
+        /**
+         * Makes @param name inherit its level from its parent again
+         * The root logger always keeps a level
+         * */
+        void clearLevel(const std::string& name) {
+            std::lock_guard<std::mutex> guard(lock);
+            NamedLogger::Node* node = findOrCreate(name);
+
+            if(node != root) {
+                node->levelSetting.store(0, std::memory_order_release);
+            }
+        }
+
+        /**
+         * Sets the prefix of @param name and the loggers under it that don't have their own
+         * */
+        void setPrefix(const std::string& name, const std::string& prefix) {
+            std::lock_guard<std::mutex> guard(lock);
+            NamedLogger::Node* node = findOrCreate(name);
+            node->prefix = prefix;
+            node->hasPrefix = true;
+        }
+
+        /**
+         * Sets the output of @param name and the loggers under it that don't have their own
+         * Passing nullptr makes the logger inherit its parent's output again
+         * */
+        void setTargetOutput(const std::string& name, std::ostream* outputStream) {
+            std::lock_guard<std::mutex> guard(lock);
+            NamedLogger::Node* node = findOrCreate(name);
+
+            if(node != root || outputStream) {
+                node->targetStream = outputStream;
+            }
+        }
+
+        /**
+         * Returns the logger every message is printed through
+         * Lock the registry with getLock() before using it while other threads are logging
+         * */
+        DebugLogger& getBackend() {
+            return backend;
+        }
+
+        std::mutex& getLock() {
+            return lock;
+        }
+
+    private:
+        friend class NamedLogger;
+
+        /**
+         * Prints a message that passed the level check of @param node
+         * */
+        int log(NamedLogger::Node* node, Level lev, const char* format, va_list& args) {
+            std::lock_guard<std::mutex> guard(lock);
+            const NamedLogger::Node* prefixNode = node;
+            const NamedLogger::Node* outputNode = node;
+
+            while(!prefixNode->hasPrefix && prefixNode->parent) {
+                prefixNode = prefixNode->parent;
+            }
+
+            while(!outputNode->targetStream) {
+                outputNode = outputNode->parent;
+            }
+
+            const char* prefix = prefixNode->hasPrefix? prefixNode->prefix.c_str() : nullptr;
+            return backend.logNamed(*outputNode->targetStream, lev, node->name.c_str(), prefix, format, args);
+        }
+
+        NamedLogger::Node* findOrCreate(const std::string& name) {
+            std::map<std::string, std::unique_ptr<NamedLogger::Node>>::iterator n = nodes.find(name);
+
+            if(n != nodes.end()) {
+                return n->second.get();
+            }
+
+            size_t dot = name.rfind('.');
+            NamedLogger::Node* parent = (dot == std::string::npos)? root : findOrCreate(name.substr(0, dot));
+            return createNode(name, parent);
+        }
+
+        NamedLogger::Node* createNode(const std::string& name, NamedLogger::Node* parent) {
+            NamedLogger::Node* node = new NamedLogger::Node();
+            node->name = name;
+            node->parent = parent;
+            node->registry = this;
+            nodes[name].reset(node);
+            return node;
+        }
+
+        /**
+         * Returns a stamp newer than every level set so far, shifted above the level bits
+         * */
+        uint64_t nextStamp() {
+            return ++stamp << 8;
+        }
+
+        //guards configuration changes and the backend
+        std::mutex lock;
+
+        //every name ever requested, nodes are never removed so handles stay valid
+        std::map<std::string, std::unique_ptr<NamedLogger::Node>> nodes;
+        NamedLogger::Node* root;
+        uint64_t stamp = 0;
+
+        DebugLogger backend;
+};
+
+inline int NamedLogger::trace(const char* format, ...) {
+    if(!isEnabled(Level::LEVEL_TRACE)) {
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int ret = node->registry->log(node, Level::LEVEL_TRACE, format, args);
+    va_end(args);
+    return ret;
+}
+
+inline int NamedLogger::warning(const char* format, ...) {
+    if(!isEnabled(Level::LEVEL_WARNING)) {
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int ret = node->registry->log(node, Level::LEVEL_WARNING, format, args);
+    va_end(args);
+    return ret;
+}
+
+inline int NamedLogger::error(const char* format, ...) {
+    if(!isEnabled(Level::LEVEL_ERROR)) {
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int ret = node->registry->log(node, Level::LEVEL_ERROR, format, args);
+    va_end(args);
+    return ret;
+}
+
+inline int NamedLogger::critical(const char* format, ...) {
+    if(!isEnabled(Level::CRITICAL_ERROR)) {
+        return 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int ret = node->registry->log(node, Level::CRITICAL_ERROR, format, args);
+    va_end(args);
+    return ret;
+}
+
+#endif
@@ -0,0 +1,554 @@
+#ifndef INCLUDE_METRICS_H
+#define INCLUDE_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "Profiler.h"
+#include "ThreadShards.h"
+#include "Timer.h"
+
+/**
+ * Named counters, gauges and histograms that are summed up in the program and printed as one summary line every interval,
+ * instead of one line per event
+ * ```
+ * LogMetrics metrics(logger);
+ * LogMetrics::Counter requests = metrics.counter("requests");
+ * LogMetrics::Histogram latency = metrics.histogram("latency");
+ *
+ * requests.add();
+ * latency.record(nanoseconds);
+ * ```
+ * Each thread adds into its own shard (see ThreadShards), so an event costs a few nanoseconds and no atomic read-modify-write.
+ * The summary sums the shards. It is printed every interval by a thread of its own, started with startSummaryThread(),
+ * or by calling pollSummary() or printSummary() from the thread that owns the logger
+ * The logger resolves [metric.name] variables through the metrics, see getMetric()
+ * @author Bryce Young
+ * */
+class LogMetrics : public MetricSource {
+    public:
+        static constexpr int MAX_METRICS = 64;
+
+    private:
+        /**
+         * One thread's part of a histogram, buckets as in LatencyHistogram
+         * */
+        struct HistogramShard {
+            std::atomic<uint64_t> buckets[LatencyHistogram::BUCKET_COUNT];
+            std::atomic<uint64_t> sum;
+
+            HistogramShard() {
+                for(int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+                    buckets[i].store(0, std::memory_order_relaxed);
+                }
+
+                sum.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        /**
+         * Everything one thread records. Slot MAX_METRICS takes the events of handles that couldn't be registered
+         * */
+        struct Shard {
+            alignas(64) std::atomic<uint64_t> counters[MAX_METRICS + 1];
+            std::atomic<HistogramShard*> histograms[MAX_METRICS + 1];
+            alignas(64) uint32_t events = 0;
+
+            Shard() {
+                for(int i = 0; i <= MAX_METRICS; ++i) {
+                    counters[i].store(0, std::memory_order_relaxed);
+                    histograms[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            ~Shard() {
+                for(int i = 0; i <= MAX_METRICS; ++i) {
+                    delete histograms[i].load(std::memory_order_relaxed);
+                }
+            }
+        };
+
+    public:
+        /**
+         * Counts events, printed as the total and the rate over the last interval
+         * */
+        class Counter {
+            public:
+                void add(uint64_t value = 1) {
+                    Shard& shard = metrics->shards.get();
+                    ThreadShards<Shard>::add(shard.counters[slot], value);
+                    metrics->countEvent(shard);
+                }
+
+            private:
+                friend class LogMetrics;
+
+                Counter(LogMetrics* metrics, int slot)
+                    :metrics(metrics),
+                    slot(slot)
+                {
+                }
+
+                LogMetrics* metrics;
+                int slot;
+        };
+
+        /**
+         * Holds the last value set, from any thread
+         * */
+        class Gauge {
+            public:
+                void set(double value) {
+                    metrics->gauges[slot].store(value, std::memory_order_relaxed);
+                }
+
+            private:
+                friend class LogMetrics;
+
+                Gauge(LogMetrics* metrics, int slot)
+                    :metrics(metrics),
+                    slot(slot)
+                {
+                }
+
+                LogMetrics* metrics;
+                int slot;
+        };
+
+        /**
+         * Distribution of values over the last interval, printed as count, mean, p50, p99 and max
+         * Buckets are the same as LatencyHistogram's, so percentiles are within 12.5%
+         * */
+        class Histogram {
+            public:
+                void record(uint64_t value) {
+                    Shard& shard = metrics->shards.get();
+                    HistogramShard* histogram = shard.histograms[slot].load(std::memory_order_relaxed);
+
+                    if(!histogram) {
+                        //allocated on the thread's first value so threads that never record here don't pay for the buckets
+                        histogram = new HistogramShard();
+                        shard.histograms[slot].store(histogram, std::memory_order_release);
+                    }
+
+                    ThreadShards<Shard>::add(histogram->buckets[LatencyHistogram::bucketIndex(value)], 1);
+                    ThreadShards<Shard>::add(histogram->sum, value);
+                    metrics->countEvent(shard);
+                }
+
+            private:
+                friend class LogMetrics;
+
+                Histogram(LogMetrics* metrics, int slot)
+                    :metrics(metrics),
+                    slot(slot)
+                {
+                }
+
+                LogMetrics* metrics;
+                int slot;
+        };
+
+        /**
+         * Prints the summary through @param logger and resolves its [metric.name] variables
+         * The logger must outlive the metrics
+         * */
+        LogMetrics(DebugLogger& logger)
+            :logger(logger),
+            summaryDeadline(10000)
+        {
+            for(int i = 0; i <= MAX_METRICS; ++i) {
+                gauges[i].store(0, std::memory_order_relaxed);
+            }
+
+            logger.setMetrics(this);
+            lastSummary = PeriodicDeadline::now();
+        }
+
+        ~LogMetrics() {
+            stopSummaryThread();
+
+            if(logger.getMetrics() == this) {
+                logger.setMetrics(nullptr);
+            }
+        }
+
+        LogMetrics(const LogMetrics&) = delete;
+        LogMetrics& operator=(const LogMetrics&) = delete;
+
+        /**
+         * Returns the counter named @param name, registering it if needed. Look it up once and keep the handle
+         * Past MAX_METRICS names, or for a name already used by another kind of metric, the handle records nowhere
+         * */
+        Counter counter(const std::string& name) {
+            return Counter(this, registerMetric(name, Metric::COUNTER));
+        }
+
+        /**
+         * Returns the gauge named @param name, registering it if needed, see counter()
+         * */
+        Gauge gauge(const std::string& name) {
+            return Gauge(this, registerMetric(name, Metric::GAUGE));
+        }
+
+        /**
+         * Returns the histogram named @param name, registering it if needed, see counter()
+         * */
+        Histogram histogram(const std::string& name) {
+            return Histogram(this, registerMetric(name, Metric::HISTOGRAM));
+        }
+
+        /**
+         * Sets how often the summary is printed, 0 to only print it with printSummary()
+         * */
+        void setSummaryInterval(uint64_t milliseconds) {
+            summaryDeadline.setInterval(milliseconds);
+
+            {
+                std::lock_guard<std::mutex> guard(threadLock);
+            }
+
+            summarySignal.notify_all();
+        }
+
+        /**
+         * Starts a thread that prints the summary every interval through a copy of the logger, made now,
+         * so the logger itself is never touched from that thread (see VariableWatch). The output must be one
+         * that threads can share, like the sinks in this library. Stopped by stopSummaryThread() or the destructor
+         * */
+        void startSummaryThread() {
+            if(summaryThread.joinable()) {
+                return;
+            }
+
+            summaryLogger.reset(new DebugLogger(logger));
+            summaryRunning = true;
+            summaryThread = std::thread(&LogMetrics::runSummary, this);
+        }
+
+        /**
+         * Stops the summary thread, waiting for a summary being printed to finish
+         * */
+        void stopSummaryThread() {
+            if(summaryThread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> guard(threadLock);
+                    summaryRunning = false;
+                }
+
+                summarySignal.notify_all();
+                summaryThread.join();
+            }
+        }
+
+        /**
+         * Sets whether the threads that record events print the summary when they find the interval has passed (default off)
+         * Loggers are used from one thread at a time, so only turn it on when the events are recorded by the thread that owns the logger
+         * */
+        void setSummaryFromEvents(bool fromEvents) {
+            summaryFromEvents.store(fromEvents, std::memory_order_relaxed);
+        }
+
+        /**
+         * Prints one trace line with every metric that has been registered, in the order they were registered
+         * ```
+         * metrics: requests=12000 (+1200, 120.0/s) queue=17 latency: count=1200 mean=4820.1 p50=4607 p99=11263 max=12287
+         * ```
+         * Counters show their total, what was added since the last summary and the rate; histograms cover the values since the last summary
+         * Also updates the interval values of the [metric.name] variables
+         * */
+        void printSummary() {
+            printSummary(logger);
+        }
+
+        /**
+         * Prints the summary if the interval has passed, for the thread that owns the logger
+         * */
+        void pollSummary() {
+            pollSummary(logger);
+        }
+
+        /**
+         * Resolves the [metric.name] variables:
+         * counters: metric.name (total) and metric.name.rate (per second over the last interval)
+         * gauges: metric.name
+         * histograms: metric.name.count, .mean, .p50, .p99 and .max, over the last interval
+         * Totals and gauges are current, the interval values change when a summary is printed
+         * */
+        DebugVarType getMetric(const char* name, size_t length, uint64_t& integer, double& number) override {
+            std::lock_guard<std::mutex> guard(lock);
+            std::map<std::string, int>::iterator found = byName.find(std::string(name, length));
+            std::string field;
+
+            //names can have dots too, so the field is only split off when the whole name isn't a metric
+            if(found == byName.end()) {
+                const char* dot = name + length;
+
+                while(dot > name && *(dot - 1) != '.') {
+                    dot--;
+                }
+
+                if(dot == name) {
+                    return DebugVarType::DEBUGVAR_TYPE_COUNT;
+                }
+
+                found = byName.find(std::string(name, dot - 1 - name));
+                field.assign(dot, name + length);
+
+                if(found == byName.end()) {
+                    return DebugVarType::DEBUGVAR_TYPE_COUNT;
+                }
+            }
+
+            const Metric& metric = registered[found->second];
+
+            switch(metric.kind) {
+                case Metric::COUNTER:
+                    if(field.empty()) {
+                        integer = sumCounter(metric.slot);
+                        return DebugVarType::INTEGER64;
+                    }
+
+                    if(field == "rate") {
+                        number = metric.rate;
+                        return DebugVarType::FLOAT64;
+                    }
+
+                    break;
+                case Metric::GAUGE:
+                    if(field.empty()) {
+                        number = gauges[metric.slot].load(std::memory_order_relaxed);
+                        return DebugVarType::FLOAT64;
+                    }
+
+                    break;
+                case Metric::HISTOGRAM:
+                    if(field == "mean") {
+                        number = metric.interval.mean;
+                        return DebugVarType::FLOAT64;
+                    }
+
+                    if(field == "count" || field == "p50" || field == "p99" || field == "max") {
+                        integer = field == "count"? metric.interval.count : field == "p50"? metric.interval.p50 : field == "p99"? metric.interval.p99 : metric.interval.max;
+                        return DebugVarType::INTEGER64;
+                    }
+
+                    break;
+            }
+
+            return DebugVarType::DEBUGVAR_TYPE_COUNT;
+        }
+
+    private:
+        struct Metric {
+            enum Kind { COUNTER, GAUGE, HISTOGRAM };
+
+            std::string name;
+            Kind kind;
+            int slot;
+
+            //what the last summary saw, to print what changed since
+            uint64_t lastTotal = 0;
+            double rate = 0;
+            std::vector<uint64_t> lastBuckets;
+            uint64_t lastSum = 0;
+            LatencyHistogram::Summary interval;
+        };
+
+        /**
+         * Prints the summary through @param target, the logger or the summary thread's copy of it
+         * */
+        void printSummary(DebugLogger& target) {
+            std::string line;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                uint64_t now = PeriodicDeadline::now();
+                double seconds = (now - lastSummary) / 1e9;
+                lastSummary = now;
+
+                std::vector<uint64_t> buckets(LatencyHistogram::BUCKET_COUNT);
+                char text[160];
+
+                for(Metric& metric : registered) {
+                    switch(metric.kind) {
+                        case Metric::COUNTER:
+                            {
+                                uint64_t total = sumCounter(metric.slot);
+                                uint64_t added = total - metric.lastTotal;
+                                metric.lastTotal = total;
+                                metric.rate = seconds > 0? added / seconds : 0;
+                                snprintf(text, sizeof(text), " %s=%llu (+%llu, %.1f/s)", metric.name.c_str(), (unsigned long long)total, (unsigned long long)added, metric.rate);
+                            }
+                            break;
+                        case Metric::GAUGE:
+                            snprintf(text, sizeof(text), " %s=%g", metric.name.c_str(), gauges[metric.slot].load(std::memory_order_relaxed));
+                            break;
+                        case Metric::HISTOGRAM:
+                            {
+                                uint64_t sum = sumHistogram(metric.slot, buckets.data());
+                                summarize(metric, buckets.data(), sum);
+                                snprintf(text, sizeof(text), " %s: count=%llu mean=%.1f p50=%llu p99=%llu max=%llu", metric.name.c_str(),
+                                    (unsigned long long)metric.interval.count, metric.interval.mean, (unsigned long long)metric.interval.p50,
+                                    (unsigned long long)metric.interval.p99, (unsigned long long)metric.interval.max);
+                            }
+                            break;
+                    }
+
+                    line += text;
+                }
+            }
+
+            if(!line.empty()) {
+                target.trace("metrics:{str}", line.c_str());
+            }
+        }
+
+        /**
+         * Prints the summary through @param target if the interval has passed
+         * */
+        void pollSummary(DebugLogger& target) {
+            if(summaryDeadline.poll()) {
+                printSummary(target);
+            }
+        }
+
+        /**
+         * The summary thread: sleeps until the deadline and prints through its copy of the logger
+         * */
+        void runSummary() {
+            std::unique_lock<std::mutex> guard(threadLock);
+
+            while(summaryRunning) {
+                uint64_t next = summaryDeadline.getNext();
+                uint64_t now = PeriodicDeadline::now();
+
+                if(next == UINT64_MAX) {
+                    summarySignal.wait(guard);
+                    continue;
+                }
+
+                if(now < next) {
+                    //the clock only moves every few milliseconds, so don't wake up more often than that
+                    summarySignal.wait_for(guard, std::chrono::nanoseconds(std::max(next - now, (uint64_t)1000000)));
+                    continue;
+                }
+
+                guard.unlock();
+                pollSummary(*summaryLogger);
+                guard.lock();
+            }
+        }
+
+        void countEvent(Shard& shard) {
+            if((++shard.events & 1023) == 0 && summaryFromEvents.load(std::memory_order_relaxed)) {
+                pollSummary(logger);
+            }
+        }
+
+        int registerMetric(const std::string& name, Metric::Kind kind) {
+            std::lock_guard<std::mutex> guard(lock);
+            std::map<std::string, int>::iterator found = byName.find(name);
+
+            if(found != byName.end()) {
+                const Metric& metric = registered[found->second];
+                return metric.kind == kind? metric.slot : MAX_METRICS;
+            }
+
+            if((int)registered.size() >= MAX_METRICS) {
+                return MAX_METRICS;
+            }
+
+            Metric metric;
+            metric.name = name;
+            metric.kind = kind;
+            metric.slot = (int)registered.size();
+
+            if(kind == Metric::HISTOGRAM) {
+                metric.lastBuckets.resize(LatencyHistogram::BUCKET_COUNT);
+            }
+
+            byName[name] = metric.slot;
+            registered.push_back(metric);
+            return metric.slot;
+        }
+
+        uint64_t sumCounter(int slot) {
+            uint64_t total = 0;
+            shards.forEach([&](const Shard& shard) { total += shard.counters[slot].load(std::memory_order_relaxed); });
+            return total;
+        }
+
+        /**
+         * Adds up the buckets of every thread into @param buckets, returns the sum of the values
+         * */
+        uint64_t sumHistogram(int slot, uint64_t* buckets) {
+            std::fill(buckets, buckets + LatencyHistogram::BUCKET_COUNT, 0);
+            uint64_t sum = 0;
+
+            shards.forEach([&](const Shard& shard) {
+                const HistogramShard* histogram = shard.histograms[slot].load(std::memory_order_acquire);
+
+                if(!histogram) {
+                    return;
+                }
+
+                for(int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+                    buckets[i] += histogram->buckets[i].load(std::memory_order_relaxed);
+                }
+
+                sum += histogram->sum.load(std::memory_order_relaxed);
+            });
+
+            return sum;
+        }
+
+        /**
+         * Sets the interval values of @param metric from the totals since the last summary
+         * The threads keep adding while the shards are read, so a bucket read late may hold a few values more than the sum
+         * */
+        void summarize(Metric& metric, const uint64_t* buckets, uint64_t sum) {
+            uint64_t counts[LatencyHistogram::BUCKET_COUNT];
+
+            for(int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+                counts[i] = buckets[i] - metric.lastBuckets[i];
+                metric.lastBuckets[i] = buckets[i];
+            }
+
+            //the shards only keep buckets, so the max is the upper bound of the highest one
+            metric.interval = LatencyHistogram::summarize(counts, sum - metric.lastSum);
+            metric.lastSum = sum;
+        }
+
+        DebugLogger& logger;
+        ThreadShards<Shard> shards;
+
+        std::atomic<double> gauges[MAX_METRICS + 1];
+
+        //guards the registry and the summary
+        std::mutex lock;
+        std::map<std::string, int> byName;
+        std::vector<Metric> registered;
+        uint64_t lastSummary = 0;
+
+        PeriodicDeadline summaryDeadline;
+        std::atomic<bool> summaryFromEvents{ false };
+
+        //the summary thread and the copy of the logger it prints through
+        std::thread summaryThread;
+        std::unique_ptr<DebugLogger> summaryLogger;
+        bool summaryRunning = false;
+        std::mutex threadLock;
+        std::condition_variable summarySignal;
+};
+
+#endif
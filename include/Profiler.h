@@ -0,0 +1,433 @@
+#ifndef INCLUDE_PROFILER_H
+#define INCLUDE_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "ThreadShards.h"
+#include "Timer.h"
+
+#define DEBUG_SCOPE_CONCAT_INNER(a, b) a##b
+#define DEBUG_SCOPE_CONCAT(a, b) DEBUG_SCOPE_CONCAT_INNER(a, b)
+
+/**
+ * Measures the time until the end of the enclosing scope and adds it to the histogram named @param name
+ * The histograms are printed through @param logger as one summary line per name every summary interval
+ * ```
+ * {
+ *     DEBUG_SCOPE(logger, "db.query");
+ *     runQuery();
+ * }
+ * ```
+ * */
+#define DEBUG_SCOPE(logger, name) \
+    static LatencyHistogram& DEBUG_SCOPE_CONCAT(debugScopeHistogram, __LINE__) = Profiler::global().getHistogram(name); \
+    static thread_local LatencyHistogram::Shard* DEBUG_SCOPE_CONCAT(debugScopeShard, __LINE__) = nullptr; \
+    ScopedSpan DEBUG_SCOPE_CONCAT(debugScopeSpan, __LINE__)(DEBUG_SCOPE_CONCAT(debugScopeHistogram, __LINE__), \
+        DEBUG_SCOPE_CONCAT(debugScopeHistogram, __LINE__).getShard(DEBUG_SCOPE_CONCAT(debugScopeShard, __LINE__)), &(logger))
+
+/**
+ * Histogram of durations in nanoseconds
+ * Buckets are log-linear: exact below 16ns, then 8 buckets per power of two, so percentiles are within 12.5%
+ * Each thread records into its own shard (see ThreadShards), so a record takes no locked instruction
+ * and threads don't share cache lines. Summaries add the shards up
+ * @author Bryce Young
+ * */
+class LatencyHistogram {
+    public:
+        static constexpr int SUB_BUCKETS = 8;
+        static constexpr int BUCKET_COUNT = 16 + (64 - 4) * SUB_BUCKETS;
+
+        /**
+         * A copy of the histogram's values at one point in time
+         * */
+        struct Summary {
+            uint64_t count = 0;
+            uint64_t min = 0;
+            uint64_t max = 0;
+            double mean = 0;
+            uint64_t p50 = 0;
+            uint64_t p99 = 0;
+        };
+
+        /**
+         * One thread's part of the histogram. The buckets and the sum only grow, reset() moves the histogram's baseline instead
+         * min and max are those of the reset epoch the shard last recorded in
+         * */
+        struct Shard {
+            alignas(64) std::atomic<uint64_t> buckets[BUCKET_COUNT];
+            std::atomic<uint64_t> sum;
+            std::atomic<uint64_t> min;
+            std::atomic<uint64_t> max;
+            std::atomic<uint64_t> epoch;
+
+            Shard() {
+                for(int i = 0; i < BUCKET_COUNT; ++i) {
+                    buckets[i].store(0, std::memory_order_relaxed);
+                }
+
+                sum.store(0, std::memory_order_relaxed);
+                min.store(UINT64_MAX, std::memory_order_relaxed);
+                max.store(0, std::memory_order_relaxed);
+                epoch.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        LatencyHistogram(const std::string& name = "")
+            :name(name)
+        {
+            std::fill(baseline, baseline + BUCKET_COUNT, 0);
+        }
+
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        /**
+         * Adds a duration, safe to call from any thread
+         * */
+        void record(uint64_t nanoseconds) {
+            record(getShard(), nanoseconds);
+        }
+
+        /**
+         * Adds a duration to @param shard, which must be the calling thread's shard of this histogram
+         * */
+        void record(Shard& shard, uint64_t nanoseconds) {
+            //the count is the sum of the buckets, so it isn't kept separately
+            ThreadShards<Shard>::add(shard.buckets[bucketIndex(nanoseconds)], 1);
+            ThreadShards<Shard>::add(shard.sum, nanoseconds);
+
+            uint64_t current = epoch.load(std::memory_order_relaxed);
+
+            if(shard.epoch.load(std::memory_order_relaxed) != current) {
+                //the first value since a reset, the summary only reads min and max once the epoch is stored
+                shard.min.store(nanoseconds, std::memory_order_relaxed);
+                shard.max.store(nanoseconds, std::memory_order_relaxed);
+                shard.epoch.store(current, std::memory_order_release);
+                return;
+            }
+
+            if(nanoseconds < shard.min.load(std::memory_order_relaxed)) {
+                shard.min.store(nanoseconds, std::memory_order_relaxed);
+            }
+
+            if(nanoseconds > shard.max.load(std::memory_order_relaxed)) {
+                shard.max.store(nanoseconds, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Returns the calling thread's shard, taken from the pool on the thread's first value
+         * A thread's shard is handed back with its values when the thread exits, and goes to the next new thread
+         * */
+        Shard& getShard() {
+            return shards.get();
+        }
+
+        /**
+         * Returns the calling thread's shard through @param cache, a thread_local of the caller that starts out null
+         * DEBUG_SCOPE keeps one per call site, so nested scopes don't take turns in the cache of getShard()
+         * */
+        Shard& getShard(Shard*& cache) {
+            if(!cache) {
+                cache = &getShard();
+            }
+
+            return *cache;
+        }
+
+        /**
+         * Returns the count, min, max, mean and percentiles recorded since the last reset
+         * Percentiles are the upper bound of the bucket they fall in
+         * */
+        Summary getSummary() const {
+            std::lock_guard<std::mutex> guard(summaryLock);
+            uint64_t counts[BUCKET_COUNT];
+            uint64_t sum = 0;
+            uint64_t min = UINT64_MAX;
+            uint64_t max = 0;
+            sumShards(counts, sum, &min, &max);
+
+            for(int i = 0; i < BUCKET_COUNT; ++i) {
+                counts[i] -= baseline[i];
+            }
+
+            //a value recorded while reset() ran can be counted without its min and max, the buckets bound them then
+            return summarize(counts, sum - baselineSum, min, max);
+        }
+
+        /**
+         * Returns the summary of the values counted in @param counts, BUCKET_COUNT buckets, that add up to @param sum
+         * @param min and @param max are those of the values when known, otherwise they are bounded by the lowest and highest bucket
+         * Percentiles are the upper bound of the bucket they fall in, capped at the max
+         * */
+        static Summary summarize(const uint64_t* counts, uint64_t sum, uint64_t min = UINT64_MAX, uint64_t max = 0) {
+            Summary summary;
+            int lowest = -1;
+            int highest = 0;
+
+            for(int i = 0; i < BUCKET_COUNT; ++i) {
+                summary.count += counts[i];
+
+                if(counts[i]) {
+                    lowest = lowest < 0? i : lowest;
+                    highest = i;
+                }
+            }
+
+            if(summary.count == 0) {
+                return summary;
+            }
+
+            summary.min = min != UINT64_MAX? min : (lowest < 16? (uint64_t)lowest : bucketUpperBound(lowest - 1) + 1);
+            summary.max = max? max : bucketUpperBound(highest);
+            summary.mean = (double)sum / (double)summary.count;
+
+            uint64_t p50Rank = (summary.count + 1) / 2;
+            uint64_t p99Rank = summary.count - summary.count / 100;
+            uint64_t seen = 0;
+            bool foundP50 = false;
+
+            for(int i = 0; i <= highest; ++i) {
+                seen += counts[i];
+
+                if(!foundP50 && seen >= p50Rank) {
+                    summary.p50 = std::min(bucketUpperBound(i), summary.max);
+                    foundP50 = true;
+                }
+
+                if(seen >= p99Rank) {
+                    summary.p99 = std::min(bucketUpperBound(i), summary.max);
+                    break;
+                }
+            }
+
+            return summary;
+        }
+
+        /**
+         * Starts over, the next summary only covers values recorded after this
+         * Values recorded by other threads during the reset may be counted on either side of it
+         * */
+        void reset() {
+            std::lock_guard<std::mutex> guard(summaryLock);
+            sumShards(baseline, baselineSum, nullptr, nullptr);
+            epoch.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const std::string& getName() const {
+            return name;
+        }
+
+        static int bucketIndex(uint64_t value) {
+            if(value < 16) {
+                return (int)value;
+            }
+
+            int exponent = 63 - countLeadingZeros(value);
+            int subBucket = (int)(value >> (exponent - 3)) & (SUB_BUCKETS - 1);
+            return 16 + (exponent - 4) * SUB_BUCKETS + subBucket;
+        }
+
+        static uint64_t bucketUpperBound(int index) {
+            if(index < 16) {
+                return (uint64_t)index;
+            }
+
+            int exponent = (index - 16) / SUB_BUCKETS + 4;
+            uint64_t subBucket = (uint64_t)((index - 16) % SUB_BUCKETS);
+            return (1ull << exponent) + ((subBucket + 1) << (exponent - 3)) - 1;
+        }
+
+    private:
+        /**
+         * Adds up the buckets and sums of every shard into @param counts and @param sum,
+         * and when @param min and @param max are given, the min and max of the shards that recorded since the last reset
+         * */
+        void sumShards(uint64_t* counts, uint64_t& sum, uint64_t* min, uint64_t* max) const {
+            std::fill(counts, counts + BUCKET_COUNT, 0);
+            sum = 0;
+            uint64_t current = epoch.load(std::memory_order_relaxed);
+
+            shards.forEach([&](const Shard& shard) {
+                for(int i = 0; i < BUCKET_COUNT; ++i) {
+                    counts[i] += shard.buckets[i].load(std::memory_order_relaxed);
+                }
+
+                sum += shard.sum.load(std::memory_order_relaxed);
+
+                if(min && shard.epoch.load(std::memory_order_acquire) == current) {
+                    *min = std::min(*min, shard.min.load(std::memory_order_relaxed));
+                    *max = std::max(*max, shard.max.load(std::memory_order_relaxed));
+                }
+            });
+        }
+
+        static int countLeadingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_clzll(value);
+#else
+            int zeros = 0;
+
+            while(!(value & (1ull << 63))) {
+                value <<= 1;
+                zeros++;
+            }
+
+            return zeros;
+#endif
+        }
+
+        std::string name;
+        ThreadShards<Shard> shards;
+        //counts the resets, from 1 so the min and max of a new shard aren't current
+        std::atomic<uint64_t> epoch{ 1 };
+        //the shards' totals at the last reset
+        mutable std::mutex summaryLock;
+        uint64_t baseline[BUCKET_COUNT];
+        uint64_t baselineSum = 0;
+};
+
+/**
+ * Registry of named latency histograms and the periodic summary that prints them
+ * @author Bryce Young
+ * */
+class Profiler {
+    public:
+        Profiler()
+            :summaryDeadline(10000)
+        {
+        }
+
+        /**
+         * The profiler DEBUG_SCOPE records into
+         * */
+        static Profiler& global() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        /**
+         * Returns the histogram named @param name, creating it if needed
+         * The reference stays valid for the life of the profiler, look it up once and keep it
+         * */
+        LatencyHistogram& getHistogram(const std::string& name) {
+            std::lock_guard<std::mutex> guard(lock);
+            std::unique_ptr<LatencyHistogram>& histogram = histograms[name];
+
+            if(!histogram) {
+                histogram.reset(new LatencyHistogram(name));
+                TscClock::getCalibration();
+            }
+
+            return *histogram;
+        }
+
+        /**
+         * Sets how often the summary is printed, 0 to only print it with printSummary()
+         * */
+        void setSummaryInterval(uint64_t milliseconds) {
+            summaryDeadline.setInterval(milliseconds);
+        }
+
+        /**
+         * Sets whether printing the summary clears the histograms, so each summary covers one interval (default)
+         * */
+        void setResetOnSummary(bool reset) {
+            resetOnSummary = reset;
+        }
+
+        /**
+         * Prints one trace line per histogram with its count, min, mean, p50, p99 and max in microseconds
+         * */
+        void printSummary(DebugLogger& logger) {
+            std::lock_guard<std::mutex> guard(lock);
+
+            for(std::map<std::string, std::unique_ptr<LatencyHistogram>>::iterator h = histograms.begin(); h != histograms.end(); ++h) {
+                LatencyHistogram::Summary summary = h->second->getSummary();
+
+                if(summary.count == 0) {
+                    continue;
+                }
+
+                logger.trace("{str}: count={ulong} min={.3f}us mean={.3f}us p50={.3f}us p99={.3f}us max={.3f}us",
+                    h->first.c_str(), (unsigned long long)summary.count, summary.min / 1000.0, summary.mean / 1000.0,
+                    summary.p50 / 1000.0, summary.p99 / 1000.0, summary.max / 1000.0);
+
+                if(resetOnSummary) {
+                    h->second->reset();
+                }
+            }
+        }
+
+        /**
+         * Prints the summary through @param logger if the interval has passed
+         * Called by every 1024th span of each thread, so the clock is only read once in a while
+         * */
+        void pollSummary(DebugLogger& logger) {
+            if(summaryDeadline.poll()) {
+                printSummary(logger);
+            }
+        }
+
+        /**
+         * Counts a finished span on this thread, returns true when it is time to poll the summary
+         * */
+        static bool countSpan() {
+            static thread_local uint32_t spans = 0;
+            return (++spans & 1023) == 0;
+        }
+
+    private:
+        std::mutex lock;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+        PeriodicDeadline summaryDeadline;
+        bool resetOnSummary = true;
+};
+
+/**
+ * Measures its own lifetime with a TscTimer and records it into a histogram, see DEBUG_SCOPE
+ * */
+class ScopedSpan {
+    public:
+        ScopedSpan(LatencyHistogram& histogram, DebugLogger* logger = nullptr)
+            :ScopedSpan(histogram, histogram.getShard(), logger)
+        {
+        }
+
+        /**
+         * Records into @param shard, the calling thread's shard of @param histogram
+         * */
+        ScopedSpan(LatencyHistogram& histogram, LatencyHistogram::Shard& shard, DebugLogger* logger = nullptr)
+            :histogram(histogram),
+            shard(shard),
+            logger(logger)
+        {
+        }
+
+        ~ScopedSpan() {
+            histogram.record(shard, timer.nanoseconds());
+
+            if(logger && Profiler::countSpan()) {
+                Profiler::global().pollSummary(*logger);
+            }
+        }
+
+        ScopedSpan(const ScopedSpan&) = delete;
+        ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    private:
+        LatencyHistogram& histogram;
+        LatencyHistogram::Shard& shard;
+        DebugLogger* logger;
+        TscTimer timer;
+};
+
+#endif
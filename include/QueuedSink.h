@@ -0,0 +1,200 @@
+#ifndef INCLUDE_QUEUED_SINK_H
+#define INCLUDE_QUEUED_SINK_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "LogSink.h"
+#include "Timer.h"
+
+/**
+ * Base class for sinks that copy writes into an open buffer and seal it into a queue for a background thread,
+ * so the thread that logs never waits for the file or the socket
+ * The open buffer is sealed when the sink calls seal(), and by the background thread once it has been open for the seal interval
+ * Sink is the derived class. Its process(Item&) is called by the background thread without the lock, once per sealed buffer
+ * Item is the buffer, with empty(), clear() and reserve(size_t). Handled buffers are kept as spares for the next open one
+ * The queue depth variables count sealed buffers
+ * @author Bryce Young
+ * */
+template<class Sink, class Item>
+class QueuedSink : public LogSink {
+    protected:
+        /**
+         * @param capacity is reserved in every open buffer, @param maxSpare handled buffers are kept for reuse
+         * */
+        QueuedSink(std::streambuf* buffer, uint64_t sealIntervalMilliseconds, size_t capacity, size_t maxSpare)
+            :LogSink(buffer),
+            capacity(capacity),
+            maxSpare(maxSpare),
+            sealInterval(sealIntervalMilliseconds * 1000000)
+        {
+        }
+
+        /**
+         * Starts the background thread, once the derived sink is ready for process()
+         * */
+        void startWorker() {
+            current.reserve(capacity);
+            worker = std::thread(&QueuedSink::run, this);
+        }
+
+        /**
+         * Seals the open buffer and waits for the background thread to handle everything queued and exit
+         * Call it from the derived destructor, process() must not run after the derived sink is gone
+         * */
+        void stopWorker() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                seal();
+                stopping = true;
+            }
+
+            ready.notify_all();
+            worker.join();
+        }
+
+        /**
+         * Seals the open buffer and waits until every sealed buffer was handled
+         * */
+        void drainQueue() {
+            std::unique_lock<std::mutex> guard(lock);
+            seal();
+
+            while(!queue.empty() || busy) {
+                space.wait(guard);
+            }
+        }
+
+        /**
+         * Sets how long the open buffer may wait before the background thread seals it, 0 to leave it open until seal() is called
+         * */
+        void setSealInterval(uint64_t nanoseconds) {
+            sealInterval.store(nanoseconds, std::memory_order_relaxed);
+            ready.notify_all();
+        }
+
+        /**
+         * Moves the open buffer to the queue and opens a spare one, the lock must be held
+         * */
+        void seal() {
+            if(current.empty()) {
+                return;
+            }
+
+            Item next;
+
+            if(!spare.empty()) {
+                next = std::move(spare.back());
+                spare.pop_back();
+            }
+
+            next.reserve(capacity);
+            std::swap(current, next);
+            queue.push_back(std::move(next));
+            setQueueDepth(queue.size());
+            ready.notify_all();
+        }
+
+        /**
+         * Marks the open buffer as opened now when it is empty, call it before copying into it. The lock must be held
+         * */
+        void openCurrent() {
+            if(current.empty()) {
+                currentOpened = clockNanoseconds();
+            }
+        }
+
+        /**
+         * Flushing the stream seals the open buffer, see SinkBuffer
+         * */
+        void sync() {
+            std::lock_guard<std::mutex> guard(lock);
+            seal();
+        }
+
+        //sealing on the interval only needs millisecond precision
+        static uint64_t clockNanoseconds() {
+            return CoarseClock::toNanoseconds(CoarseClock::ticks());
+        }
+
+        std::mutex lock;
+        //signalled when a buffer is sealed, when the sink stops and when the seal interval changes
+        std::condition_variable ready;
+        //signalled when the background thread takes a buffer off the queue and when it finished one
+        std::condition_variable space;
+        Item current;
+        uint64_t currentOpened = 0;
+        std::deque<Item> queue;
+        //the background thread is handling a buffer it took off the queue
+        bool busy = false;
+        bool stopping = false;
+
+    private:
+        friend class SinkBuffer<Sink>;
+
+        /**
+         * The background thread: handles the sealed buffers in order, and seals the open buffer once it has waited the seal interval
+         * */
+        void run() {
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(true) {
+                if(queue.empty()) {
+                    if(stopping) {
+                        break;
+                    }
+
+                    uint64_t interval = sealInterval.load(std::memory_order_relaxed);
+
+                    if(interval == 0) {
+                        ready.wait(guard);
+                        continue;
+                    }
+
+                    uint64_t now = clockNanoseconds();
+
+                    if(!current.empty() && now - currentOpened >= interval) {
+                        seal();
+                        continue;
+                    }
+
+                    uint64_t wait = current.empty()? interval : interval - (now - currentOpened);
+                    ready.wait_for(guard, std::chrono::nanoseconds(wait));
+                    continue;
+                }
+
+                Item item = std::move(queue.front());
+                queue.pop_front();
+                setQueueDepth(queue.size());
+                busy = true;
+                space.notify_all();
+                guard.unlock();
+
+                static_cast<Sink*>(this)->process(item);
+                item.clear();
+
+                guard.lock();
+                busy = false;
+
+                if(spare.size() < maxSpare) {
+                    spare.push_back(std::move(item));
+                }
+
+                space.notify_all();
+            }
+        }
+
+        size_t capacity;
+        size_t maxSpare;
+        std::vector<Item> spare;
+        std::atomic<uint64_t> sealInterval;
+        std::thread worker;
+};
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef INCLUDE_SHM_SINK_H
+#define INCLUDE_SHM_SINK_H
+
+#include <atomic>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LogSink.h"
+
+/**
+ * Output that copies each message into a ring in shared memory, drained to files by a separate process (the ShmCollector tool), POSIX only
+ * Writing a message is a reservation with compare and swap, a copy and a release store, so the process that logs makes no system calls at all
+ * ```
+ * ShmSink sink("/myservice-log", 8 << 20);
+ * logger.setTargetOutput(&sink);
+ * ```
+ * ```
+ * ShmCollector -o myservice.log /myservice-log
+ * ```
+ * Any number of threads can write to the sink; there is one reader. When the ring is full, messages are dropped
+ * and counted both in the sink (drp) and in the ring header, where the collector reports them
+ *
+ * The shared memory is a 256 byte header followed by the ring:
+ * ```
+ * magic "DLSR" | version | capacity | writer pid | state | head | tail | dropped
+ * ```
+ * head is where the next record is reserved and tail is where the reader is, both counted in bytes since the ring was created
+ * Each record is 16 bytes of stamp and length followed by the message, padded to 16 bytes. The stamp is written
+ * when the record is reserved and again once the message is in, so if the application dies the collector can tell
+ * complete records from torn ones and skip the torn ones, see Reader::salvage()
+ * @author Bryce Young
+ * */
+class ShmSink : public LogSink {
+    public:
+        static constexpr uint32_t MAGIC = 0x52534c44;
+        static constexpr uint32_t VERSION = 1;
+        static constexpr size_t HEADER_SIZE = 256;
+        static constexpr size_t RECORD_HEADER_SIZE = 16;
+
+        //states of the ring
+        static constexpr uint32_t STATE_OPEN = 1;
+        static constexpr uint32_t STATE_CLOSED = 2;
+
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the ring is shared between processes, so its atomics can't use locks");
+
+        struct Header {
+            std::atomic<uint32_t> magic;
+            uint32_t version;
+            uint64_t capacity;
+            uint32_t writerPid;
+            std::atomic<uint32_t> state;
+            alignas(64) std::atomic<uint64_t> head;
+            alignas(64) std::atomic<uint64_t> tail;
+            alignas(64) std::atomic<uint64_t> dropped;
+        };
+
+        static_assert(sizeof(Header) <= HEADER_SIZE, "the ring header should fit before the records");
+
+        struct RecordHeader {
+            std::atomic<uint64_t> stamp;
+            uint32_t length;
+            uint32_t flags;
+        };
+
+        //a record that only fills the end of the ring, so the next one can start at its beginning
+        static constexpr uint32_t PADDING_FLAG = 1;
+
+        /**
+         * Creates the ring named @param name (a shm_open name, like "/service-log"), replacing any ring already there
+         * @param capacity bytes of records, rounded up to a power of 2 (at least 4096)
+         * */
+        ShmSink(const char* name, size_t capacity = 4 << 20)
+            :LogSink(&buffer),
+            buffer(*this)
+        {
+            size_t size = 4096;
+
+            while(size < capacity) {
+                size *= 2;
+            }
+
+            shm_unlink(name);
+            int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+            if(fd < 0) {
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            if(ftruncate(fd, (off_t)(HEADER_SIZE + size)) != 0) {
+                close(fd);
+                shm_unlink(name);
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            void* memory = mmap(nullptr, HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if(memory == MAP_FAILED) {
+                shm_unlink(name);
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            //ftruncate zeroed the memory, so every stamp starts out unwritten
+            header = (Header*)memory;
+            records = (char*)memory + HEADER_SIZE;
+            mask = size - 1;
+            mappedSize = HEADER_SIZE + size;
+
+            header->version = VERSION;
+            header->capacity = size;
+            header->writerPid = (uint32_t)getpid();
+            header->state.store(STATE_OPEN, std::memory_order_relaxed);
+
+            //the magic goes last, a collector that sees it sees the rest of the header
+            header->magic.store(MAGIC, std::memory_order_release);
+        }
+
+        /**
+         * Marks the ring closed, so the collector finishes once it has drained it
+         * */
+        ~ShmSink() {
+            if(header) {
+                header->state.store(STATE_CLOSED, std::memory_order_release);
+                munmap(header, mappedSize);
+            }
+        }
+
+        ShmSink(const ShmSink&) = delete;
+        ShmSink& operator=(const ShmSink&) = delete;
+
+        bool isOpen() const {
+            return header != nullptr;
+        }
+
+        /**
+         * Returns the largest message the ring takes, longer ones are dropped
+         * */
+        size_t getMaxMessageSize() const {
+            return header? (mask + 1) / 4 - RECORD_HEADER_SIZE : 0;
+        }
+
+        /**
+         * Stamp of a record at @param position once it is reserved
+         * */
+        static uint64_t claimedStamp(uint64_t position) {
+            return (position + 1) | (1ull << 63);
+        }
+
+        /**
+         * Stamp of a record at @param position once its message is in
+         * */
+        static uint64_t committedStamp(uint64_t position) {
+            return position + 1;
+        }
+
+        static uint64_t recordSize(uint64_t length) {
+            return (RECORD_HEADER_SIZE + length + 15) & ~(uint64_t)15;
+        }
+
+        /**
+         * Reads the records of a ring created by a ShmSink, possibly in another process. Only one reader per ring
+         * ```
+         * ShmSink::Reader reader;
+         * reader.attach("/service-log");
+         * const char* data;
+         * size_t length;
+         *
+         * while(reader.peek(data, length) == ShmSink::Reader::RECORD) {
+         *     fwrite(data, 1, length, file);
+         *     reader.release();
+         * }
+         * ```
+         * */
+        class Reader {
+            public:
+                enum Status {
+                    //a message is ready
+                    RECORD,
+                    //every reserved record was read
+                    EMPTY,
+                    //the next record is reserved but its message isn't in yet
+                    PENDING
+                };
+
+                ~Reader() {
+                    detach();
+                }
+
+                /**
+                 * Maps the ring named @param name
+                 * @return false if there is no ring by that name or it isn't a complete ring of this version
+                 * */
+                bool attach(const char* name) {
+                    detach();
+                    int fd = shm_open(name, O_RDWR, 0);
+
+                    if(fd < 0) {
+                        return false;
+                    }
+
+                    struct stat status;
+
+                    if(fstat(fd, &status) != 0 || (size_t)status.st_size <= HEADER_SIZE) {
+                        close(fd);
+                        return false;
+                    }
+
+                    void* memory = mmap(nullptr, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    close(fd);
+
+                    if(memory == MAP_FAILED) {
+                        return false;
+                    }
+
+                    Header* mapped = (Header*)memory;
+                    uint64_t capacity = mapped->capacity;
+
+                    if(mapped->magic.load(std::memory_order_acquire) != MAGIC || mapped->version != VERSION ||
+                        (capacity & (capacity - 1)) != 0 || HEADER_SIZE + capacity != (uint64_t)status.st_size) {
+                        munmap(memory, (size_t)status.st_size);
+                        return false;
+                    }
+
+                    header = mapped;
+                    records = (char*)memory + HEADER_SIZE;
+                    mask = capacity - 1;
+                    mappedSize = (size_t)status.st_size;
+                    device = status.st_dev;
+                    inode = status.st_ino;
+                    tail = header->tail.load(std::memory_order_relaxed);
+                    return true;
+                }
+
+                void detach() {
+                    if(header) {
+                        munmap(header, mappedSize);
+                        header = nullptr;
+                    }
+                }
+
+                bool isAttached() const {
+                    return header != nullptr;
+                }
+
+                /**
+                 * Returns whether the name still refers to the ring this reader has mapped, a new ShmSink replaces it
+                 * */
+                bool isCurrent(const char* name) const {
+                    int fd = shm_open(name, O_RDONLY, 0);
+
+                    if(fd < 0) {
+                        return false;
+                    }
+
+                    struct stat status;
+                    bool current = fstat(fd, &status) == 0 && status.st_dev == device && status.st_ino == inode;
+                    close(fd);
+                    return current;
+                }
+
+                /**
+                 * Finds the next message, which stays valid until release()
+                 * */
+                Status peek(const char*& data, size_t& length) {
+                    while(true) {
+                        if(tail == header->head.load(std::memory_order_acquire)) {
+                            return EMPTY;
+                        }
+
+                        RecordHeader* record = (RecordHeader*)(records + (tail & mask));
+
+                        if(record->stamp.load(std::memory_order_acquire) != committedStamp(tail)) {
+                            return PENDING;
+                        }
+
+                        if(record->flags & PADDING_FLAG) {
+                            advance(RECORD_HEADER_SIZE + record->length);
+                            continue;
+                        }
+
+                        data = (const char*)record + RECORD_HEADER_SIZE;
+                        length = record->length;
+                        return RECORD;
+                    }
+                }
+
+                /**
+                 * Hands the space of the message returned by peek() back to the writers
+                 * */
+                void release() {
+                    RecordHeader* record = (RecordHeader*)(records + (tail & mask));
+                    advance(recordSize(record->length));
+                }
+
+                /**
+                 * Returns whether the writer closed the ring
+                 * */
+                bool isClosed() const {
+                    return header->state.load(std::memory_order_acquire) == STATE_CLOSED;
+                }
+
+                /**
+                 * Returns whether the process that created the ring is gone without closing it
+                 * */
+                bool isWriterDead() const {
+                    return !isClosed() && kill((pid_t)header->writerPid, 0) != 0 && errno == ESRCH;
+                }
+
+                /**
+                 * Gets past a record that will never be finished, once the writer is dead
+                 * A record whose message was being copied is skipped, its length is known. A record that was reserved but
+                 * never stamped hides where the next one starts, so everything up to the head is given up
+                 * @return the bytes given up
+                 * */
+                uint64_t salvage() {
+                    uint64_t head = header->head.load(std::memory_order_acquire);
+
+                    if(tail == head) {
+                        return 0;
+                    }
+
+                    RecordHeader* record = (RecordHeader*)(records + (tail & mask));
+                    uint64_t size = recordSize(record->length);
+
+                    if(record->stamp.load(std::memory_order_acquire) == claimedStamp(tail) && size <= head - tail) {
+                        advance(size);
+                        return size;
+                    }
+
+                    uint64_t lost = head - tail;
+                    advance(lost);
+                    return lost;
+                }
+
+                uint64_t getDropped() const {
+                    return header->dropped.load(std::memory_order_relaxed);
+                }
+
+                uint64_t getCapacity() const {
+                    return mask + 1;
+                }
+
+                uint32_t getWriterPid() const {
+                    return header->writerPid;
+                }
+
+            private:
+                void advance(uint64_t bytes) {
+                    tail += bytes;
+                    header->tail.store(tail, std::memory_order_release);
+                }
+
+                Header* header = nullptr;
+                char* records = nullptr;
+                uint64_t mask = 0;
+                size_t mappedSize = 0;
+                uint64_t tail = 0;
+                dev_t device = 0;
+                ino_t inode = 0;
+        };
+
+    private:
+        friend class SinkBuffer<ShmSink>;
+
+        /**
+         * Copies one message (everything a logger writes for a message comes in one write) into the ring
+         * */
+        bool write(const char* data, size_t length) {
+            if(!header) {
+                return false;
+            }
+
+            uint64_t capacity = mask + 1;
+            uint64_t size = recordSize(length);
+
+            if(length > getMaxMessageSize()) {
+                drop();
+                return true;
+            }
+
+            uint64_t head = header->head.load(std::memory_order_relaxed);
+            uint64_t padding;
+
+            do {
+                //a record never wraps, the end of the ring is padded instead
+                uint64_t room = capacity - (head & mask);
+                padding = size <= room? 0 : room;
+
+                if(head + padding + size - header->tail.load(std::memory_order_acquire) > capacity) {
+                    drop();
+                    return true;
+                }
+            } while(!header->head.compare_exchange_weak(head, head + padding + size, std::memory_order_relaxed, std::memory_order_relaxed));
+
+            if(padding) {
+                RecordHeader* pad = (RecordHeader*)(records + (head & mask));
+                pad->length = (uint32_t)(padding - RECORD_HEADER_SIZE);
+                pad->flags = PADDING_FLAG;
+                pad->stamp.store(committedStamp(head), std::memory_order_release);
+                head += padding;
+            }
+
+            RecordHeader* record = (RecordHeader*)(records + (head & mask));
+            record->length = (uint32_t)length;
+            record->flags = 0;
+            record->stamp.store(claimedStamp(head), std::memory_order_release);
+            memcpy((char*)record + RECORD_HEADER_SIZE, data, length);
+            record->stamp.store(committedStamp(head), std::memory_order_release);
+            return true;
+        }
+
+        void drop() {
+            header->dropped.fetch_add(1, std::memory_order_relaxed);
+            addDropped(1);
+        }
+
+        //every message is in the ring once it is written, so flushing the stream has nothing to do
+        void sync() {
+        }
+
+        SinkBuffer<ShmSink> buffer;
+        Header* header = nullptr;
+        char* records = nullptr;
+        uint64_t mask = 0;
+        size_t mappedSize = 0;
+};
+
+#endif
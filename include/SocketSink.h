@@ -0,0 +1,473 @@
+#ifndef INCLUDE_SOCKET_SINK_H
+#define INCLUDE_SOCKET_SINK_H
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "LogSink.h"
+#include "QueuedSink.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Messages SocketSink sends together, @param ends holds where each message ends in the text
+ * */
+struct SocketBatch {
+    std::vector<char> text;
+    std::vector<size_t> ends;
+
+    bool empty() const {
+        return text.empty();
+    }
+
+    void clear() {
+        text.clear();
+        ends.clear();
+    }
+
+    void reserve(size_t size) {
+        text.reserve(size);
+    }
+
+    /**
+     * Returns the number of messages that don't end within the first @param sent bytes
+     * */
+    uint64_t messagesAfter(size_t sent) const {
+        return (uint64_t)(ends.end() - std::upper_bound(ends.begin(), ends.end(), sent));
+    }
+
+    /**
+     * Returns where the first message that doesn't end within the first @param sent bytes starts
+     * */
+    size_t messageStart(size_t sent) const {
+        std::vector<size_t>::const_iterator end = std::upper_bound(ends.begin(), ends.end(), sent);
+        return end == ends.begin()? 0 : *(end - 1);
+    }
+};
+
+/**
+ * Output that sends batches of messages to a local collector over a Unix domain socket or UDP, POSIX only
+ * ```
+ * SocketSink sink("unix:/run/agent/log.sock");
+ * logger.setTargetOutput(&sink);
+ * ```
+ * Addresses are written as:
+ * 1. unix:path          a Unix domain datagram socket, one datagram per batch
+ * 2. unix-stream:path   a Unix domain stream socket, batches are written back to back
+ * 3. udp:host:port      a UDP datagram per batch, host is an IPv4 address or localhost
+ *
+ * Messages are copied into the current batch, which is sent by a background thread when it reaches the batch size
+ * or has waited the latency bound, so the thread that logs never blocks on the socket. A message is never split between batches
+ * When the collector is slow the sealed batches queue up, and once the queue is full new messages are dropped and counted in the dropped messages
+ * The socket is non-blocking. When the collector goes away the sink reconnects, waiting longer after each failure, and keeps the queued batches for it;
+ * a batch that was cut off by a lost stream connection is sent again from the first message the collector didn't get whole,
+ * so a collector sees the message that was cut off twice, first torn. Over UDP the sink only learns the collector is away
+ * from the error of a later send, so the datagrams sent in between are lost
+ * The queue depth variables count batches, the dropped count is messages
+ * @author Bryce Young
+ * */
+class SocketSink : public QueuedSink<SocketSink, SocketBatch> {
+    public:
+        /**
+         * A parsed collector address
+         * */
+        struct Address {
+            sockaddr_storage storage;
+            socklen_t length = 0;
+            //SOCK_DGRAM or SOCK_STREAM
+            int type = SOCK_DGRAM;
+
+            int family() const {
+                return storage.ss_family;
+            }
+
+            const sockaddr* get() const {
+                return (const sockaddr*)&storage;
+            }
+
+            /**
+             * Reads @param text in one of the forms listed on SocketSink into @param address
+             * @return false if it isn't a valid address
+             * */
+            static bool parse(const char* text, Address& address) {
+                memset(&address.storage, 0, sizeof(address.storage));
+
+                if(strncmp(text, "unix:", 5) == 0 || strncmp(text, "unix-stream:", 12) == 0) {
+                    bool stream = text[4] == '-';
+                    const char* path = text + (stream? 12 : 5);
+                    sockaddr_un* unixAddress = (sockaddr_un*)&address.storage;
+
+                    if(!path[0] || strlen(path) >= sizeof(unixAddress->sun_path)) {
+                        return false;
+                    }
+
+                    unixAddress->sun_family = AF_UNIX;
+                    strcpy(unixAddress->sun_path, path);
+                    address.length = (socklen_t)sizeof(sockaddr_un);
+                    address.type = stream? SOCK_STREAM : SOCK_DGRAM;
+                    return true;
+                }
+
+                if(strncmp(text, "udp:", 4) == 0) {
+                    const char* host = text + 4;
+                    const char* colon = strrchr(host, ':');
+
+                    if(!colon || colon == host || colon - host >= 64) {
+                        return false;
+                    }
+
+                    char hostText[64];
+                    memcpy(hostText, host, colon - host);
+                    hostText[colon - host] = 0;
+
+                    char* end;
+                    unsigned long port = strtoul(colon + 1, &end, 10);
+                    sockaddr_in* inetAddress = (sockaddr_in*)&address.storage;
+
+                    if(*end || port == 0 || port > 65535) {
+                        return false;
+                    }
+
+                    if(strcmp(hostText, "localhost") == 0) {
+                        strcpy(hostText, "127.0.0.1");
+                    }
+
+                    if(inet_pton(AF_INET, hostText, &inetAddress->sin_addr) != 1) {
+                        return false;
+                    }
+
+                    inetAddress->sin_family = AF_INET;
+                    inetAddress->sin_port = htons((uint16_t)port);
+                    address.length = (socklen_t)sizeof(sockaddr_in);
+                    address.type = SOCK_DGRAM;
+                    return true;
+                }
+
+                return false;
+            }
+        };
+
+        //the largest UDP payload
+        static constexpr size_t MAX_UDP_BATCH = 65507;
+
+        /**
+         * @param address the collector, see the forms above
+         * @param batchSize bytes of messages per batch, larger batches mean fewer system calls (at most MAX_UDP_BATCH over UDP)
+         * */
+        SocketSink(const char* address, size_t batchSize = 16384)
+            :QueuedSink(&buffer, 10, validBatchSize(address, batchSize), 4),
+            buffer(*this),
+            batchSize(validBatchSize(address, batchSize))
+        {
+            if(!Address::parse(address, collector)) {
+                setstate(std::ios::badbit);
+                return;
+            }
+
+            valid = true;
+            startWorker();
+        }
+
+        /**
+         * Tries to send every queued batch before closing the socket, batches the collector can't take are dropped
+         * */
+        ~SocketSink() {
+            if(!valid) {
+                return;
+            }
+
+            stopWorker();
+
+            if(socketFd >= 0) {
+                close(socketFd);
+            }
+        }
+
+        SocketSink(const SocketSink&) = delete;
+        SocketSink& operator=(const SocketSink&) = delete;
+
+        /**
+         * Returns whether the address could be parsed, the collector doesn't have to be up
+         * */
+        bool isValid() const {
+            return valid;
+        }
+
+        /**
+         * Returns whether the sink is connected to the collector right now
+         * */
+        bool isConnected() const {
+            return connected.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Sets how long a partly filled batch may wait before it is sent, 0 to only send full batches (default 10ms)
+         * The clock is coarse, so batches can wait a few milliseconds longer
+         * */
+        void setMaxLatency(uint64_t milliseconds) {
+            setSealInterval(milliseconds * 1000000);
+        }
+
+        /**
+         * Sets the number of sealed batches that may wait for the collector before new messages are dropped (default 256)
+         * */
+        void setMaxQueuedBatches(size_t batches) {
+            std::lock_guard<std::mutex> guard(lock);
+            maxQueuedBatches = batches > 0? batches : 1;
+        }
+
+        /**
+         * Sets how long to wait before reconnecting after a failure, doubling from @param minimumMilliseconds
+         * up to @param maximumMilliseconds while the collector stays away (default 50ms to 2000ms)
+         * */
+        void setReconnectDelay(uint64_t minimumMilliseconds, uint64_t maximumMilliseconds) {
+            minimumReconnectDelay.store(minimumMilliseconds * 1000000, std::memory_order_relaxed);
+            maximumReconnectDelay.store((maximumMilliseconds > minimumMilliseconds? maximumMilliseconds : minimumMilliseconds) * 1000000, std::memory_order_relaxed);
+        }
+
+        /**
+         * Seals the open batch and waits until every queued batch was sent or dropped
+         * */
+        void drain() {
+            if(valid) {
+                drainQueue();
+            }
+        }
+
+        /**
+         * Returns the number of message bytes the collector accepted
+         * */
+        uint64_t getSentBytes() const {
+            return sentBytes.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the number of batches the collector accepted
+         * */
+        uint64_t getSentBatches() const {
+            return sentBatches.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the number of times the sink connected to the collector, more than 1 means it had to reconnect
+         * */
+        uint64_t getConnects() const {
+            return connects.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class QueuedSink<SocketSink, SocketBatch>;
+        friend class SinkBuffer<SocketSink>;
+
+        /**
+         * Adds one message (everything a logger writes for a message comes in one write) to the open batch
+         * */
+        bool write(const char* data, size_t length) {
+            if(!valid) {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+
+            if(!current.empty() && current.text.size() + length > batchSize) {
+                if(queue.size() >= maxQueuedBatches) {
+                    addDropped(1);
+                    return true;
+                }
+
+                seal();
+            }
+
+            openCurrent();
+            current.text.insert(current.text.end(), data, data + length);
+            current.ends.push_back(current.text.size());
+
+            if(current.text.size() >= batchSize && queue.size() < maxQueuedBatches) {
+                seal();
+            }
+
+            return true;
+        }
+
+        /**
+         * Sends @param batch, reconnecting and waiting for room in the socket as needed
+         * Gives up on the batch when it can never be sent (too large for a datagram) or when the sink is stopping and the collector is away
+         * */
+        void process(const SocketBatch& batch) {
+            size_t sent = 0;
+            bool blocked = false;
+
+            while(true) {
+                if(socketFd < 0 && !connect()) {
+                    if(!waitToReconnect()) {
+                        addDropped(batch.messagesAfter(sent));
+                        return;
+                    }
+
+                    continue;
+                }
+
+                ssize_t result = ::send(socketFd, batch.text.data() + sent, batch.text.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+                if(result >= 0) {
+                    sent += (size_t)result;
+
+                    if(collector.type == SOCK_STREAM && sent < batch.text.size()) {
+                        continue;
+                    }
+
+                    sentBytes.fetch_add(batch.text.size(), std::memory_order_relaxed);
+                    sentBatches.fetch_add(1, std::memory_order_relaxed);
+                    reconnectDelay = minimumReconnectDelay.load(std::memory_order_relaxed);
+                    return;
+                }
+
+                if(errno == EINTR) {
+                    continue;
+                }
+
+                if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                    //the collector is behind, wait for room while the writers fill the queue
+                    pollfd waiting = { socketFd, POLLOUT, 0 };
+                    int ready = poll(&waiting, 1, 100);
+
+                    if(ready == 0 && isStopping()) {
+                        addDropped(batch.messagesAfter(sent));
+                        return;
+                    }
+
+                    //a datagram socket can report room in its own buffer while the collector's is still full, so back off instead of spinning
+                    if(ready != 0 && collector.type == SOCK_DGRAM && blocked) {
+                        pause(1000000);
+                    }
+
+                    blocked = true;
+                    continue;
+                }
+
+                if(errno == EMSGSIZE) {
+                    addDropped(batch.messagesAfter(sent));
+                    return;
+                }
+
+                //the collector went away: messages written to the socket whole aren't sent again, the one cut off is sent again whole
+                disconnect();
+                sent = batch.messageStart(sent);
+
+                if(!waitToReconnect()) {
+                    addDropped(batch.messagesAfter(sent));
+                    return;
+                }
+            }
+        }
+
+        /**
+         * Waits before the next connection attempt, longer after each failure in a row
+         * @return false if the sink is stopping, so the batch should be given up
+         * */
+        bool waitToReconnect() {
+            if(isStopping() || !pause(reconnectDelay)) {
+                return false;
+            }
+
+            uint64_t maximum = maximumReconnectDelay.load(std::memory_order_relaxed);
+            reconnectDelay = reconnectDelay * 2 < maximum? reconnectDelay * 2 : maximum;
+            return true;
+        }
+
+        bool connect() {
+            int fd = socket(collector.family(), collector.type, 0);
+
+            if(fd < 0) {
+                return false;
+            }
+
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+            //local collectors accept at once, so the connect can block and only the sends are non-blocking
+            if(::connect(fd, collector.get(), collector.length) != 0) {
+                close(fd);
+                return false;
+            }
+
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            socketFd = fd;
+            connected.store(true, std::memory_order_relaxed);
+            connects.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void disconnect() {
+            if(socketFd >= 0) {
+                close(socketFd);
+                socketFd = -1;
+            }
+
+            connected.store(false, std::memory_order_relaxed);
+        }
+
+        /**
+         * Waits @param nanoseconds or until the sink is stopping
+         * @return false if it is stopping
+         * */
+        bool pause(uint64_t nanoseconds) {
+            std::unique_lock<std::mutex> guard(lock);
+            return !ready.wait_for(guard, std::chrono::nanoseconds(nanoseconds), [this]() { return stopping; });
+        }
+
+        bool isStopping() {
+            std::lock_guard<std::mutex> guard(lock);
+            return stopping;
+        }
+
+        /**
+         * Returns @param batchSize, or the default when it is 0, at most MAX_UDP_BATCH for a UDP @param address
+         * */
+        static size_t validBatchSize(const char* address, size_t batchSize) {
+            if(batchSize == 0) {
+                batchSize = 16384;
+            }
+
+            return (strncmp(address, "udp:", 4) == 0 && batchSize > MAX_UDP_BATCH)? MAX_UDP_BATCH : batchSize;
+        }
+
+        SinkBuffer<SocketSink> buffer;
+        Address collector;
+        size_t batchSize;
+        bool valid = false;
+
+        size_t maxQueuedBatches = 256;
+
+        //only touched by the background thread
+        int socketFd = -1;
+        uint64_t reconnectDelay = 50000000;
+
+        std::atomic<bool> connected{ false };
+        std::atomic<uint64_t> minimumReconnectDelay{ 50000000 };
+        std::atomic<uint64_t> maximumReconnectDelay{ 2000000000 };
+        std::atomic<uint64_t> sentBytes{ 0 };
+        std::atomic<uint64_t> sentBatches{ 0 };
+        std::atomic<uint64_t> connects{ 0 };
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef INCLUDE_THREADSHARDS_H
+#define INCLUDE_THREADSHARDS_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * One Shard per thread for an object that many threads record into, like LatencyHistogram and LogMetrics
+ * A thread takes its shard on its first get() and is the only one writing to it, so a record is a load and a store
+ * without a locked instruction. Readers add the shards up with forEach()
+ * A thread's shard is handed back with its values when the thread exits, and goes to the next new thread
+ * Shard must be default constructible. Align it to 64 bytes so two threads' shards never share a cache line
+ * @author Bryce Young
+ * */
+template<class Shard>
+class ThreadShards {
+    public:
+        ThreadShards()
+            :pool(new Pool()),
+            id(nextId().fetch_add(1, std::memory_order_relaxed))
+        {
+        }
+
+        ThreadShards(const ThreadShards&) = delete;
+        ThreadShards& operator=(const ThreadShards&) = delete;
+
+        /**
+         * Returns the calling thread's shard
+         * */
+        Shard& get() {
+            static thread_local Last last = { 0, nullptr };
+
+            if(last.id != id) {
+                last.shard = find();
+                last.id = id;
+            }
+
+            return *last.shard;
+        }
+
+        /**
+         * Calls @param visit with every shard, including those of threads that exited, while no thread can take a new one
+         * */
+        template<typename Visit>
+        void forEach(Visit visit) const {
+            std::lock_guard<std::mutex> guard(pool->lock);
+
+            for(const std::unique_ptr<Shard>& shard : pool->shards) {
+                visit(*shard);
+            }
+        }
+
+        /**
+         * Adds @param value to @param cell of the calling thread's shard. Only the owning thread writes, so a load and a store will do
+         * */
+        static void add(std::atomic<uint64_t>& cell, uint64_t value) {
+            cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+    private:
+        /**
+         * The shards, shared with the threads that hold one so they can hand it back after the object is gone
+         * */
+        struct Pool {
+            std::mutex lock;
+            std::vector<std::unique_ptr<Shard>> shards;
+            std::vector<Shard*> unused;
+
+            Shard* acquire() {
+                std::lock_guard<std::mutex> guard(lock);
+
+                if(!unused.empty()) {
+                    Shard* shard = unused.back();
+                    unused.pop_back();
+                    return shard;
+                }
+
+                shards.emplace_back(new Shard());
+                return shards.back().get();
+            }
+
+            void release(Shard* shard) {
+                std::lock_guard<std::mutex> guard(lock);
+                unused.push_back(shard);
+            }
+        };
+
+        /**
+         * The object this thread last used and its shard there, plain data so the thread_local needs no guard
+         * */
+        struct Last {
+            uint64_t id;
+            Shard* shard;
+        };
+
+        /**
+         * Every shard this thread holds, released when the thread exits
+         * */
+        struct Held {
+            struct Entry {
+                uint64_t id;
+                Shard* shard;
+                std::weak_ptr<Pool> pool;
+            };
+
+            std::vector<Entry> entries;
+
+            ~Held() {
+                for(Entry& entry : entries) {
+                    std::shared_ptr<Pool> pool = entry.pool.lock();
+
+                    if(pool) {
+                        pool->release(entry.shard);
+                    }
+                }
+            }
+        };
+
+        Shard* find() {
+            static thread_local Held held;
+
+            for(typename Held::Entry& entry : held.entries) {
+                if(entry.id == id) {
+                    return entry.shard;
+                }
+            }
+
+            //the shards of objects that are gone went with them
+            held.entries.erase(std::remove_if(held.entries.begin(), held.entries.end(),
+                [](const typename Held::Entry& entry) { return entry.pool.expired(); }), held.entries.end());
+
+            Shard* shard = pool->acquire();
+            held.entries.push_back({ id, shard, pool });
+            return shard;
+        }
+
+        //ids tell the objects apart in the threads' caches, even a new one at the address of a destroyed one
+        static std::atomic<uint64_t>& nextId() {
+            static std::atomic<uint64_t> next{ 1 };
+            return next;
+        }
+
+        std::shared_ptr<Pool> pool;
+        uint64_t id;
+};
+
+#endif
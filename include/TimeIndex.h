@@ -0,0 +1,255 @@
+#ifndef INCLUDE_TIME_INDEX_H
+#define INCLUDE_TIME_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "LogCompression.h"
+
+/**
+ * Sidecar index of a log file, written by FileSink and CompressedSink when enableTimeIndex() is called
+ * Every N messages or M milliseconds of logger time the sink adds an entry pointing at the start of a message,
+ * so a reader can binary search for a time or a message number instead of scanning the whole log (see the LogSlice tool)
+ *
+ * The index file is the magic "DLX1", a uint32 of flags, then fixed size entries:
+ * ```
+ * uint64 logger nanoseconds (tl) | uint64 message count (dmc) | uint64 file offset | uint64 offset in the block's text
+ * ```
+ * In a compressed log the file offset is the block holding the message and the text offset is where the message starts
+ * in the block's text, in a plain log the text offset is 0. Integers are little endian
+ * @author Bryce Young
+ * */
+class TimeIndex {
+    public:
+        static constexpr uint32_t FILE_MAGIC = 0x31584c44;
+        static constexpr uint32_t COMPRESSED_FLAG = 1;
+        static constexpr size_t HEADER_SIZE = 8;
+        static constexpr size_t ENTRY_SIZE = 32;
+
+        struct Entry {
+            uint64_t nanoseconds = 0;
+            uint64_t messageCount = 0;
+            uint64_t fileOffset = 0;
+            uint64_t textOffset = 0;
+        };
+
+        /**
+         * Decides when an entry is due and appends entries to the index file
+         * */
+        class Writer {
+            public:
+                ~Writer() {
+                    close();
+                }
+
+                /**
+                 * Creates the index at @param path, replacing any file already there
+                 * An entry is added every @param everyMessages messages or @param everyMilliseconds of logger time, whichever comes first
+                 * */
+                bool open(const char* path, bool compressed, uint64_t everyMessages, uint64_t everyMilliseconds) {
+                    close();
+                    file = fopen(path, "wb");
+
+                    if(!file) {
+                        return false;
+                    }
+
+                    char header[HEADER_SIZE];
+                    write32(header, FILE_MAGIC);
+                    write32(header + 4, compressed? COMPRESSED_FLAG : 0);
+                    fwrite(header, 1, HEADER_SIZE, file);
+                    fflush(file);
+
+                    this->everyMessages = everyMessages? everyMessages : UINT64_MAX;
+                    this->everyNanoseconds = everyMilliseconds? everyMilliseconds * 1000000 : UINT64_MAX;
+                    entries = 0;
+                    return true;
+                }
+
+                void close() {
+                    if(file) {
+                        fclose(file);
+                        file = nullptr;
+                    }
+                }
+
+                bool isOpen() const {
+                    return file != nullptr;
+                }
+
+                /**
+                 * Returns whether the message @param messageCount logged at @param nanoseconds should get an entry
+                 * Entries only move forward, a message older than the last entry never gets one
+                 * */
+                bool isDue(uint64_t nanoseconds, uint64_t messageCount) const {
+                    if(!file) {
+                        return false;
+                    }
+
+                    if(entries == 0) {
+                        return true;
+                    }
+
+                    if(nanoseconds < last.nanoseconds || messageCount <= last.messageCount) {
+                        return false;
+                    }
+
+                    return messageCount - last.messageCount >= everyMessages || nanoseconds - last.nanoseconds >= everyNanoseconds;
+                }
+
+                /**
+                 * Marks @param entry as the newest one, which isDue() measures from
+                 * The entry is written with write(), which can happen later (once a compressed block has a file offset)
+                 * */
+                void markDue(const Entry& entry) {
+                    last = entry;
+                    entries++;
+                }
+
+                void write(const Entry& entry) {
+                    char bytes[ENTRY_SIZE];
+                    write64(bytes, entry.nanoseconds);
+                    write64(bytes + 8, entry.messageCount);
+                    write64(bytes + 16, entry.fileOffset);
+                    write64(bytes + 24, entry.textOffset);
+                    fwrite(bytes, 1, ENTRY_SIZE, file);
+                }
+
+                void flush() {
+                    if(file) {
+                        fflush(file);
+                    }
+                }
+
+            private:
+                FILE* file = nullptr;
+                uint64_t everyMessages = UINT64_MAX;
+                uint64_t everyNanoseconds = UINT64_MAX;
+                uint64_t entries = 0;
+                Entry last;
+        };
+
+        /**
+         * Binary searches an index file, reading only the entries it compares
+         * */
+        class Reader {
+            public:
+                /**
+                 * @param file an open index file, not closed by the reader
+                 * */
+                Reader(FILE* file)
+                    :file(file)
+                {
+                    char header[HEADER_SIZE];
+
+                    if(fread(header, 1, HEADER_SIZE, file) != HEADER_SIZE || read32(header) != FILE_MAGIC) {
+                        return;
+                    }
+
+                    valid = true;
+                    compressed = (read32(header + 4) & COMPRESSED_FLAG) != 0;
+
+                    //a torn last entry is ignored
+                    if(LogCompression::seekFile(file, 0, SEEK_END)) {
+                        int64_t size = LogCompression::tellFile(file);
+                        count = size > (int64_t)HEADER_SIZE? (uint64_t)(size - (int64_t)HEADER_SIZE) / ENTRY_SIZE : 0;
+                    }
+                }
+
+                bool isValid() const {
+                    return valid;
+                }
+
+                /**
+                 * Returns whether the log the index belongs to is compressed
+                 * */
+                bool isCompressed() const {
+                    return compressed;
+                }
+
+                uint64_t size() const {
+                    return count;
+                }
+
+                bool read(uint64_t index, Entry& entry) {
+                    char bytes[ENTRY_SIZE];
+
+                    if(index >= count || !LogCompression::seekFile(file, HEADER_SIZE + index * ENTRY_SIZE) || fread(bytes, 1, ENTRY_SIZE, file) != ENTRY_SIZE) {
+                        return false;
+                    }
+
+                    entry.nanoseconds = read64(bytes);
+                    entry.messageCount = read64(bytes + 8);
+                    entry.fileOffset = read64(bytes + 16);
+                    entry.textOffset = read64(bytes + 24);
+                    return true;
+                }
+
+                /**
+                 * Returns the number of entries logged at or before @param nanoseconds,
+                 * so the last of them is where a slice starting at that time begins
+                 * */
+                uint64_t countUpToTime(uint64_t nanoseconds) {
+                    return countUpTo(nanoseconds, false);
+                }
+
+                /**
+                 * Returns the number of entries for message @param messageCount or an earlier one
+                 * */
+                uint64_t countUpToMessage(uint64_t messageCount) {
+                    return countUpTo(messageCount, true);
+                }
+
+            private:
+                uint64_t countUpTo(uint64_t value, bool byMessage) {
+                    uint64_t low = 0;
+                    uint64_t high = count;
+                    Entry entry;
+
+                    while(low < high) {
+                        uint64_t middle = low + (high - low) / 2;
+
+                        if(!read(middle, entry)) {
+                            return low;
+                        }
+
+                        if((byMessage? entry.messageCount : entry.nanoseconds) <= value) {
+                            low = middle + 1;
+                        }
+                        else {
+                            high = middle;
+                        }
+                    }
+
+                    return low;
+                }
+
+                FILE* file;
+                bool valid = false;
+                bool compressed = false;
+                uint64_t count = 0;
+        };
+
+    private:
+        static uint32_t read32(const char* data) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+        }
+
+        static uint64_t read64(const char* data) {
+            return (uint64_t)read32(data) | ((uint64_t)read32(data + 4) << 32);
+        }
+
+        static void write32(char* data, uint32_t value) {
+            for(int i = 0; i < 4; ++i) {
+                data[i] = (char)(value >> (i * 8));
+            }
+        }
+
+        static void write64(char* data, uint64_t value) {
+            write32(data, (uint32_t)value);
+            write32(data + 4, (uint32_t)(value >> 32));
+        }
+};
+
+#endif
@@ -1,49 +1,247 @@
 #ifndef INCLUDE_TIMER_H
 #define INCLUDE_TIMER_H
 
+#include <atomic>
 #include <chrono>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TIMER_HAS_TSC 1
+#endif
+
+/**
+ * Clock policies for BasicTimer
+ * Each policy reads a monotonic tick count with ticks() and converts a number of ticks to nanoseconds with toNanoseconds()
+ * */
+
+/**
+ * std::chrono::steady_clock, one vDSO call per read
+ * */
+struct SteadyClock {
+    static inline uint64_t ticks() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline uint64_t toNanoseconds(uint64_t ticks) {
+        return ticks;
+    }
+};
+
+/**
+ * CLOCK_MONOTONIC_COARSE, the time of the last timer interrupt (usually 1 to 4ms resolution)
+ * Falls back to SteadyClock where the coarse clock isn't available
+ * */
+struct CoarseClock {
+    static inline uint64_t ticks() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#else
+        return SteadyClock::ticks();
+#endif
+    }
+
+    static inline uint64_t toNanoseconds(uint64_t ticks) {
+        return ticks;
+    }
+};
+
+/**
+ * The invariant time stamp counter, calibrated against steady_clock the first time it is used (which takes about 10ms)
+ * Ticks are converted to nanoseconds with a multiply and a shift
+ * Falls back to SteadyClock when the processor doesn't report an invariant TSC
+ * */
+class TscClock {
+    public:
+        /**
+         * The conversion from ticks to nanoseconds, nanoseconds = (ticks * multiplier) >> shift
+         * */
+        struct Calibration {
+            bool invariant = false;
+            uint64_t multiplier = 1;
+            int shift = 0;
+        };
+
+        static inline uint64_t ticks() {
+#ifdef TIMER_HAS_TSC
+            if(getCalibration().invariant) {
+                return __rdtsc();
+            }
+#endif
+            return SteadyClock::ticks();
+        }
+
+        static inline uint64_t toNanoseconds(uint64_t ticks) {
+#ifdef TIMER_HAS_TSC
+            const Calibration& calibration = getCalibration();
+            return (uint64_t)(((unsigned __int128)ticks * calibration.multiplier) >> calibration.shift);
+#else
+            return ticks;
+#endif
+        }
+
+        /**
+         * Returns whether ticks() reads the TSC rather than steady_clock
+         * */
+        static bool isInvariant() {
+            return getCalibration().invariant;
+        }
+
+        static const Calibration& getCalibration() {
+            static const Calibration calibration = calibrate();
+            return calibration;
+        }
+
+    private:
+        static Calibration calibrate() {
+            Calibration calibration;
+#ifdef TIMER_HAS_TSC
+            unsigned int eax, ebx, ecx, edx;
+
+            //the invariant TSC flag is bit 8 of edx in leaf 0x80000007
+            if(__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+                return calibration;
+            }
+
+            __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+
+            if(!(edx & (1u << 8))) {
+                return calibration;
+            }
+
+            uint64_t startNanoseconds = 0, startTicks = 0, endNanoseconds = 0, endTicks = 0;
+            sample(startNanoseconds, startTicks);
+
+            do {
+                sample(endNanoseconds, endTicks);
+            } while(endNanoseconds - startNanoseconds < 10000000);
+
+            if(endTicks <= startTicks) {
+                return calibration;
+            }
+
+            calibration.invariant = true;
+            calibration.shift = 32;
+            calibration.multiplier = (uint64_t)((double)(endNanoseconds - startNanoseconds) / (double)(endTicks - startTicks) * 4294967296.0);
+#endif
+            return calibration;
+        }
+
+#ifdef TIMER_HAS_TSC
+        /**
+         * Reads steady_clock and the TSC at the same moment
+         * The TSC is read on both sides of steady_clock, and the tightest of a few tries is kept so an interrupt doesn't skew it
+         * */
+        static void sample(uint64_t& nanoseconds, uint64_t& ticks) {
+            uint64_t tightest = UINT64_MAX;
+
+            for(int i = 0; i < 8; ++i) {
+                uint64_t before = __rdtsc();
+                uint64_t now = SteadyClock::ticks();
+                uint64_t after = __rdtsc();
+
+                if(after - before < tightest) {
+                    tightest = after - before;
+                    nanoseconds = now;
+                    ticks = before + (after - before) / 2;
+                }
+            }
+        }
+#endif
+};
 
 /**
  * Class to handle time differentials
  * Construct the timer object with no parameters which will automatically reset the data
  * calling any of the functions nanoseconds(), microseconds(), milliseconds(), seconds() will return the time passed since the last call of reset
- * calling reset clears the data in the timer 
+ * calling reset clears the data in the timer
+ * Clock is one of the clock policies above. Elapsed times are clamped at 0, so they never go negative
  * @author Bryce Young 2017
  * */
-class Timer{
+template<typename Clock>
+class BasicTimer{
     public:
-        Timer(){
+        BasicTimer(){
             reset();
         }
 
-        ~Timer(){}
+        ~BasicTimer(){}
 
         inline void reset(){
-            this->prevTP = std::chrono::high_resolution_clock::now();
+            this->start = Clock::ticks();
         }
 
         inline uint64_t nanoseconds(){
-            auto now = std::chrono::high_resolution_clock::now();
-            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - prevTP).count();
+            uint64_t now = Clock::ticks();
+            return (now > start)? Clock::toNanoseconds(now - start) : 0;
         }
 
         inline uint64_t microseconds(){
-            auto now = std::chrono::high_resolution_clock::now();
-            return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - prevTP).count();
+            return nanoseconds() / 1000;
         }
 
         inline uint64_t milliseconds(){
-            auto now = std::chrono::high_resolution_clock::now();
-            return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - prevTP).count();
+            return nanoseconds() / 1000000;
         }
 
         inline uint64_t seconds(){
-            auto now = std::chrono::high_resolution_clock::now();
-            return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(now - prevTP).count();
+            return nanoseconds() / 1000000000;
         }
 
     private:
-        std::chrono::high_resolution_clock::time_point prevTP;
+        uint64_t start;
 };
 
-#endif
\ No newline at end of file
+/**
+ * A deadline that comes back every interval and that any thread can poll, for work like printing a summary
+ * Only the poll that moves the deadline returns true, so one thread does the work when several find it due
+ * Reads CoarseClock, the deadline only needs millisecond precision
+ * */
+class PeriodicDeadline {
+    public:
+        PeriodicDeadline(uint64_t milliseconds) {
+            setInterval(milliseconds);
+        }
+
+        /**
+         * Sets the interval and the next deadline one interval from now, 0 to never be due
+         * */
+        void setInterval(uint64_t milliseconds) {
+            interval.store(milliseconds * 1000000, std::memory_order_relaxed);
+            next.store(milliseconds? now() + milliseconds * 1000000 : UINT64_MAX, std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns true if the deadline has passed and this call moved it to one interval from now
+         * */
+        bool poll() {
+            uint64_t deadline = next.load(std::memory_order_relaxed);
+            uint64_t current = now();
+            return current >= deadline && next.compare_exchange_strong(deadline, current + interval.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        /**
+         * Returns the next deadline in now() nanoseconds, UINT64_MAX when there is no interval
+         * */
+        uint64_t getNext() const {
+            return next.load(std::memory_order_relaxed);
+        }
+
+        static uint64_t now() {
+            return CoarseClock::toNanoseconds(CoarseClock::ticks());
+        }
+
+    private:
+        std::atomic<uint64_t> interval;
+        std::atomic<uint64_t> next;
+};
+
+typedef BasicTimer<SteadyClock> Timer;
+typedef BasicTimer<CoarseClock> CoarseTimer;
+typedef BasicTimer<TscClock> TscTimer;
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef INCLUDE_TRACEPOINTS_H
+#define INCLUDE_TRACEPOINTS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "DebugLogger.h"
+
+/**
+ * Traces a message that is off by default and can be turned on at runtime without a restart
+ * Each use creates a static TracepointSite. A disabled site costs one load and a predictable branch
+ * ```
+ * DEBUG_TRACEPOINT(logger, "parsed {int} headers in [sfl]:[sln]", count);
+ * ```
+ * */
+#define DEBUG_TRACEPOINT(logger, format, ...) \
+    do { \
+        static TracepointSite debugTracepointSite(__FILE__, __LINE__, __func__, format); \
+        if(debugTracepointSite.state.load(std::memory_order_relaxed) != TracepointSite::DISABLED && debugTracepointSite.isEnabled()) { \
+            (logger).traceSite(debugTracepointSite, format, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+/**
+ * A static descriptor of one DEBUG_TRACEPOINT call site
+ * The descriptor is constant initialized, it registers itself with Tracepoints the first time it is reached
+ * */
+struct TracepointSite : public CallSite {
+    static constexpr uint8_t UNREGISTERED = 0;
+    static constexpr uint8_t DISABLED = 1;
+    static constexpr uint8_t ENABLED = 2;
+
+    constexpr TracepointSite(const char* file, int line, const char* function, const char* format)
+        :CallSite(file, line, function, format),
+        state(UNREGISTERED),
+        next(nullptr)
+    {
+    }
+
+    /**
+     * Slow path of the macro, registers the site if this is the first time it is reached
+     * */
+    bool isEnabled();
+
+    std::atomic<uint8_t> state;
+
+    //the next registered site
+    TracepointSite* next;
+};
+
+/**
+ * Controls which tracepoints are enabled
+ * Rules are matched against every site in order and the last rule that matches decides, sites no rule matches are disabled
+ * Rule syntax, one per line or separated by commas:
+ *  file:<glob>      enables sites whose file matches the glob (* and ?). Globs without a '/' match the file name only
+ *  format:<text>    enables sites whose format contains the text
+ *  -file:<glob>     disables matching sites
+ *  -format:<text>   disables matching sites
+ *  *                enables every site
+ * The rules are read from the DEBUGLOGGER_TRACEPOINTS environment variable when the first site registers,
+ * and can be reloaded from a file with watchFile()
+ * @author Bryce Young
+ * */
+class Tracepoints {
+    public:
+        /**
+         * Enables the sites whose file matches @param glob
+         * */
+        static void enableFile(const std::string& glob) {
+            addRule(Rule{ Rule::FILE, glob, true });
+        }
+
+        /**
+         * Enables the sites whose format contains @param text
+         * */
+        static void enableFormat(const std::string& text) {
+            addRule(Rule{ Rule::FORMAT, text, true });
+        }
+
+        static void disableFile(const std::string& glob) {
+            addRule(Rule{ Rule::FILE, glob, false });
+        }
+
+        static void disableFormat(const std::string& text) {
+            addRule(Rule{ Rule::FORMAT, text, false });
+        }
+
+        /**
+         * Removes every rule, which disables every site
+         * */
+        static void disableAll() {
+            std::lock_guard<std::mutex> guard(instance().lock);
+            instance().rules.clear();
+            instance().applyRules();
+        }
+
+        /**
+         * Replaces every rule with the rules in @param text (see the class description for the syntax)
+         * */
+        static void setRules(const std::string& text) {
+            std::lock_guard<std::mutex> guard(instance().lock);
+            instance().rules = parseRules(text);
+            instance().applyRules();
+        }
+
+        /**
+         * Reloads the rules from @param path every time the file changes
+         * The file is checked every @param intervalMillis milliseconds on a background thread, by its size and modification time
+         * Calling it again replaces the watched file
+         * */
+        static void watchFile(const std::string& path, int intervalMillis = 1000) {
+            Tracepoints& tracepoints = instance();
+            tracepoints.stopWatching();
+
+            tracepoints.watching = true;
+            tracepoints.watcher = std::thread([path, intervalMillis, &tracepoints]() {
+                FileVersion last;
+
+                while(tracepoints.watching) {
+                    FileVersion version;
+
+                    if(readFileVersion(path, version) && version != last) {
+                        last = version;
+                        std::ifstream file(path);
+                        std::stringstream contents;
+                        contents << file.rdbuf();
+                        setRules(contents.str());
+                    }
+
+                    std::unique_lock<std::mutex> wait(tracepoints.watchLock);
+                    tracepoints.watchSignal.wait_for(wait, std::chrono::milliseconds(intervalMillis), [&tracepoints]() { return !tracepoints.watching; });
+                }
+            });
+        }
+
+        /**
+         * Returns the number of sites that have been reached so far
+         * */
+        static int getSiteCount() {
+            std::lock_guard<std::mutex> guard(instance().lock);
+            int count = 0;
+
+            for(TracepointSite* site = instance().sites; site; site = site->next) {
+                count++;
+            }
+
+            return count;
+        }
+
+        ~Tracepoints() {
+            stopWatching();
+        }
+
+    private:
+        friend struct TracepointSite;
+
+        struct Rule {
+            enum Kind {
+                FILE,
+                FORMAT
+            };
+
+            Kind kind;
+            std::string pattern;
+            bool enable;
+        };
+
+        Tracepoints() {
+            const char* environment = getenv("DEBUGLOGGER_TRACEPOINTS");
+
+            if(environment) {
+                rules = parseRules(environment);
+            }
+        }
+
+        static Tracepoints& instance() {
+            static Tracepoints tracepoints;
+            return tracepoints;
+        }
+
+        static void addRule(const Rule& rule) {
+            std::lock_guard<std::mutex> guard(instance().lock);
+            instance().rules.push_back(rule);
+            instance().applyRules();
+        }
+
+        /**
+         * Adds @param site to the list of sites and sets its state from the rules
+         * */
+        void registerSite(TracepointSite* site) {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if(site->state.load(std::memory_order_relaxed) == TracepointSite::UNREGISTERED) {
+                site->next = sites;
+                sites = site;
+                site->state.store(matches(site)? TracepointSite::ENABLED : TracepointSite::DISABLED, std::memory_order_relaxed);
+            }
+        }
+
+        void applyRules() {
+            for(TracepointSite* site = sites; site; site = site->next) {
+                site->state.store(matches(site)? TracepointSite::ENABLED : TracepointSite::DISABLED, std::memory_order_relaxed);
+            }
+        }
+
+        bool matches(const TracepointSite* site) const {
+            bool enabled = false;
+
+            for(const Rule& rule : rules) {
+                bool match = false;
+
+                if(rule.kind == Rule::FILE) {
+                    const char* file = site->file;
+
+                    //match only the file name if the glob doesn't have a directory
+                    if(rule.pattern.find('/') == std::string::npos) {
+                        for(const char* c = site->file; *c; ++c) {
+                            if(*c == '/' || *c == '\\') {
+                                file = c + 1;
+                            }
+                        }
+                    }
+
+                    match = globMatch(rule.pattern.c_str(), file);
+                }
+                else {
+                    match = site->format && strstr(site->format, rule.pattern.c_str()) != nullptr;
+                }
+
+                if(match) {
+                    enabled = rule.enable;
+                }
+            }
+
+            return enabled;
+        }
+
+        /**
+         * Matches @param text against @param pattern where * matches any run of characters and ? matches one character
+         * */
+        static bool globMatch(const char* pattern, const char* text) {
+            const char* starPattern = nullptr;
+            const char* starText = nullptr;
+
+            while(*text) {
+                if(*pattern == '*') {
+                    starPattern = ++pattern;
+                    starText = text;
+                }
+                else if(*pattern == '?' || *pattern == *text) {
+                    pattern++;
+                    text++;
+                }
+                else if(starPattern) {
+                    pattern = starPattern;
+                    text = ++starText;
+                }
+                else {
+                    return false;
+                }
+            }
+
+            while(*pattern == '*') {
+                pattern++;
+            }
+
+            return *pattern == 0;
+        }
+
+        static std::vector<Rule> parseRules(const std::string& text) {
+            std::vector<Rule> parsed;
+            size_t start = 0;
+
+            while(start <= text.size()) {
+                size_t end = text.find_first_of(",\n", start);
+                end = (end == std::string::npos)? text.size() : end;
+
+                std::string rule = text.substr(start, end - start);
+                size_t first = rule.find_first_not_of(" \t\r");
+                size_t last = rule.find_last_not_of(" \t\r");
+                rule = (first == std::string::npos)? "" : rule.substr(first, last - first + 1);
+
+                bool enable = true;
+                if(!rule.empty() && rule[0] == '-') {
+                    enable = false;
+                    rule = rule.substr(1);
+                }
+
+                if(rule == "*") {
+                    parsed.push_back(Rule{ Rule::FILE, "*", enable });
+                }
+                else if(rule.compare(0, 5, "file:") == 0) {
+                    parsed.push_back(Rule{ Rule::FILE, rule.substr(5), enable });
+                }
+                else if(rule.compare(0, 7, "format:") == 0) {
+                    parsed.push_back(Rule{ Rule::FORMAT, rule.substr(7), enable });
+                }
+
+                start = end + 1;
+            }
+
+            return parsed;
+        }
+
+        /**
+         * What watchFile() compares to spot a change. The modification time has nanoseconds where the platform keeps them,
+         * and the size catches a rewrite within the same timestamp tick on file systems with coarse times
+         * */
+        struct FileVersion {
+            long long size = -1;
+            long long seconds = -1;
+            long nanoseconds = -1;
+
+            bool operator!=(const FileVersion& other) const {
+                return size != other.size || seconds != other.seconds || nanoseconds != other.nanoseconds;
+            }
+        };
+
+        static bool readFileVersion(const std::string& path, FileVersion& version) {
+            struct stat info;
+
+            if(stat(path.c_str(), &info) != 0) {
+                return false;
+            }
+
+            version.size = (long long)info.st_size;
+            version.seconds = (long long)info.st_mtime;
+#if defined(__APPLE__)
+            version.nanoseconds = (long)info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+            //the CRT's stat only has whole seconds
+            version.nanoseconds = 0;
+#else
+            version.nanoseconds = (long)info.st_mtim.tv_nsec;
+#endif
+            return true;
+        }
+
+        void stopWatching() {
+            if(watcher.joinable()) {
+                {
+                    std::lock_guard<std::mutex> guard(watchLock);
+                    watching = false;
+                }
+
+                watchSignal.notify_all();
+                watcher.join();
+            }
+        }
+
+        //guards rules and the site list
+        std::mutex lock;
+        std::vector<Rule> rules;
+        TracepointSite* sites = nullptr;
+
+        //file watcher
+        std::thread watcher;
+        std::atomic<bool> watching{ false };
+        std::mutex watchLock;
+        std::condition_variable watchSignal;
+};
+
+inline bool TracepointSite::isEnabled() {
+    if(state.load(std::memory_order_relaxed) == UNREGISTERED) {
+        Tracepoints::instance().registerSite(this);
+    }
+
+    return state.load(std::memory_order_relaxed) == ENABLED;
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef INCLUDE_VARIABLEWATCH_H
+#define INCLUDE_VARIABLEWATCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+
+/**
+ * Prints a format of variables on a background thread every period, so hot loops only update the variables and never log
+ * ```
+ * std::atomic<int64_t> handled{ 0 };
+ * logger.addVariable("handled", &handled);
+ *
+ * VariableWatch watch(logger, "handled=[handled] queue=[metric.queue]", 1000);
+ * ```
+ * The watch prints through its own copy of the logger, made when it is created, so it has the logger's prefix, level and output
+ * but the logger itself is never touched from the background thread. The output must be one that can be shared between threads,
+ * like the sinks in this library.
+ * Only variables that can be read while other threads change them can be watched: atomics, SeqlockStrings, [metric.name] values,
+ * and the internal variables, which belong to the copy. The same goes for the variables in the logger's prefixes, which the copy prints too,
+ * except that [ctx.name] values there are the watch thread's own. The threads updating them pay nothing for the watch.
+ * Each period reads the watched variables once and prints the values it read, so with onlyChanges a line always shows the values that were compared
+ * The variables, the output and the logger's metrics must outlive the watch
+ * @author Bryce Young
+ * */
+class VariableWatch {
+    public:
+        /**
+         * Starts printing @param format every @param periodMillis milliseconds
+         * @param onlyChanges true to skip the periods in which no watched variable changed; internal variables don't count
+         * Check isValid(), the watch doesn't start if the format has arguments or a variable that can't be watched
+         * */
+        VariableWatch(const DebugLogger& logger, const std::string& format, uint64_t periodMillis, bool onlyChanges = false)
+            :logger(logger),
+            printer(logger),
+            snapshots(*this),
+            format(format),
+            period(periodMillis),
+            onlyChanges(onlyChanges)
+        {
+            start();
+        }
+
+        /**
+         * Watches the variables @param names, printed as name=[name] separated by spaces
+         * */
+        VariableWatch(const DebugLogger& logger, const std::vector<std::string>& names, uint64_t periodMillis, bool onlyChanges = false)
+            :logger(logger),
+            printer(logger),
+            snapshots(*this),
+            format(formatOf(names)),
+            period(periodMillis),
+            onlyChanges(onlyChanges)
+        {
+            start();
+        }
+
+        ~VariableWatch() {
+            stop();
+        }
+
+        VariableWatch(const VariableWatch&) = delete;
+        VariableWatch& operator=(const VariableWatch&) = delete;
+
+        /**
+         * Returns true if the watch is running, or ran until stop() was called
+         * */
+        bool isValid() const {
+            return rejected.empty() && period.count() > 0;
+        }
+
+        /**
+         * Returns the variable that kept the watch from starting, empty if none did
+         * */
+        const std::string& getRejected() const {
+            return rejected;
+        }
+
+        /**
+         * Stops the background thread, waiting for a snapshot being printed to finish
+         * */
+        void stop() {
+            if(worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    running = false;
+                }
+
+                signal.notify_all();
+                worker.join();
+            }
+        }
+
+        /**
+         * Returns the number of snapshots taken and how many of them were printed
+         * */
+        uint64_t getSnapshots() const {
+            return snapshotCount.load(std::memory_order_relaxed);
+        }
+
+        uint64_t getPrinted() const {
+            return printed.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /**
+         * A watched variable, with the values of the last period. The printer's variable of the same name points at last
+         * */
+        struct Watched {
+            std::string name;
+            VariableSnapshot current;
+            VariableSnapshot last;
+        };
+
+        /**
+         * The printer's [metric.name] values: the last period's for the watched ones, the logger's metrics for the rest
+         * */
+        class Snapshots : public MetricSource {
+            public:
+                Snapshots(VariableWatch& watch)
+                    :watch(watch)
+                {
+                }
+
+                DebugVarType getMetric(const char* name, size_t length, uint64_t& integer, double& number) override {
+                    for(Watched& variable : watch.watched) {
+                        if(variable.name.size() == length + 7 && variable.name.compare(0, 7, "metric.") == 0 && variable.name.compare(7, length, name, length) == 0) {
+                            integer = variable.last.integer;
+                            number = variable.last.number;
+                            return variable.last.type;
+                        }
+                    }
+
+                    MetricSource* source = watch.logger.getMetrics();
+                    return source? source->getMetric(name, length, integer, number) : DebugVarType::DEBUGVAR_TYPE_COUNT;
+                }
+
+            private:
+                VariableWatch& watch;
+        };
+
+        static std::string formatOf(const std::vector<std::string>& names) {
+            std::string text;
+
+            for(const std::string& name : names) {
+                text += (text.empty()? "" : " ") + name + "=[" + name + "]";
+            }
+
+            return text;
+        }
+
+        void start() {
+            //the message is printed without arguments
+            char type;
+
+            if(DebugLogger::getArgumentTypes(format.c_str(), &type, 1) > 0) {
+                rejected = format;
+                return;
+            }
+
+            VariableSnapshot ignored;
+
+            for(const std::string& name : logger.getVariableNames(format.c_str())) {
+                if(DebugLogger::isInternalVariable(name)) {
+                    continue;
+                }
+
+                Watched variable;
+                variable.name = name;
+
+                if(!logger.snapshotVariable(name, variable.last)) {
+                    rejected = name;
+                    return;
+                }
+
+                watched.push_back(variable);
+            }
+
+            //the copy prints its prefix with every snapshot, so its variables are read from the watch thread as well
+            for(int level = (int)Level::LEVEL_TRACE; level < (int)Level::LEVEL_COUNT; ++level) {
+                for(const std::string& name : logger.getVariableNames(logger.getPrefix((Level)level))) {
+                    if(DebugLogger::isInternalVariable(name) || name.compare(0, 4, "ctx.") == 0) {
+                        continue;
+                    }
+
+                    if(!logger.snapshotVariable(name, ignored)) {
+                        rejected = name;
+                        return;
+                    }
+                }
+            }
+
+            //the printer prints the values the watch read, the snapshots don't move once watched is complete
+            for(Watched& variable : watched) {
+                if(variable.name.compare(0, 7, "metric.") != 0) {
+                    printer.removeVariable(variable.name);
+                    printer.addVariable(variable.name, variable.last.value(), variable.last.type);
+                }
+            }
+
+            if(logger.getMetrics()) {
+                printer.setMetrics(&snapshots);
+            }
+
+            if(period.count() > 0) {
+                running = true;
+                worker = std::thread(&VariableWatch::run, this);
+            }
+        }
+
+        void run() {
+            bool first = true;
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(running) {
+                //a fixed schedule, so the time spent printing doesn't add up into drift, but no burst to catch up after a stall
+                next = std::max(next + period, std::chrono::steady_clock::now());
+
+                if(!signal.wait_until(guard, next, [this]() { return !running; })) {
+                    guard.unlock();
+                    bool changed = false;
+
+                    //swapped, so last keeps its address and the printer reads what was just compared
+                    for(Watched& variable : watched) {
+                        logger.snapshotVariable(variable.name, variable.current);
+                        changed = changed || variable.current != variable.last;
+                        std::swap(variable.current, variable.last);
+                    }
+
+                    snapshotCount.fetch_add(1, std::memory_order_relaxed);
+
+                    if(!onlyChanges || first || changed) {
+                        printer.trace(format.c_str());
+                        printed.fetch_add(1, std::memory_order_relaxed);
+                    }
+
+                    first = false;
+                    guard.lock();
+                }
+            }
+        }
+
+        //only used by the background thread once it has started: the variables are read through logger and printed by printer
+        DebugLogger logger;
+        DebugLogger printer;
+        Snapshots snapshots;
+        std::string format;
+        std::vector<Watched> watched;
+        std::chrono::milliseconds period;
+        bool onlyChanges;
+        std::string rejected;
+
+        std::atomic<uint64_t> snapshotCount{ 0 };
+        std::atomic<uint64_t> printed{ 0 };
+
+        std::thread worker;
+        bool running = false;
+        std::mutex lock;
+        std::condition_variable signal;
+};
+
+#endif
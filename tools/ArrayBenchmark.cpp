@@ -0,0 +1,131 @@
+#include <chrono>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures printing an array of {.2f}, {f} and {d} elements as one array argument against a trace call per element,
+ * written through a FileSink, then checks that the array prints every element as its own call would
+ * Returns 1 if an array prints differently
+ * ```
+ * ArrayBenchmark [elements] [output file]
+ * ```
+ * The output defaults to /dev/null, so the numbers are what logging costs the program rather than the disk
+ * */
+
+//"{.2f}" -> "{.2f[]}"
+static std::string arrayOf(const char* format) {
+    return std::string(format, strlen(format) - 1) + "[]}";
+}
+
+/**
+ * Prints @param count elements of @param values one call each and as one array through @param format, "{.2f}" for example,
+ * returns true if the array printed the same elements
+ * */
+template<typename T>
+static bool printsSame(const char* format, const T* values, size_t count) {
+    std::ostringstream single;
+    std::ostringstream array;
+    std::string arrayFormat = arrayOf(format);
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setPrefix("");
+    logger.setTargetOutput(&single);
+
+    for(size_t i = 0; i < count; ++i) {
+        logger.trace(format, values[i]);
+    }
+
+    logger.setTargetOutput(&array);
+    logger.trace(arrayFormat.c_str(), values, count);
+
+    //the single calls print a line each, the array separates the same text with ", "
+    std::string expected = single.str();
+    std::string::size_type newline;
+
+    while((newline = expected.find('\n')) != std::string::npos && newline + 1 < expected.size()) {
+        expected.replace(newline, 1, ", ");
+    }
+
+    if(expected != array.str()) {
+        printf("%s prints differently as an array\n", arrayFormat.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Prints @param values through @param logger with a call per element of @param format and as one array, prints the ms of each
+ * */
+template<typename T>
+static void measure(DebugLogger& logger, FileSink& file, const char* format, const std::vector<T>& values) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < values.size(); ++i) {
+        logger.trace(format, values[i]);
+    }
+
+    file.flush();
+    double single = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    logger.trace(arrayOf(format).c_str(), values.data(), values.size());
+    file.flush();
+    double array = secondsSince(start);
+
+    printf("%-8s %14.1f %10.1f %8.1fx\n", format, single * 1e3, array * 1e3, single / array);
+}
+
+int main(int argc, char** argv) {
+    size_t elements = argc > 1? (size_t)atoll(argv[1]) : 1000000;
+    const char* path = argc > 2? argv[2] : "/dev/null";
+    bool matches = true;
+
+    FileSink file(path, 1 << 20);
+
+    if(!file.isOpen()) {
+        fprintf(stderr, "can't open %s\n", path);
+        return 1;
+    }
+
+    //samples over several magnitudes and with both signs. f elements are floats, see the README
+    std::vector<float> floats(elements);
+    std::vector<int> ints(elements);
+    srand(7);
+
+    for(size_t i = 0; i < elements; ++i) {
+        double magnitude = (double)(rand() % 8 - 2);
+        floats[i] = (float)(((double)rand() / RAND_MAX - .3) * pow(10.0, magnitude));
+        ints[i] = (int)(rand() - RAND_MAX / 2);
+    }
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    //once to size the buffers
+    logger.trace("{.2f[]}", floats.data(), elements);
+
+    printf("%zu elements, ms\n", elements);
+    printf("%-8s %14s %10s %9s\n", "format", "trace/element", "array", "speedup");
+    measure(logger, file, "{.2f}", floats);
+    measure(logger, file, "{f}", floats);
+    measure(logger, file, "{d}", ints);
+
+    size_t checked = std::min(elements, (size_t)100000);
+    matches = printsSame("{.2f}", floats.data(), checked) && matches;
+    matches = printsSame("{f}", floats.data(), checked) && matches;
+    matches = printsSame("{d}", ints.data(), checked) && matches;
+
+    return matches? 0 : 1;
+}
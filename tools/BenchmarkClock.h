@@ -0,0 +1,13 @@
+#ifndef TOOLS_BENCHMARK_CLOCK_H
+#define TOOLS_BENCHMARK_CLOCK_H
+
+#include <chrono>
+
+/**
+ * Returns the seconds since @param start, for the tools that time themselves
+ * */
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
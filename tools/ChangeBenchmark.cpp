@@ -0,0 +1,119 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "LogOnChange.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures a state machine loop that traces its state every iteration, with a plain trace call and with DEBUG_TRACE_CHANGED,
+ * then has 4 threads share one site to check that each change is printed once, and changes an array in place to check
+ * that its elements are compared rather than its address
+ * Returns 1 if a change is missed or printed more than once
+ * ```
+ * ChangeBenchmark [iterations]
+ * ```
+ * */
+
+static const char* STATES[] = { "idle", "connecting", "handshake", "open", "closing" };
+
+/**
+ * Traces the state of a machine that moves on every 1000 iterations, @return the ns per iteration
+ * */
+static double runMachine(DebugLogger& logger, int iterations, bool onChange) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < iterations; ++i) {
+        const char* st = STATES[(i / 1000) % 5];
+        int retries = (i / 5000) % 3;
+
+        if(onChange) {
+            DEBUG_TRACE_CHANGED(logger, "state={str} retries={int} mode=[mode]", st, retries);
+        }
+        else {
+            logger.trace("state={str} retries={int} mode=[mode]", st, retries);
+        }
+    }
+
+    return secondsSince(start) * 1e9 / iterations;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1? atoi(argv[1]) : 2000000;
+    bool matches = true;
+    const char* mode = "active";
+
+    FileSink file("/tmp/ChangeBenchmark.log");
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+    logger.addVariable("mode", &mode);
+
+    printf("%d iterations, the state changes every 1000\n", iterations);
+
+    uint64_t before = file.getBytes();
+    double plainNs = runMachine(logger, iterations, false);
+    uint64_t plainBytes = file.getBytes() - before;
+
+    before = file.getBytes();
+    double changedNs = runMachine(logger, iterations, true);
+    uint64_t changedBytes = file.getBytes() - before;
+
+    printf("trace every iteration  %7.1f ns/iteration  %10llu bytes\n", plainNs, (unsigned long long)plainBytes);
+    printf("DEBUG_TRACE_CHANGED    %7.1f ns/iteration  %10llu bytes\n", changedNs, (unsigned long long)changedBytes);
+
+    //threads share the site, each with its own logger, and step through the same states together
+    static ChangeSite shared(__FILE__, __LINE__, __func__, "state={str}");
+    std::atomic<int> step{ 0 };
+    std::atomic<int> printed{ 0 };
+    std::vector<std::thread> threads;
+    const int steps = 200;
+    const int threadCount = 4;
+    std::vector<DebugLogger> loggers(threadCount, logger);
+
+    for(int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for(int s = 0; s < steps; ++s) {
+                //everyone traces the step several times, then waits for the others
+                for(int i = 0; i < 50; ++i) {
+                    if(shared.trace(loggers[t], STATES[s % 5]) > 0) {
+                        printed.fetch_add(1);
+                    }
+                }
+
+                step.fetch_add(1);
+
+                while(step.load() < (s + 1) * threadCount) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    printf("%d threads sharing a site: %d changes printed %d times\n", threadCount, steps, printed.load());
+    matches = printed.load() == steps;
+
+    //the same buffer with new contents, and the same text in another buffer
+    static ChangeSite arraySite(__FILE__, __LINE__, __func__, "window={int[]} body={strn}");
+    std::vector<int> window = { 1, 2, 3 };
+    std::string body = "ping";
+    std::string copy = body;
+    bool first = arraySite.trace(logger, window.data(), window.size(), body.data(), body.size()) > 0;
+    window[1] = 5;
+    bool changed = arraySite.trace(logger, window.data(), window.size(), body.data(), body.size()) > 0;
+    bool moved = arraySite.trace(logger, window.data(), window.size(), copy.data(), copy.size()) > 0;
+    printf("arrays: first %s, changed element %s, same text elsewhere %s\n", first? "printed" : "skipped", changed? "printed" : "skipped", moved? "printed" : "skipped");
+    matches = matches && first && changed && !moved;
+
+    file.flush();
+    remove("/tmp/ChangeBenchmark.log");
+    return matches? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "CompressedSink.h"
+#include "DebugLogger.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures LogCompression on the output of a logger using the default prefix:
+ * the compression ratio and speed for a few block sizes, then the cost of logging through a CompressedSink
+ * compared with an uncompressed file
+ * Returns 1 if anything fails to decompress to the original text
+ * ```
+ * CompressionBenchmark [messages] [directory]
+ * ```
+ * */
+
+/**
+ * A mix of the messages a traced service prints
+ * */
+static void logMessages(DebugLogger& logger, int count) {
+    static const char* users[] = { "alice", "bob", "carol", "dave", "erin" };
+    static const char* paths[] = { "/api/v1/orders", "/api/v1/users", "/static/app.js", "/health" };
+
+    for(int i = 0; i < count; ++i) {
+        switch(i % 4) {
+            case 0:
+                logger.trace("request {int} GET {str} user={str} status={int} took {.3f}ms", i, paths[i % 4], users[i % 5], (i % 50)? 200 : 404, (i % 997) * 0.0137);
+                break;
+            case 1:
+                logger.trace("db.query rows={int} table=orders shard={int} cache={str}", (i * 7) % 1000, i % 16, (i % 3)? "hit" : "miss");
+                break;
+            case 2:
+                logger.trace("queue depth {int}, worker {int} picked job {0x ulong}", (i / 3) % 40, i % 8, (unsigned long long)i * 2654435761ull);
+                break;
+            default:
+                logger.trace("response {int} sent {int} bytes", i - 3, 512 + (i % 4096));
+                break;
+        }
+    }
+}
+
+static bool measureBlocks(const std::string& text, size_t blockSize) {
+    std::vector<char> encoded;
+    encoded.reserve(text.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(size_t offset = 0; offset < text.size(); offset += blockSize) {
+        size_t length = (text.size() - offset < blockSize)? text.size() - offset : blockSize;
+        LogCompression::encodeBlock(text.data() + offset, length, encoded);
+    }
+
+    double compressSeconds = secondsSince(start);
+    std::string decoded(blockSize, 0);
+    size_t position = 0;
+    size_t offset = 0;
+    bool matches = true;
+    start = std::chrono::steady_clock::now();
+
+    while(position < encoded.size()) {
+        LogCompression::BlockHeader header;
+        LogCompression::readBlockHeader(&encoded[position], header);
+        position += LogCompression::BLOCK_HEADER_SIZE;
+
+        if(header.compressed) {
+            matches = LogCompression::decompressBlock(&encoded[position], header.storedSize, &decoded[0], header.rawSize) && matches;
+        }
+        else {
+            memcpy(&decoded[0], &encoded[position], header.rawSize);
+        }
+
+        matches = matches && text.compare(offset, header.rawSize, decoded.data(), header.rawSize) == 0;
+        position += header.storedSize;
+        offset += header.rawSize;
+    }
+
+    double decompressSeconds = secondsSince(start);
+    double megabytes = text.size() / 1e6;
+
+    printf("%7zuKB blocks  ratio %6.2f  compress %7.1f MB/s  decompress %7.1f MB/s%s\n", blockSize / 1024,
+        (double)text.size() / encoded.size(), megabytes / compressSeconds, megabytes / decompressSeconds, matches? "" : "  MISMATCH");
+
+    return matches && offset == text.size();
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1? atoi(argv[1]) : 1000000;
+    std::string directory = argc > 2? argv[2] : ".";
+    std::string compressedPath = directory + "/CompressionBenchmark.dlz";
+    std::string plainPath = directory + "/CompressionBenchmark.log";
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    std::stringstream rendered;
+    logger.setTargetOutput(&rendered);
+    logMessages(logger, count);
+
+    std::string text = rendered.str();
+    printf("%d messages, %.1f MB of text with the default prefix, for example:\n%s", count, text.size() / 1e6, text.substr(0, text.find('\n', 300) + 1).c_str());
+
+    bool passed = true;
+
+    for(size_t blockSize : { (size_t)16384, (size_t)65536, (size_t)262144, (size_t)1048576 }) {
+        passed = measureBlocks(text, blockSize) && passed;
+    }
+
+    //the same messages logged straight to a file and through a CompressedSink
+    double plainSeconds;
+    {
+        std::ofstream plain(plainPath, std::ios::binary);
+        logger.setTargetOutput(&plain);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        logMessages(logger, count);
+        plain.flush();
+        plainSeconds = secondsSince(start);
+    }
+
+    double loggingSeconds, drainedSeconds;
+    uint64_t rawBytes, compressedBytes;
+    {
+        CompressedSink sink(compressedPath.c_str());
+        logger.setTargetOutput(&sink);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        logMessages(logger, count);
+        loggingSeconds = secondsSince(start);
+        sink.drain();
+        drainedSeconds = secondsSince(start);
+        rawBytes = sink.getRawBytes();
+        compressedBytes = sink.getCompressedBytes();
+        logger.setTargetOutput(&std::cout);
+    }
+
+    printf("plain file:      %7.1f ns/message, %.1f MB written\n", plainSeconds * 1e9 / count, rawBytes / 1e6);
+    printf("CompressedSink:  %7.1f ns/message on the logging thread, %.1f ns/message until written, %.1f MB written (ratio %.2f)\n",
+        loggingSeconds * 1e9 / count, drainedSeconds * 1e9 / count, compressedBytes / 1e6, (double)rawBytes / compressedBytes);
+
+    //the file must read back to as many bytes as were logged
+    FILE* file = fopen(compressedPath.c_str(), "rb");
+    uint64_t readBack = 0;
+
+    if(file) {
+        LogCompression::Reader reader(file);
+        std::string block;
+
+        while(reader.next(block) == LogCompression::Reader::BLOCK) {
+            readBack += block.size();
+        }
+
+        fclose(file);
+    }
+
+    if(readBack != rawBytes) {
+        printf("read back %llu of %llu bytes\n", (unsigned long long)readBack, (unsigned long long)rawBytes);
+        passed = false;
+    }
+
+    remove(compressedPath.c_str());
+    remove(plainPath.c_str());
+    return passed? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DebugLogger.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures constructing and destroying a DebugLogger, counting the heap allocations it makes,
+ * then the same for a logger with a prefix and a variable, which are the first things that allocate
+ * Returns 1 if a default logger allocates or is larger than its 512 byte budget
+ * ```
+ * ConstructionBenchmark [loggers]
+ * ```
+ * */
+
+//loggers are created per function and per connection, so keep an eye on how big they get
+static const size_t SIZE_BUDGET = 512;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* memory = malloc(size? size : 1);
+
+    if(!memory) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+/**
+ * Constructs and destroys @param loggers loggers set up by @param setup, prints the ns and allocations per logger
+ * @return the allocations per logger
+ * */
+template<typename Setup>
+static double measure(const char* name, int loggers, Setup setup) {
+    int value = 0;
+    size_t before = allocations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < loggers; ++i) {
+        DebugLogger* logger = new DebugLogger();
+        setup(*logger, value);
+        delete logger;
+    }
+
+    double nanoseconds = secondsSince(start) * 1e9 / loggers;
+    //the new of the logger itself isn't its own
+    double perLogger = (double)(allocations - before - loggers) / loggers;
+    printf("%-28s %10.1f %12.1f\n", name, nanoseconds, perLogger);
+    return perLogger;
+}
+
+int main(int argc, char** argv) {
+    int loggers = argc > 1? atoi(argv[1]) : 200000;
+    bool matches = true;
+
+    printf("%d loggers, sizeof(DebugLogger) = %zu bytes\n", loggers, sizeof(DebugLogger));
+    printf("%-28s %10s %12s\n", "logger", "ns/logger", "allocations");
+
+    double defaults = measure("default", loggers, [](DebugLogger&, int&) {});
+    measure("setPrefix", loggers, [](DebugLogger& logger, int&) { logger.setPrefix("[ln] [dmc]: "); });
+    measure("setPrefix + addVariable", loggers, [](DebugLogger& logger, int& value) {
+        logger.setPrefix("[ln] [dmc]: ");
+        logger.addVariable("value", &value);
+    });
+
+    if(defaults != 0) {
+        printf("a default logger allocates %.1f times\n", defaults);
+        matches = false;
+    }
+
+    if(sizeof(DebugLogger) > SIZE_BUDGET) {
+        printf("a logger is %zu bytes, over %zu\n", sizeof(DebugLogger), SIZE_BUDGET);
+        matches = false;
+    }
+
+    return matches? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures tagging each request's messages with its id, user and a number: three ScopedContext values printed through
+ * [ctx.name] against three variables added with addVariable and removed after the request, next to a message without
+ * either and the push and pop alone, then checks that both ways print the same line
+ * Returns 1 if they don't
+ * ```
+ * ContextBenchmark [requests]
+ * ```
+ * Messages are written to /dev/null through a FileSink
+ * */
+
+static const int ROUNDS = 5;
+
+/**
+ * Returns the ns per request of the fastest of ROUNDS rounds of @param requests / ROUNDS runs of @param request
+ * */
+template<typename Request>
+static double measure(int requests, FileSink& file, Request request) {
+    int perRound = requests / ROUNDS;
+    double fastest = 0;
+
+    //once to size the buffers
+    request(0);
+
+    for(int round = 0; round < ROUNDS; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < perRound; ++i) {
+            request(i);
+        }
+
+        file.flush();
+        double nanoseconds = secondsSince(start) * 1e9 / perRound;
+        fastest = (round == 0 || nanoseconds < fastest)? nanoseconds : fastest;
+    }
+
+    return fastest;
+}
+
+static const char* users[] = { "alice", "bob", "carol", "dave", "erin" };
+
+/**
+ * Logs request @param i with its values pushed as context
+ * */
+static void contextRequest(DebugLogger& logger, int i) {
+    ScopedContext request("request", i);
+    ScopedContext user("user", users[i % 5]);
+    ScopedContext weight("weight", i * .25);
+    logger.trace("{int} done", i);
+}
+
+/**
+ * Logs request @param i with its values added as variables for the length of the request
+ * */
+static void variableRequest(DebugLogger& logger, int i) {
+    int request = i;
+    std::string user = users[i % 5];
+    double weight = i * .25;
+    logger.addVariable("request", &request);
+    logger.addVariable("user", &user);
+    logger.addVariable("weight", &weight);
+    logger.trace("{int} done", i);
+    logger.removeVariable("request");
+    logger.removeVariable("user");
+    logger.removeVariable("weight");
+}
+
+int main(int argc, char** argv) {
+    int requests = argc > 1? atoi(argv[1]) : 2000000;
+    bool matches = true;
+
+    FileSink file("/dev/null", 1 << 20);
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    static const char* contextPrefix = "[ctx.request] [ctx.user] [ctx.weight]: ";
+    static const char* variablePrefix = "[request] [user] [weight]: ";
+
+    logger.setPrefix("");
+    double plain = measure(requests, file, [&](int i) { logger.trace("{int} done", i); });
+
+    logger.setPrefix(contextPrefix);
+    double context = measure(requests, file, [&](int i) { contextRequest(logger, i); });
+
+    logger.setPrefix(variablePrefix);
+    double variables = measure(requests, file, [&](int i) { variableRequest(logger, i); });
+
+    double pushPop = measure(requests, file, [&](int i) {
+        ScopedContext request("request", i);
+        ScopedContext user("user", users[i % 5]);
+        ScopedContext weight("weight", i * .25);
+    });
+
+    printf("%d requests, ns per request, fastest of %d rounds\n", requests, ROUNDS);
+    printf("%-44s %10.1f\n", "\"{int} done\" without a prefix", plain);
+    printf("%-44s %10.1f\n", "3 ScopedContext, [ctx.*] x3", context);
+    printf("%-44s %10.1f\n", "3 addVariable, [var] x3, 3 removeVariable", variables);
+    printf("%-44s %10.1f\n", "3 ScopedContext pushed and popped", pushPop);
+
+    std::ostringstream contextOutput;
+    std::ostringstream variableOutput;
+    logger.setTargetOutput(&contextOutput);
+    logger.setPrefix(contextPrefix);
+
+    for(int i = 0; i < 1000; ++i) {
+        contextRequest(logger, i * 7919);
+    }
+
+    logger.setTargetOutput(&variableOutput);
+    logger.setPrefix(variablePrefix);
+
+    for(int i = 0; i < 1000; ++i) {
+        variableRequest(logger, i * 7919);
+    }
+
+    if(contextOutput.str() != variableOutput.str()) {
+        printf("context and variables print differently:\n%s%s", contextOutput.str().substr(0, 200).c_str(), variableOutput.str().substr(0, 200).c_str());
+        matches = false;
+    }
+
+    return matches? 0 : 1;
+}
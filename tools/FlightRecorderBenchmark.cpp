@@ -0,0 +1,103 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DebugLogger.h"
+#include "FlightRecorder.h"
+#include "Timer.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures what a FlightRecorder adds to a log call whose level is filtered out, which is what an always on recorder
+ * costs the calls that would not have printed anything, for a call without arguments, with numbers and with a string
+ * Returns 1 if recording a call with numbers costs more than the budget, 50ns by default
+ * ```
+ * FlightRecorderBenchmark [calls] [budget ns]
+ * ```
+ * The budget is for an optimized build, and includes the clock read of each record, which is printed on its own for reference
+ * */
+
+static const int ROUNDS = 5;
+static const int WARMUP_CALLS = 100000;
+
+/**
+ * Returns the ns per call of the fastest of ROUNDS rounds of @param calls / ROUNDS runs of @param call,
+ * so an interruption of the machine doesn't count against the recorder
+ * */
+template<typename Call>
+static double measure(int calls, Call call) {
+    //a few laps of the ring first, so its pages are mapped and cached like they are in a program that has been running
+    for(int i = 0; i < WARMUP_CALLS; ++i) {
+        call(i);
+    }
+
+    int perRound = calls / ROUNDS;
+    double fastest = 0;
+
+    for(int round = 0; round < ROUNDS; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < perRound; ++i) {
+            call(i);
+        }
+
+        double nanoseconds = secondsSince(start) * 1e9 / perRound;
+        fastest = (round == 0 || nanoseconds < fastest)? nanoseconds : fastest;
+    }
+
+    return fastest;
+}
+
+int main(int argc, char** argv) {
+    int calls = argc > 1? atoi(argv[1]) : 20000000;
+    double budget = argc > 2? atof(argv[2]) : 50;
+    const char* peer = "10.0.0.12:443";
+
+    DebugLogger logger;
+    //every trace call is filtered, so only the recorder does any work
+    logger.setLevel(Level::LEVEL_ERROR);
+
+    FlightRecorder recorder(8192);
+    double plain[3];
+    double recorded[3];
+
+    for(int pass = 0; pass < 2; ++pass) {
+        double* results = pass? recorded : plain;
+
+        if(pass) {
+            logger.setRecorder(&recorder);
+        }
+
+        results[0] = measure(calls, [&](int) { logger.trace("tick"); });
+        results[1] = measure(calls, [&](int i) { logger.trace("request {int} took {f} ms", i, i * .5); });
+        results[2] = measure(calls, [&](int i) { logger.trace("request {int} from {str}", i, peer); });
+    }
+
+    uint64_t ticks = 0;
+    double clockRead = measure(calls, [&](int) { ticks += TscClock::ticks(); });
+
+    printf("%d calls, ns per call, fastest of %d rounds\n", calls, ROUNDS);
+    printf("%-26s %10s %10s %10s\n", "call", "filtered", "recorded", "record");
+    static const char* names[] = { "no arguments", "{int} {f}", "{int} {str}" };
+
+    for(int i = 0; i < 3; ++i) {
+        printf("%-26s %10.1f %10.1f %10.1f\n", names[i], plain[i], recorded[i], recorded[i] - plain[i]);
+    }
+
+    printf("the clock read in each record: %.1f ns (%s)\n", clockRead, TscClock::isInvariant()? "TSC" : "steady_clock");
+
+    //the count includes the slots claimed and not used yet
+    uint64_t made = ((uint64_t)WARMUP_CALLS + calls / ROUNDS * ROUNDS) * 3;
+
+    if(recorder.getRecordCount() < made || ticks == 0) {
+        printf("recorded %llu calls, made %llu\n", (unsigned long long)recorder.getRecordCount(), (unsigned long long)made);
+        return 1;
+    }
+
+    if(recorded[1] - plain[1] > budget) {
+        printf("recording {int} {f} costs %.1f ns, over the %.0f ns budget\n", recorded[1] - plain[1], budget);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/wait.h>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "LogCompression.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Generates a log with the default prefix and compares the GB/s of LogGrep with grep on the same searches:
+ * a substring, a level, a message number and a substring on one level, then checks that both selected the same lines
+ * Returns 1 if the outputs differ or a command fails
+ * ```
+ * GrepBenchmark [megabytes] [directory]
+ * ```
+ * LogGrep is run from the directory GrepBenchmark is in. Run it twice, the first run also reads the log into the page cache
+ * */
+
+static const int ROUNDS = 3;
+
+/**
+ * Runs @param command ROUNDS times and returns the seconds of the fastest run, or 0 if the command failed
+ * grep and LogGrep exit with 1 when nothing matched, which counts as success
+ * */
+static double timeCommand(const std::string& command) {
+    double fastest = 0;
+
+    for(int round = 0; round < ROUNDS; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int status = system(command.c_str());
+        double seconds = secondsSince(start);
+
+        if(status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) > 1) {
+            printf("%s failed\n", command.c_str());
+            return 0;
+        }
+
+        fastest = (round == 0 || seconds < fastest)? seconds : fastest;
+    }
+
+    return fastest;
+}
+
+static std::string readFile(const std::string& path) {
+    std::string text;
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if(!file) {
+        return text;
+    }
+
+    char buffer[65536];
+    size_t count;
+
+    while((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, count);
+    }
+
+    fclose(file);
+    return text;
+}
+
+/**
+ * Writes about @param megabytes MB of service-like messages, one line each, with timeouts on some of the errors
+ * */
+static void writeLog(const std::string& path, size_t megabytes) {
+    static const char* users[] = { "alice", "bob", "carol", "dave", "erin" };
+    static const char* paths[] = { "/api/v1/orders", "/api/v1/users", "/static/app.js", "/health" };
+
+    FileSink file(path.c_str(), 1 << 20);
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    //lines are about 80 characters
+    int messages = (int)((megabytes << 20) / 80);
+
+    for(int i = 0; i < messages; ++i) {
+        if(i % 97 == 0) {
+            logger.error("request {int} to {str} failed: upstream timeout after {int} ms", i, paths[i % 4], 3000);
+        }
+        else if(i % 13 == 0) {
+            logger.warning("request {int} retried, attempt {int}", i, i % 3 + 1);
+        }
+        else {
+            logger.trace("request {int} GET {str} user={str} status={int} took {.3f}ms", i, paths[i % 4], users[i % 5], 200, (i % 1000) * .013);
+        }
+    }
+
+    file.flush();
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1? (size_t)atoll(argv[1]) : 512;
+    std::string directory = argc > 2? argv[2] : ".";
+    std::string program = argv[0];
+    std::string logGrep = program.substr(0, program.find_last_of('/') + 1) + "LogGrep";
+    std::string logPath = directory + "/GrepBenchmark.log";
+    std::string grepOutput = directory + "/GrepBenchmark.grep";
+    std::string logGrepOutput = directory + "/GrepBenchmark.loggrep";
+    bool matches = true;
+
+    writeLog(logPath, megabytes);
+    FILE* log = fopen(logPath.c_str(), "rb");
+
+    if(!log) {
+        printf("can't write %s\n", logPath.c_str());
+        return 1;
+    }
+
+    LogCompression::seekFile(log, 0, SEEK_END);
+    double gigabytes = LogCompression::tellFile(log) / 1e9;
+    fclose(log);
+
+    //the same lines selected both ways, grep on the raw text and LogGrep on the prefix fields
+    static const char* searches[][2] = {
+        { "grep -F timeout", "-s timeout" },
+        { "grep ^ERR~", "-l ERR" },
+        { "grep -F '[12345]'", "-n 12345-12345" },
+        { "grep '^ERR.*timeout'", "-l ERR -s timeout" },
+        { "grep -F user=erin", "-s user=erin" }
+    };
+
+    printf("%.2f GB log, GB/s, fastest of %d runs\n", gigabytes, ROUNDS);
+    printf("%-24s %8s   %-24s %8s\n", "grep", "GB/s", "LogGrep", "GB/s");
+
+    for(const auto& search : searches) {
+        double grepSeconds = timeCommand(std::string(search[0]) + " " + logPath + " > " + grepOutput);
+        double logGrepSeconds = timeCommand(logGrep + " " + search[1] + " " + logPath + " > " + logGrepOutput);
+
+        if(grepSeconds == 0 || logGrepSeconds == 0) {
+            matches = false;
+            continue;
+        }
+
+        bool same = readFile(grepOutput) == readFile(logGrepOutput);
+        printf("%-24s %8.2f   %-24s %8.2f%s\n", search[0], gigabytes / grepSeconds, search[1], gigabytes / logGrepSeconds, same? "" : "  DIFFERENT OUTPUT");
+        matches = matches && same;
+    }
+
+    remove(logPath.c_str());
+    remove(grepOutput.c_str());
+    remove(logGrepOutput.c_str());
+    return matches? 0 : 1;
+}
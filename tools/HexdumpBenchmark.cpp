@@ -0,0 +1,149 @@
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures the throughput of hexdumps of a buffer: the kernel alone (DebugLogger::printHexdump), an xxd-style loop
+ * of snprintf calls and trace("{hexdump}") through a FileSink, then checks the hexdump against the snprintf loop
+ * for every length up to 4KB and the whole buffer
+ * Returns 1 if they differ
+ * ```
+ * HexdumpBenchmark [buffer bytes] [output file]
+ * ```
+ * The output defaults to /dev/null, so the numbers are what logging costs the program rather than the disk
+ * */
+
+static const int ROUNDS = 5;
+
+/**
+ * Returns the MB/s of the fastest of ROUNDS runs of @param dump over @param length bytes
+ * */
+template<typename Dump>
+static double measure(size_t length, Dump dump) {
+    double fastest = 0;
+
+    for(int round = 0; round < ROUNDS; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        dump();
+        double seconds = secondsSince(start);
+        fastest = (round == 0 || seconds < fastest)? seconds : fastest;
+    }
+
+    return length / fastest / 1e6;
+}
+
+/**
+ * The layout of hexdump -C, one snprintf per field, 16 bytes per line
+ * */
+static std::string reference(const unsigned char* data, size_t length) {
+    std::string text;
+    char field[32];
+
+    for(size_t offset = 0; offset < length; offset += 16) {
+        size_t count = std::min((size_t)16, length - offset);
+        snprintf(field, sizeof(field), "\n%08zx  ", offset);
+        text += field;
+
+        for(size_t i = 0; i < 16; ++i) {
+            if(i < count) {
+                snprintf(field, sizeof(field), "%02x ", data[offset + i]);
+                text += field;
+            }
+            else {
+                text += "   ";
+            }
+
+            if(i == 7) {
+                text += " ";
+            }
+        }
+
+        text += " |";
+
+        for(size_t i = 0; i < count; ++i) {
+            unsigned char byte = data[offset + i];
+            text += (byte >= 0x20 && byte < 0x7F)? (char)byte : '.';
+        }
+
+        text += "|";
+    }
+
+    return text;
+}
+
+static std::string printed(const unsigned char* data, size_t length) {
+    std::ostringstream output;
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setPrefix("");
+    logger.setTargetOutput(&output);
+    logger.trace("{hexdump}", data, length);
+    return output.str();
+}
+
+int main(int argc, char** argv) {
+    size_t length = argc > 1? (size_t)atoll(argv[1]) : 1 << 20;
+    const char* path = argc > 2? argv[2] : "/dev/null";
+    bool matches = true;
+
+    FileSink file(path, 1 << 20);
+
+    if(!file.isOpen()) {
+        fprintf(stderr, "can't open %s\n", path);
+        return 1;
+    }
+
+    std::vector<unsigned char> buffer(length);
+    srand(7);
+
+    for(size_t i = 0; i < length; ++i) {
+        buffer[i] = (unsigned char)rand();
+    }
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    size_t checksum = 0;
+    std::ostringstream kernelOutput;
+
+    double kernel = measure(length, [&]() {
+        kernelOutput.str("");
+        DebugLogger::printHexdump(kernelOutput, buffer.data(), length, 16, false);
+        checksum += kernelOutput.tellp();
+    });
+
+    double scalar = measure(length, [&]() { checksum += reference(buffer.data(), length).size(); });
+
+    double traced = measure(length, [&]() {
+        logger.trace("{hexdump}", buffer.data(), length);
+        file.flush();
+    });
+
+    printf("%zu bytes, MB/s, fastest of %d rounds\n", length, ROUNDS);
+    printf("%-28s %10.1f\n", "printHexdump", kernel);
+    printf("%-28s %10.1f\n", "snprintf, xxd style", scalar);
+    printf("%-28s %10.1f\n", "trace(\"{hexdump}\")", traced);
+
+    //every line length and both halves of the line, then the whole buffer
+    for(size_t size = 0; size <= 4096 && size <= length && matches; ++size) {
+        if(printed(buffer.data(), size) != reference(buffer.data(), size) + "\n") {
+            printf("the hexdump of %zu bytes differs from snprintf\n", size);
+            matches = false;
+        }
+    }
+
+    if(matches && printed(buffer.data(), length) != reference(buffer.data(), length) + "\n") {
+        printf("the hexdump of %zu bytes differs from snprintf\n", length);
+        matches = false;
+    }
+
+    return (matches && checksum)? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include <chrono>
+#include <sched.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures a prefix printing the thread id, thread name, process id and CPU through the tid, tname, pid and cpu variables,
+ * against the same prefix made of callback variables that make the system calls on every message
+ * Then checks that a forked child and a second thread print their own ids, returns 1 if they don't
+ * ```
+ * IdentityBenchmark [messages]
+ * ```
+ * */
+
+/**
+ * Returns the ns per message of tracing @param messages messages through @param logger
+ * */
+static double measure(DebugLogger& logger, FileSink& file, int messages) {
+    //once to size the buffers, then measured
+    logger.trace("message {int}", 0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < messages; ++i) {
+        logger.trace("message {int}", i);
+    }
+
+    file.flush();
+    return secondsSince(start) * 1e9 / messages;
+}
+
+static std::string printed(const char* format) {
+    std::ostringstream output;
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&output);
+    logger.setPrefix("");
+    logger.trace(format);
+    return output.str();
+}
+
+int main(int argc, char** argv) {
+    int messages = argc > 1? atoi(argv[1]) : 2000000;
+    bool matches = true;
+
+    pthread_setname_np(pthread_self(), "benchmark");
+    FileSink file("/dev/null", 1 << 20);
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    logger.addCallbackVariable("ctid", []() { return (long long)syscall(SYS_gettid); }, false);
+    logger.addCallbackVariable("cpid", []() { return (long long)getpid(); }, false);
+    logger.addCallbackVariable("ccpu", []() { return (long long)sched_getcpu(); }, false);
+    logger.addCallbackVariable("ctname", []() {
+        char name[16];
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        return std::string(name);
+    }, false);
+
+    printf("%d messages, ns per message\n", messages);
+
+    logger.setPrefix("");
+    printf("%-32s %8.1f\n", "no prefix", measure(logger, file, messages));
+
+    //four variables that are plain loads, for the cost of printing any four variables
+    logger.setPrefix("[dmc] [ln] [tmc] [lmc]: ");
+    printf("%-32s %8.1f\n", "[dmc] [ln] [tmc] [lmc]", measure(logger, file, messages));
+
+    logger.setPrefix("[tid] [tname] [pid] [cpu]: ");
+    printf("%-32s %8.1f\n", "[tid] [tname] [pid] [cpu]", measure(logger, file, messages));
+
+    logger.setPrefix("[ctid] [ctname] [cpid] [ccpu]: ");
+    printf("%-32s %8.1f\n", "system calls per message", measure(logger, file, messages));
+
+    printf("%s", printed("[tid] [tname] [pid] [cpu]").c_str());
+
+    //the child prints the ids it reads after the fork, the parent's are cached in the same thread
+    std::string parentIds = printed("[pid] [tid]");
+    pid_t child = fork();
+
+    if(child == 0) {
+        std::string expected = std::to_string(getpid()) + " " + std::to_string(syscall(SYS_gettid)) + "\n";
+        _exit(printed("[pid] [tid]") == expected? 0 : 1);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("the forked child printed the parent's ids %s", parentIds.c_str());
+        matches = false;
+    }
+
+    std::string threadIds;
+    std::thread([&threadIds]() { threadIds = printed("[pid] [tid]"); }).join();
+
+    if(threadIds == parentIds) {
+        printf("a second thread printed the first one's ids %s", threadIds.c_str());
+        matches = false;
+    }
+
+    return matches? 0 : 1;
+}
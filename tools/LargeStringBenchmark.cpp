@@ -0,0 +1,64 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures messages with one large string argument, as {str} and as {strn}, written through a FileSink
+ * Strings from 4KB up are handed to the sink where they are instead of being copied into the line
+ * ```
+ * LargeStringBenchmark [output file]
+ * ```
+ * The output defaults to /dev/null, so the numbers are what logging costs the program rather than the disk
+ * */
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1? argv[1] : "/dev/null";
+    static const size_t sizes[] = { 1 << 10, 1 << 20, 64 << 20 };
+
+    FileSink file(path, 1 << 20);
+
+    if(!file.isOpen()) {
+        fprintf(stderr, "can't open %s\n", path);
+        return 1;
+    }
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+
+    printf("%-10s %-6s %12s %10s\n", "string", "spec", "us/message", "GB/s");
+
+    for(size_t size : sizes) {
+        std::string payload(size, 'x');
+
+        //about 1GB of payload per size, at least 20 messages
+        int messages = (int)std::max((size_t)20, ((size_t)1 << 30) / size);
+
+        for(int explicitLength = 0; explicitLength < 2; ++explicitLength) {
+            //once to size the buffers, then measured
+            logger.trace("payload {str} end", payload.c_str());
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for(int i = 0; i < messages; ++i) {
+                if(explicitLength) {
+                    logger.trace("payload {strn} end", payload.data(), payload.size());
+                }
+                else {
+                    logger.trace("payload {str} end", payload.c_str());
+                }
+            }
+
+            file.flush();
+            double seconds = secondsSince(start);
+            printf("%-10s %-6s %12.2f %10.2f\n", size >= (1 << 20)? (std::to_string(size >> 20) + " MB").c_str() : (std::to_string(size >> 10) + " KB").c_str(),
+                explicitLength? "strn" : "str", seconds * 1e6 / messages, (double)size * messages / seconds / 1e9);
+        }
+    }
+
+    return 0;
+}
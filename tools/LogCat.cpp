@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "LogCompression.h"
+
+/**
+ * Prints the text of files written by CompressedSink to stdout, like cat
+ * A file that was cut off (the process crashed while writing) prints every whole block and a note on stderr
+ * Returns 1 if a file couldn't be read or has a damaged block
+ * ```
+ * LogCat trace.dlz | grep "db.query"
+ * ```
+ * */
+
+static bool catFile(const char* path) {
+    FILE* file = strcmp(path, "-") == 0? stdin : fopen(path, "rb");
+
+    if(!file) {
+        fprintf(stderr, "LogCat: can't open %s\n", path);
+        return false;
+    }
+
+    LogCompression::Reader reader(file);
+    std::string text;
+    LogCompression::Reader::Result result = LogCompression::Reader::DAMAGED;
+
+    if(reader.isValid()) {
+        uint64_t offset = reader.getOffset();
+
+        while((result = reader.next(text)) == LogCompression::Reader::BLOCK) {
+            fwrite(text.data(), 1, text.size(), stdout);
+            offset = reader.getOffset();
+        }
+
+        if(result == LogCompression::Reader::TRUNCATED) {
+            fprintf(stderr, "LogCat: %s ends inside the block at offset %llu, it was not printed\n", path, (unsigned long long)offset);
+        }
+        else if(result == LogCompression::Reader::DAMAGED) {
+            fprintf(stderr, "LogCat: %s has a damaged block at offset %llu\n", path, (unsigned long long)offset);
+        }
+    }
+    else {
+        fprintf(stderr, "LogCat: %s is not a compressed log\n", path);
+    }
+
+    if(file != stdin) {
+        fclose(file);
+    }
+
+    return result != LogCompression::Reader::DAMAGED;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: LogCat file... (- for stdin)\n");
+        return 1;
+    }
+
+    bool passed = true;
+
+    for(int i = 1; i < argc; ++i) {
+        passed = catFile(argv[i]) && passed;
+    }
+
+    return passed? 0 : 1;
+}
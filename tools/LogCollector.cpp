@@ -0,0 +1,250 @@
+#include <chrono>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "SocketSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Stand-in for a node-local log agent: receives what SocketSinks send and writes it out
+ * ```
+ * LogCollector [-o file] [-s] address
+ * ```
+ * The address is written as for SocketSink (unix:path, unix-stream:path or udp:host:port); a Unix socket file
+ * already at the path is replaced. Stream clients are read at the same time and only whole lines are written,
+ * so lines from different clients never mix. A line cut off by a client disconnecting is dropped, a SocketSink sends it
+ * again whole when it reconnects. -s prints the bytes and datagrams received every second to stderr
+ * Stops on SIGINT or SIGTERM
+ * */
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStop(int) {
+    stopRequested = 1;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: LogCollector [-o file] [-s] address\n"
+        "  address    unix:path, unix-stream:path or udp:host:port\n"
+        "  -o file    write to file instead of stdout\n"
+        "  -s         print what was received every second to stderr\n");
+}
+
+struct Totals {
+    uint64_t bytes = 0;
+    uint64_t datagrams = 0;
+    uint64_t connections = 0;
+    uint64_t tornLines = 0;
+};
+
+static void printTotals(const Totals& totals, const Totals& last, double seconds) {
+    fprintf(stderr, "%llu bytes, %llu datagrams, %llu connections, %llu torn lines dropped, %.1f MB/s\n",
+        (unsigned long long)totals.bytes, (unsigned long long)totals.datagrams, (unsigned long long)totals.connections, (unsigned long long)totals.tornLines,
+        seconds > 0? (totals.bytes - last.bytes) / seconds / 1e6 : 0.0);
+}
+
+/**
+ * A stream client and the start of a line it hasn't finished yet
+ * */
+struct Client {
+    int fd;
+    std::string partial;
+};
+
+int main(int argc, char** argv) {
+    const char* outputPath = nullptr;
+    const char* addressText = nullptr;
+    bool stats = false;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-s") == 0) {
+            stats = true;
+        }
+        else if(argv[i][0] == '-' || addressText) {
+            usage();
+            return 2;
+        }
+        else {
+            addressText = argv[i];
+        }
+    }
+
+    SocketSink::Address address;
+
+    if(!addressText || !SocketSink::Address::parse(addressText, address)) {
+        usage();
+        return 2;
+    }
+
+    FILE* output = outputPath? fopen(outputPath, "wb") : stdout;
+
+    if(!output) {
+        fprintf(stderr, "can't open %s\n", outputPath);
+        return 1;
+    }
+
+    int listener = socket(address.family(), address.type, 0);
+
+    if(address.family() == AF_UNIX) {
+        unlink(((const sockaddr_un*)&address.storage)->sun_path);
+    }
+
+    if(listener < 0 || bind(listener, address.get(), address.length) != 0 || (address.type == SOCK_STREAM && listen(listener, 64) != 0)) {
+        fprintf(stderr, "can't listen on %s: %s\n", addressText, strerror(errno));
+        return 1;
+    }
+
+    //datagrams queue up in the receive buffer while the output is written
+    int receiveBuffer = 8 << 20;
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<char> buffer(1 << 18);
+    std::vector<Client> clients;
+    std::vector<pollfd> waiting;
+    Totals totals;
+    Totals last;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastPrint = started;
+
+    while(!stopRequested) {
+        waiting.clear();
+        waiting.push_back({ listener, POLLIN, 0 });
+
+        for(const Client& client : clients) {
+            waiting.push_back({ client.fd, POLLIN, 0 });
+        }
+
+        int ready = poll(waiting.data(), waiting.size(), 1000);
+
+        if(ready < 0 && errno != EINTR) {
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if(ready > 0 && (waiting[0].revents & POLLIN)) {
+            if(address.type == SOCK_DGRAM) {
+                //drain what is queued before polling again
+                while(true) {
+                    ssize_t length = recv(listener, buffer.data(), buffer.size(), MSG_DONTWAIT);
+
+                    if(length < 0) {
+                        break;
+                    }
+
+                    fwrite(buffer.data(), 1, (size_t)length, output);
+                    totals.bytes += (uint64_t)length;
+                    totals.datagrams++;
+                }
+            }
+            else {
+                int fd = accept(listener, nullptr, nullptr);
+
+                if(fd >= 0) {
+                    clients.push_back({ fd, std::string() });
+                    totals.connections++;
+                }
+            }
+        }
+
+        for(size_t i = 1; ready > 0 && i < waiting.size(); ++i) {
+            if(!waiting[i].revents) {
+                continue;
+            }
+
+            Client& client = clients[i - 1];
+            ssize_t length = recv(client.fd, buffer.data(), buffer.size(), 0);
+
+            if(length <= 0) {
+                //the sink sends a message that was cut off again whole after reconnecting, so the torn start is dropped
+                //instead of running into the next line written
+                if(!client.partial.empty()) {
+                    totals.tornLines++;
+                }
+
+                close(client.fd);
+                client.fd = -1;
+                continue;
+            }
+
+            totals.bytes += (uint64_t)length;
+            const char* data = buffer.data();
+            size_t lineEnd = (size_t)length;
+
+            while(lineEnd > 0 && data[lineEnd - 1] != '\n') {
+                lineEnd--;
+            }
+
+            if(lineEnd == 0) {
+                client.partial.append(data, (size_t)length);
+                continue;
+            }
+
+            fwrite(client.partial.data(), 1, client.partial.size(), output);
+            fwrite(data, 1, lineEnd, output);
+            client.partial.assign(data + lineEnd, data + length);
+        }
+
+        for(size_t i = 0; i < clients.size();) {
+            if(clients[i].fd < 0) {
+                clients.erase(clients.begin() + i);
+            }
+            else {
+                ++i;
+            }
+        }
+
+        if(stats) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - lastPrint).count();
+
+            if(seconds >= 1) {
+                printTotals(totals, last, seconds);
+                last = totals;
+                lastPrint = now;
+            }
+        }
+    }
+
+    //nothing will send these again, so they are kept, ended so they don't run into anything appended later
+    for(const Client& client : clients) {
+        if(!client.partial.empty()) {
+            fwrite(client.partial.data(), 1, client.partial.size(), output);
+            fputc('\n', output);
+        }
+
+        close(client.fd);
+    }
+
+    fflush(output);
+
+    if(outputPath) {
+        fclose(output);
+    }
+
+    if(stats) {
+        printTotals(totals, Totals(), secondsSince(started));
+    }
+
+    close(listener);
+
+    if(address.family() == AF_UNIX) {
+        unlink(((const sockaddr_un*)&address.storage)->sun_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,770 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <ctype.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LOG_GREP_MMAP 1
+#endif
+
+#include "DebugLogger.h"
+
+/**
+ * Filters logs written with a known prefix format, much faster than a regular expression can
+ * The prefix format (setPrefix, DEFAULT_PREFIX unless -p is given) is compiled into its literal text and its variables,
+ * so each line is split into fields by finding the literals. Lines that don't start with the prefix
+ * (arrays and hexdumps that span lines) belong to the message above them
+ * ```
+ * LogGrep -l ERR -s "timeout" service.log
+ * LogGrep -p "[ln] [dmc] [wt] " -n 1000000-1005000 -f wt=12:00:01 service.log.1 service.log
+ * ```
+ * Files are memory mapped and cut into chunks at message boundaries. A pool of threads filters the chunks
+ * and the matching messages are written in their original order
+ * Returns 0 if any message matched, 1 if none did and 2 on errors, like grep
+ * */
+
+static void usage() {
+    fprintf(stderr,
+        "usage: LogGrep [options] file...\n"
+        "  -p format     prefix format of the log (default \"%s\")\n"
+        "  -l name       keep messages on this level, by the name printed by ln (repeatable)\n"
+        "  -n from-to    keep messages numbered from..to, by dmc or else lmc\n"
+        "  -r var=from-to keep messages whose numeric variable is in from..to\n"
+        "  -f var=value  keep messages whose variable is printed as value (repeatable)\n"
+        "  -s text       keep messages containing text after the prefix (repeatable)\n"
+        "  -c            print the number of matching messages instead\n"
+        "  -j threads    number of threads (default: one per core)\n", DEFAULT_PREFIX);
+}
+
+/**
+ * A piece of the prefix: literal text, or a variable whose printed value is a field of the line
+ * */
+struct PrefixPart {
+    bool variable;
+    std::string text;
+};
+
+/**
+ * Splits @param format into literals and variables, following the grammar of DebugLogger::printNextPrefix
+ * The name of a variable is the identifier at the end of its brackets, after the formatting options
+ * */
+static std::vector<PrefixPart> compilePrefix(const char* format) {
+    std::vector<PrefixPart> parts;
+    std::string literal;
+
+    for(size_t i = 0; format[i]; ++i) {
+        if(format[i] == '\\' && format[i + 1]) {
+            literal += format[++i];
+            continue;
+        }
+
+        if(format[i] != '[') {
+            literal += format[i];
+            continue;
+        }
+
+        if(!literal.empty()) {
+            parts.push_back({ false, literal });
+            literal.clear();
+        }
+
+        //find the closing bracket, sub-formats can nest brackets
+        size_t start = ++i;
+        int depth = 1;
+
+        for(; format[i]; ++i) {
+            if(format[i] == '\\' && format[i + 1]) {
+                i++;
+            }
+            else if(format[i] == '[') {
+                depth++;
+            }
+            else if(format[i] == ']' && --depth == 0) {
+                break;
+            }
+        }
+
+        std::string content(format + start, format + i);
+        size_t nameStart = content.size();
+
+        while(nameStart > 0 && (isalnum((unsigned char)content[nameStart - 1]) || content[nameStart - 1] == '_' || content[nameStart - 1] == '.')) {
+            nameStart--;
+        }
+
+        //digits and dots before the name are print options, as in [>05lmc] and [.2etl], dots inside it are ctx.name
+        while(nameStart < content.size() && !isalpha((unsigned char)content[nameStart]) && content[nameStart] != '_') {
+            nameStart++;
+        }
+
+        parts.push_back({ true, content.find('\'') == std::string::npos? content.substr(nameStart) : std::string() });
+
+        if(!format[i]) {
+            break;
+        }
+    }
+
+    if(!literal.empty()) {
+        parts.push_back({ false, literal });
+    }
+
+    return parts;
+}
+
+/**
+ * A run of matching messages, pointing into the mapped file so nothing is copied until it is written
+ * */
+struct Range {
+    const char* start;
+    const char* end;
+};
+
+struct Field {
+    const char* start;
+    size_t length;
+};
+
+struct RangeFilter {
+    int field;
+    uint64_t from;
+    uint64_t to;
+};
+
+struct ValueFilter {
+    int field;
+    std::string value;
+};
+
+/**
+ * The compiled prefix and filters, shared read only by every thread
+ * */
+struct Search {
+    std::vector<PrefixPart> parts;
+    std::vector<int> fieldOfPart;
+    int fieldCount = 0;
+    int levelField = -1;
+    std::vector<std::string> levels;
+    std::vector<RangeFilter> ranges;
+    std::vector<ValueFilter> values;
+    std::vector<std::string> substrings;
+    bool countOnly = false;
+
+    int findField(const std::string& name) const {
+        for(size_t i = 0; i < parts.size(); ++i) {
+            if(parts[i].variable && parts[i].text == name) {
+                return fieldOfPart[i];
+            }
+        }
+
+        return -1;
+    }
+
+    static Field trim(const char* start, const char* end) {
+        while(start < end && *start == ' ') {
+            start++;
+        }
+
+        while(end > start && end[-1] == ' ') {
+            end--;
+        }
+
+        return { start, (size_t)(end - start) };
+    }
+
+    /**
+     * Splits the line from @param line to @param end into fields, returns false if it doesn't start with the prefix
+     * @param message receives the start of the text after the prefix
+     * */
+    bool parseLine(const char* line, const char* end, Field* fields, const char*& message) const {
+        const char* position = line;
+
+        //colored lines start with an escape sequence
+        if(end - position > 1 && position[0] == '\x1b' && position[1] == '[') {
+            const char* m = (const char*)memchr(position, 'm', (size_t)(end - position));
+            position = m? m + 1 : position;
+        }
+
+        for(size_t i = 0; i < parts.size(); ++i) {
+            const PrefixPart& part = parts[i];
+
+            if(!part.variable) {
+                if((size_t)(end - position) < part.text.size() || !startsWith(position, part.text)) {
+                    return false;
+                }
+
+                position += part.text.size();
+                continue;
+            }
+
+            //a variable ends where the next literal starts, or at a space when no literal follows it
+            const char* fieldEnd;
+
+            if(i + 1 < parts.size() && !parts[i + 1].variable) {
+                fieldEnd = findLiteral(position, end, parts[i + 1].text);
+            }
+            else {
+                fieldEnd = position;
+
+                while(fieldEnd < end && *fieldEnd == ' ') {
+                    fieldEnd++;
+                }
+
+                while(fieldEnd < end && *fieldEnd != ' ') {
+                    fieldEnd++;
+                }
+            }
+
+            if(!fieldEnd) {
+                return false;
+            }
+
+            fields[fieldOfPart[i]] = trim(position, fieldEnd);
+            position = fieldEnd;
+        }
+
+        message = position;
+        return true;
+    }
+
+    /**
+     * Returns whether the message whose first line was split into @param fields passes every filter
+     * @param message to @param end is its text, including the lines under it
+     * */
+    bool matches(const Field* fields, const char* message, const char* end) const {
+        if(!levels.empty()) {
+            const Field& level = fields[levelField];
+            bool found = false;
+
+            for(const std::string& name : levels) {
+                if(equalsIgnoreCase(name, level)) {
+                    found = true;
+                    break;
+                }
+            }
+
+            if(!found) {
+                return false;
+            }
+        }
+
+        for(const RangeFilter& range : ranges) {
+            uint64_t value = 0;
+            const Field& field = fields[range.field];
+
+            for(size_t i = 0; i < field.length; ++i) {
+                if(field.start[i] < '0' || field.start[i] > '9') {
+                    return false;
+                }
+
+                value = value * 10 + (uint64_t)(field.start[i] - '0');
+            }
+
+            if(field.length == 0 || value < range.from || value > range.to) {
+                return false;
+            }
+        }
+
+        for(const ValueFilter& filter : values) {
+            const Field& field = fields[filter.field];
+
+            if(field.length != filter.value.size() || memcmp(field.start, filter.value.data(), field.length) != 0) {
+                return false;
+            }
+        }
+
+        for(const std::string& text : substrings) {
+            if(!findInMessage(message, end, text)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Compares the few characters of a literal without the call to memcmp
+     * */
+    static bool startsWith(const char* position, const std::string& literal) {
+        for(size_t i = 0; i < literal.size(); ++i) {
+            if(position[i] != literal[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Finds @param literal in a line, where it is usually a few characters away
+     * A plain loop is much cheaper than memmem's setup at that distance
+     * */
+    static const char* findLiteral(const char* position, const char* end, const std::string& literal) {
+        char first = literal[0];
+
+        for(; position + literal.size() <= end; ++position) {
+            if(*position == first && startsWith(position, literal)) {
+                return position;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Finds @param text in one message, short enough that finding its first character with memchr beats memmem
+     * */
+    static const char* findInMessage(const char* position, const char* end, const std::string& text) {
+        while((size_t)(end - position) >= text.size()) {
+            position = (const char*)memchr(position, text[0], (size_t)(end - position) - text.size() + 1);
+
+            if(!position) {
+                return nullptr;
+            }
+
+            if(startsWith(position, text)) {
+                return position;
+            }
+
+            position++;
+        }
+
+        return nullptr;
+    }
+
+    static bool equalsIgnoreCase(const std::string& text, const Field& field) {
+        if(text.size() != field.length) {
+            return false;
+        }
+
+        for(size_t i = 0; i < field.length; ++i) {
+            if(tolower((unsigned char)text[i]) != tolower((unsigned char)field.start[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static const char* findText(const char* start, const char* end, const std::string& text) {
+#ifdef __GLIBC__
+        return (const char*)memmem(start, (size_t)(end - start), text.data(), text.size());
+#else
+        const char* found = std::search(start, end, text.begin(), text.end());
+        return (found == end && !text.empty())? nullptr : found;
+#endif
+    }
+};
+
+static const char* nextLine(const char* position, const char* end) {
+    const char* newLine = (const char*)memchr(position, '\n', (size_t)(end - position));
+    return newLine? newLine + 1 : end;
+}
+
+/**
+ * Returns the start of the first message at or after @param position, which must be the start of a line
+ * Its fields are split into @param fields, @param message receives the start of its text and @param lineEnd the end of its first line
+ * */
+static const char* nextMessage(const Search& search, const char* position, const char* end, Field* fields, const char*& message, const char*& lineEnd) {
+    while(position < end) {
+        lineEnd = nextLine(position, end);
+
+        if(search.parseLine(position, lineEnd, fields, message)) {
+            return position;
+        }
+
+        position = lineEnd;
+    }
+
+    return end;
+}
+
+/**
+ * Adds the messages from @param start to @param end that pass the filters to @param output
+ * @param start is the start of a message, or of the file
+ * */
+static uint64_t filterChunk(const Search& search, const char* start, const char* end, std::vector<Range>& output) {
+    std::vector<Field> fields(search.fieldCount + 1);
+    std::vector<Field> nextFields(search.fieldCount + 1);
+    uint64_t matched = 0;
+    const char* message = nullptr;
+    const char* lineEnd = nullptr;
+    const char* position = nextMessage(search, start, end, fields.data(), message, lineEnd);
+    int walk = 0;
+
+    while(position < end) {
+        //with a substring to look for, skip straight to the messages containing the first one given
+        //when it is in most messages, searching for it costs more than it skips, so walk the next messages one by one instead
+        if(!search.substrings.empty() && walk-- <= 0) {
+            const char* found = Search::findText(message, end, search.substrings[0]);
+
+            if(!found) {
+                break;
+            }
+
+            if(found - position < 512) {
+                walk = 64;
+            }
+
+            if(found >= lineEnd) {
+                const char* lineStart = found;
+
+                while(lineStart > position && lineStart[-1] != '\n') {
+                    lineStart--;
+                }
+
+                //walk back over the lines under a message to the line with its prefix
+                while(lineStart > position && !search.parseLine(lineStart, nextLine(lineStart, end), fields.data(), message)) {
+                    lineStart--;
+
+                    while(lineStart > position && lineStart[-1] != '\n') {
+                        lineStart--;
+                    }
+                }
+
+                if(lineStart == position) {
+                    search.parseLine(position, lineEnd, fields.data(), message);
+                }
+
+                position = lineStart;
+                lineEnd = nextLine(position, end);
+            }
+        }
+
+        //the fields of the next message go in nextFields, then the two swap
+        const char* nextText = nullptr;
+        const char* nextLineEnd = nullptr;
+        const char* messageEnd = nextMessage(search, lineEnd, end, nextFields.data(), nextText, nextLineEnd);
+
+        if(search.matches(fields.data(), message, messageEnd)) {
+            matched++;
+
+            if(!search.countOnly) {
+                //neighbouring messages are written in one piece
+                if(!output.empty() && output.back().end == position) {
+                    output.back().end = messageEnd;
+                }
+                else {
+                    output.push_back({ position, messageEnd });
+                }
+            }
+        }
+
+        fields.swap(nextFields);
+        message = nextText;
+        lineEnd = nextLineEnd;
+        position = messageEnd;
+    }
+
+    return matched;
+}
+
+/**
+ * A file mapped into memory, or read into it where mmap isn't available
+ * */
+class MappedFile {
+    public:
+        bool open(const char* path) {
+#ifdef LOG_GREP_MMAP
+            int fd = ::open(path, O_RDONLY);
+
+            if(fd < 0) {
+                return false;
+            }
+
+            struct stat info;
+
+            if(fstat(fd, &info) != 0) {
+                ::close(fd);
+                return false;
+            }
+
+            length = (size_t)info.st_size;
+
+            if(length > 0) {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if(mapped == MAP_FAILED) {
+                    ::close(fd);
+                    return false;
+                }
+
+                madvise(mapped, length, MADV_SEQUENTIAL);
+                data = (const char*)mapped;
+            }
+
+            ::close(fd);
+            return true;
+#else
+            FILE* file = fopen(path, "rb");
+
+            if(!file) {
+                return false;
+            }
+
+            char buffer[65536];
+            size_t count;
+
+            while((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                contents.append(buffer, count);
+            }
+
+            fclose(file);
+            data = contents.data();
+            length = contents.size();
+            return true;
+#endif
+        }
+
+        ~MappedFile() {
+#ifdef LOG_GREP_MMAP
+            if(data) {
+                munmap((void*)data, length);
+            }
+#endif
+        }
+
+        const char* data = nullptr;
+        size_t length = 0;
+
+    private:
+#ifndef LOG_GREP_MMAP
+        std::string contents;
+#endif
+};
+
+struct Chunk {
+    const char* start;
+    const char* end;
+    std::vector<Range> output;
+    uint64_t matched = 0;
+    bool done = false;
+};
+
+static const size_t CHUNK_SIZE = 8 << 20;
+
+/**
+ * Cuts @param file into chunks of about CHUNK_SIZE bytes that start at messages
+ * */
+static void addChunks(const Search& search, const MappedFile& file, std::vector<Chunk>& chunks) {
+    std::vector<Field> fields(search.fieldCount + 1);
+    const char* start = file.data;
+    const char* end = file.data + file.length;
+
+    while(start < end) {
+        const char* cut = end;
+
+        if((size_t)(end - start) > CHUNK_SIZE) {
+            const char* message;
+            const char* lineEnd;
+            cut = nextMessage(search, nextLine(start + CHUNK_SIZE, end), end, fields.data(), message, lineEnd);
+        }
+
+        chunks.push_back(Chunk());
+        chunks.back().start = start;
+        chunks.back().end = cut;
+        start = cut;
+    }
+}
+
+static bool parseRange(const char* text, uint64_t& from, uint64_t& to) {
+    char* dash;
+    from = strtoull(text, &dash, 10);
+
+    if(*dash != '-') {
+        return false;
+    }
+
+    to = strtoull(dash + 1, nullptr, 10);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Search search;
+    const char* prefix = DEFAULT_PREFIX;
+    const char* messageRange = nullptr;
+    std::vector<std::pair<std::string, std::string>> rangeOptions;
+    std::vector<std::pair<std::string, std::string>> valueOptions;
+    unsigned threadCount = std::thread::hardware_concurrency();
+    std::vector<const char*> paths;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+
+        if(option.size() == 2 && option[0] == '-' && option[1] != 'c' && i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+
+        if(option == "-p") {
+            prefix = argv[++i];
+        }
+        else if(option == "-l") {
+            search.levels.push_back(argv[++i]);
+        }
+        else if(option == "-n") {
+            messageRange = argv[++i];
+        }
+        else if(option == "-r" || option == "-f") {
+            std::string filter = argv[++i];
+            size_t equals = filter.find('=');
+
+            if(equals == std::string::npos) {
+                usage();
+                return 2;
+            }
+
+            (option == "-r"? rangeOptions : valueOptions).push_back({ filter.substr(0, equals), filter.substr(equals + 1) });
+        }
+        else if(option == "-s") {
+            search.substrings.push_back(argv[++i]);
+        }
+        else if(option == "-c") {
+            search.countOnly = true;
+        }
+        else if(option == "-j") {
+            threadCount = (unsigned)atoi(argv[++i]);
+        }
+        else if(option.size() > 1 && option[0] == '-') {
+            usage();
+            return 2;
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if(paths.empty()) {
+        usage();
+        return 2;
+    }
+
+    search.parts = compilePrefix(prefix);
+
+    for(const PrefixPart& part : search.parts) {
+        search.fieldOfPart.push_back(part.variable? search.fieldCount++ : -1);
+    }
+
+    if(!search.levels.empty() && (search.levelField = search.findField("ln")) < 0) {
+        fprintf(stderr, "LogGrep: -l needs the ln variable in the prefix\n");
+        return 2;
+    }
+
+    if(messageRange) {
+        int field = search.findField("dmc") >= 0? search.findField("dmc") : search.findField("lmc");
+        rangeOptions.push_back({ field == search.findField("dmc")? "dmc" : "lmc", messageRange });
+    }
+
+    for(const std::pair<std::string, std::string>& option : rangeOptions) {
+        RangeFilter range;
+        range.field = search.findField(option.first);
+
+        if(range.field < 0 || !parseRange(option.second.c_str(), range.from, range.to)) {
+            fprintf(stderr, "LogGrep: can't filter on %s=%s, the prefix has no such variable or the range isn't from-to\n", option.first.c_str(), option.second.c_str());
+            return 2;
+        }
+
+        search.ranges.push_back(range);
+    }
+
+    for(const std::pair<std::string, std::string>& option : valueOptions) {
+        ValueFilter filter;
+        filter.field = search.findField(option.first);
+        filter.value = option.second;
+
+        if(filter.field < 0) {
+            fprintf(stderr, "LogGrep: the prefix has no variable %s\n", option.first.c_str());
+            return 2;
+        }
+
+        search.values.push_back(filter);
+    }
+
+    std::vector<MappedFile> files(paths.size());
+    std::vector<Chunk> chunks;
+
+    for(size_t i = 0; i < paths.size(); ++i) {
+        if(!files[i].open(paths[i])) {
+            fprintf(stderr, "LogGrep: can't read %s\n", paths[i]);
+            return 2;
+        }
+
+        addChunks(search, files[i], chunks);
+    }
+
+    //workers stay at most a few chunks ahead of the writer, so the output held in memory is bounded
+    std::mutex lock;
+    std::condition_variable chunkDone;
+    std::condition_variable chunkWritten;
+    size_t nextChunk = 0;
+    size_t written = 0;
+    size_t window = std::max(threadCount, 1u) * 4;
+    std::vector<std::thread> workers;
+
+    for(unsigned t = 0; t < std::max(threadCount, 1u); ++t) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> guard(lock);
+
+            while(true) {
+                while(nextChunk < chunks.size() && nextChunk >= written + window) {
+                    chunkWritten.wait(guard);
+                }
+
+                if(nextChunk >= chunks.size()) {
+                    return;
+                }
+
+                Chunk& chunk = chunks[nextChunk++];
+                guard.unlock();
+                chunk.matched = filterChunk(search, chunk.start, chunk.end, chunk.output);
+                guard.lock();
+                chunk.done = true;
+                chunkDone.notify_all();
+            }
+        });
+    }
+
+    uint64_t matched = 0;
+    std::unique_lock<std::mutex> guard(lock);
+    setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+
+    while(written < chunks.size()) {
+        while(!chunks[written].done) {
+            chunkDone.wait(guard);
+        }
+
+        Chunk& chunk = chunks[written];
+        guard.unlock();
+
+        for(const Range& range : chunk.output) {
+            fwrite(range.start, 1, (size_t)(range.end - range.start), stdout);
+        }
+
+        matched += chunk.matched;
+        std::vector<Range>().swap(chunk.output);
+        guard.lock();
+        written++;
+        chunkWritten.notify_all();
+    }
+
+    guard.unlock();
+
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+
+    if(search.countOnly) {
+        printf("%llu\n", (unsigned long long)matched);
+    }
+
+    return matched? 0 : 1;
+}
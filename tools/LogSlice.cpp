@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "LogCompression.h"
+#include "TimeIndex.h"
+
+/**
+ * Prints the part of a log between two logger times or two message numbers, using the time index written by
+ * FileSink or CompressedSink to seek straight to it (see TimeIndex.h)
+ * ```
+ * LogSlice -t 3600 3630 trace.log            //seconds of logger time, as printed by [ts]
+ * LogSlice -m 1000000 1000500 trace.dlz      //message numbers, as printed by [dmc]
+ * ```
+ * The index is read from the log's path with .idx appended unless another path is given
+ * The slice starts at the last index entry at or before the start and ends at the first entry after the end,
+ * so it can include a few messages on either side
+ * */
+
+static void usage() {
+    fprintf(stderr, "usage: LogSlice -t fromSeconds toSeconds | -m fromMessage toMessage log [index]\n");
+}
+
+/**
+ * Where a slice starts or ends: a file offset and, for compressed logs, an offset in that block's text
+ * */
+struct Position {
+    uint64_t fileOffset;
+    uint64_t textOffset;
+    bool end;
+};
+
+static bool printPlain(FILE* log, const Position& start, const Position& end) {
+    if(!LogCompression::seekFile(log, start.fileOffset)) {
+        return false;
+    }
+
+    char buffer[65536];
+    uint64_t remaining = end.end? UINT64_MAX : end.fileOffset - start.fileOffset;
+
+    while(remaining > 0) {
+        size_t count = fread(buffer, 1, remaining < sizeof(buffer)? (size_t)remaining : sizeof(buffer), log);
+
+        if(count == 0) {
+            break;
+        }
+
+        fwrite(buffer, 1, count, stdout);
+        remaining -= count;
+    }
+
+    return true;
+}
+
+static bool printCompressed(FILE* log, const Position& start, const Position& end) {
+    LogCompression::Reader reader(log);
+
+    if(!reader.isValid() || !reader.seek(start.fileOffset)) {
+        return false;
+    }
+
+    std::string text;
+
+    while(end.end || reader.getOffset() <= end.fileOffset) {
+        uint64_t blockOffset = reader.getOffset();
+        LogCompression::Reader::Result result = reader.next(text);
+
+        if(result != LogCompression::Reader::BLOCK) {
+            return result != LogCompression::Reader::DAMAGED;
+        }
+
+        size_t from = (blockOffset == start.fileOffset && start.textOffset < text.size())? (size_t)start.textOffset : 0;
+        size_t to = (!end.end && blockOffset == end.fileOffset && end.textOffset < text.size())? (size_t)end.textOffset : text.size();
+
+        if(to > from) {
+            fwrite(text.data() + from, 1, to - from, stdout);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 5 || (strcmp(argv[1], "-t") != 0 && strcmp(argv[1], "-m") != 0)) {
+        usage();
+        return 1;
+    }
+
+    bool byMessage = strcmp(argv[1], "-m") == 0;
+    uint64_t from = byMessage? strtoull(argv[2], nullptr, 10) : (uint64_t)(strtod(argv[2], nullptr) * 1e9);
+    uint64_t to = byMessage? strtoull(argv[3], nullptr, 10) : (uint64_t)(strtod(argv[3], nullptr) * 1e9);
+    std::string logPath = argv[4];
+    std::string indexPath = argc > 5? argv[5] : logPath + ".idx";
+
+    FILE* indexFile = fopen(indexPath.c_str(), "rb");
+    FILE* log = fopen(logPath.c_str(), "rb");
+
+    if(!indexFile || !log) {
+        fprintf(stderr, "LogSlice: can't open %s\n", !indexFile? indexPath.c_str() : logPath.c_str());
+        return 1;
+    }
+
+    TimeIndex::Reader index(indexFile);
+
+    if(!index.isValid()) {
+        fprintf(stderr, "LogSlice: %s is not a time index\n", indexPath.c_str());
+        return 1;
+    }
+
+    //the slice starts at the last entry at or before the start, or at the start of the log
+    uint64_t first = byMessage? index.countUpToMessage(from) : index.countUpToTime(from);
+    uint64_t last = byMessage? index.countUpToMessage(to) : index.countUpToTime(to);
+    TimeIndex::Entry entry;
+
+    Position start = { index.isCompressed()? LogCompression::FILE_HEADER_SIZE : 0, 0, false };
+    Position end = { 0, 0, true };
+
+    if(first > 0 && index.read(first - 1, entry)) {
+        start.fileOffset = entry.fileOffset;
+        start.textOffset = entry.textOffset;
+    }
+
+    if(index.read(last, entry)) {
+        end.fileOffset = entry.fileOffset;
+        end.textOffset = entry.textOffset;
+        end.end = false;
+    }
+
+    bool printed = index.isCompressed()? printCompressed(log, start, end) : printPlain(log, start, end);
+
+    if(!printed) {
+        fprintf(stderr, "LogSlice: %s doesn't match its index\n", logPath.c_str());
+    }
+
+    fclose(log);
+    fclose(indexFile);
+    return printed? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "Metrics.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures what a LogMetrics event costs from 1 to 4 threads, compared with logging a line per event,
+ * then prints a summary and a prefix that reads the metrics, and runs the summary thread for a few intervals
+ * Returns 1 if the summed counters don't match what the threads added or the summary thread printed nothing
+ * ```
+ * MetricsBenchmark [events]
+ * ```
+ * */
+
+/**
+ * Runs @param body with the event index @param events times on each of @param threads threads, returns the ns per event
+ * */
+template<typename Body>
+static double measure(int threads, int events, Body body) {
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for(int i = 0; i < events; ++i) {
+                body(i);
+            }
+        });
+    }
+
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return secondsSince(start) * 1e9 / ((double)events * threads);
+}
+
+int main(int argc, char** argv) {
+    int events = argc > 1? atoi(argv[1]) : 20000000;
+    bool matches = true;
+
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    FileSink file("/tmp/MetricsBenchmark.log");
+    logger.setTargetOutput(&file);
+
+    //events don't print the summary, so only the events are measured
+    LogMetrics metrics(logger);
+    LogMetrics::Counter requests = metrics.counter("requests");
+    LogMetrics::Gauge queue = metrics.gauge("queue");
+    LogMetrics::Histogram latency = metrics.histogram("latency");
+
+    printf("%d events per thread, ns per event\n", events);
+    printf("%-8s %10s %10s %10s\n", "threads", "counter", "gauge", "histogram");
+
+    uint64_t expected = 0;
+
+    for(int threads = 1; threads <= 4; threads *= 2) {
+        double counterNs = measure(threads, events, [&](int) { requests.add(); });
+        double gaugeNs = measure(threads, events, [&](int i) { queue.set(i & 63); });
+        double histogramNs = measure(threads, events, [&](int i) { latency.record(1000 + (i & 4095)); });
+        expected += (uint64_t)events * threads;
+        printf("%-8d %10.2f %10.2f %10.2f\n", threads, counterNs, gaugeNs, histogramNs);
+    }
+
+    //the line per event the metrics replace, from one thread as loggers aren't shared between threads
+    double traceNs = measure(1, events / 20, [&](int i) { logger.trace("latency {int}", 1000 + (i & 4095)); });
+    printf("trace line per event to a FileSink: %.1f ns\n", traceNs);
+
+    file.flush();
+    remove("/tmp/MetricsBenchmark.log");
+
+    logger.setTargetOutput(&std::cout);
+    metrics.printSummary();
+    logger.setPrefix("[metric.requests] [metric.latency.p99]: ");
+    logger.trace("prefix reading the metrics");
+
+    uint64_t total = 0;
+    double number = 0;
+    metrics.getMetric("requests", 8, total, number);
+
+    if(total != expected) {
+        printf("the counter summed to %llu, %llu were added\n", (unsigned long long)total, (unsigned long long)expected);
+        matches = false;
+    }
+
+    //the thread prints through a copy of the logger made when it starts, with the output set here
+    std::ostringstream summaries;
+    logger.setPrefix("");
+    logger.setTargetOutput(&summaries);
+    metrics.setSummaryInterval(50);
+    metrics.startSummaryThread();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    metrics.stopSummaryThread();
+
+    if(summaries.str().find("metrics: requests=") == std::string::npos) {
+        printf("the summary thread printed nothing in 300 ms\n");
+        matches = false;
+    }
+
+    return matches? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "Profiler.h"
+#include "Timer.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures the cost of an empty DEBUG_SCOPE span, next to the two clock reads every span makes,
+ * then checks that spans recorded by several threads at once all show up in the summary
+ * Returns 1 if a span costs more than its budget, 30ns above the two clock reads by default, or if a span is missing
+ * ```
+ * ProfilerBenchmark [spans] [budget ns] [threads]
+ * ```
+ * The budget is for an optimized build. The clock reads are left out of it because their cost depends on the machine,
+ * a virtual machine can take more than 20ns per TSC read, and are printed on their own for reference
+ * */
+
+static const int ROUNDS = 5;
+static const int WARMUP_SPANS = 100000;
+
+/**
+ * Returns the ns per call of the fastest of ROUNDS rounds of @param calls / ROUNDS runs of @param call
+ * */
+template<typename Call>
+static double measure(int calls, Call call) {
+    for(int i = 0; i < WARMUP_SPANS; ++i) {
+        call();
+    }
+
+    int perRound = calls / ROUNDS;
+    double fastest = 0;
+
+    for(int round = 0; round < ROUNDS; ++round) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < perRound; ++i) {
+            call();
+        }
+
+        double nanoseconds = secondsSince(start) * 1e9 / perRound;
+        fastest = (round == 0 || nanoseconds < fastest)? nanoseconds : fastest;
+    }
+
+    return fastest;
+}
+
+int main(int argc, char** argv) {
+    int spans = argc > 1? atoi(argv[1]) : 20000000;
+    double budget = argc > 2? atof(argv[2]) : 30;
+    int threads = argc > 3? atoi(argv[3]) : 4;
+    bool matches = true;
+
+    //no summary is printed, so the spans only record
+    DebugLogger logger;
+    Profiler::global().setSummaryInterval(0);
+
+    double span = measure(spans, [&]() { DEBUG_SCOPE(logger, "span"); });
+
+    uint64_t ticks = 0;
+    double clockReads = measure(spans, [&]() { ticks += TscClock::ticks(); ticks += TscClock::ticks(); });
+
+    printf("%d spans, ns per span, fastest of %d rounds\n", spans, ROUNDS);
+    printf("%-26s %10.1f\n", "empty DEBUG_SCOPE", span);
+    printf("%-26s %10.1f (%s)\n", "two clock reads", clockReads, TscClock::isInvariant()? "TSC" : "steady_clock");
+    printf("%-26s %10.1f\n", "span without clock reads", span - clockReads);
+
+    if(span - clockReads > budget) {
+        printf("a span costs %.1f ns above its clock reads, over the %.0f ns budget\n", span - clockReads, budget);
+        matches = false;
+    }
+
+    //every thread records into its own shard, the summary adds them up
+    LatencyHistogram& histogram = Profiler::global().getHistogram("threads");
+    int perThread = spans / 10 / threads;
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for(int i = 0; i < perThread; ++i) {
+                DEBUG_SCOPE(logger, "threads");
+            }
+        });
+    }
+
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double elapsed = secondsSince(start);
+    uint64_t made = (uint64_t)perThread * threads;
+    uint64_t counted = histogram.getSummary().count;
+    printf("%d threads, %.1f ns per span in all\n", threads, elapsed * 1e9 / made);
+
+    if(counted != made || ticks == 0) {
+        printf("the summary counted %llu spans, made %llu\n", (unsigned long long)counted, (unsigned long long)made);
+        matches = false;
+    }
+
+    return matches? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "ShmSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures a ShmSink with a reader thread standing in for the ShmCollector: what a message costs the threads that log,
+ * from 1 to 4 of them, then how long a message takes to reach the reader, with a reader that spins and one that sleeps 200us
+ * when the ring is empty like the collector does
+ * Returns 1 if the reader doesn't get exactly the messages that weren't dropped
+ * ```
+ * ShmBenchmark [messages]
+ * ```
+ * */
+
+static const char* RING_NAME = "/DebugLoggerShmBenchmark";
+
+static uint64_t nowNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Reads the ring until stopped, keeping how long each message took if it starts with its send time
+ * */
+class Consumer {
+    public:
+        Consumer(int idleMicroseconds, bool timed)
+            :idleMicroseconds(idleMicroseconds),
+            timed(timed)
+        {
+            if(!reader.attach(RING_NAME)) {
+                fprintf(stderr, "can't attach to the ring\n");
+                exit(1);
+            }
+
+            thread = std::thread(&Consumer::run, this);
+        }
+
+        void finish() {
+            stopping.store(true);
+            thread.join();
+        }
+
+        uint64_t messages = 0;
+        std::vector<uint64_t> latencies;
+
+    private:
+        void run() {
+            const char* data;
+            size_t length;
+
+            while(true) {
+                //checked before peeking, so the messages written before finish() are all seen
+                bool stop = stopping.load();
+                ShmSink::Reader::Status status = reader.peek(data, length);
+
+                if(status == ShmSink::Reader::RECORD) {
+                    if(timed) {
+                        uint64_t sent;
+                        memcpy(&sent, data, sizeof(sent));
+                        latencies.push_back(nowNanoseconds() - sent);
+                    }
+
+                    messages++;
+                    reader.release();
+                    continue;
+                }
+
+                if(status == ShmSink::Reader::EMPTY && stop) {
+                    break;
+                }
+
+                if(idleMicroseconds) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(idleMicroseconds));
+                }
+            }
+        }
+
+        ShmSink::Reader reader;
+        int idleMicroseconds;
+        bool timed;
+        std::atomic<bool> stopping{ false };
+        std::thread thread;
+};
+
+/**
+ * @return false if the reader didn't get exactly the messages that weren't dropped
+ * */
+static bool measureWriters(int threads, int messages) {
+    ShmSink sink(RING_NAME, 8 << 20);
+    Consumer consumer(200, false);
+    const char line[] = "[12] 0.001234 [TCE] [00000042]: request 42 GET /api/v1/orders user=alice status=200 took 1.234ms\n";
+    std::ostream& output = sink;
+    std::vector<std::thread> writers;
+    int perThread = messages / threads;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(int t = 0; t < threads; ++t) {
+        writers.emplace_back([&]() {
+            for(int i = 0; i < perThread; ++i) {
+                output.write(line, sizeof(line) - 1);
+            }
+        });
+    }
+
+    for(std::thread& writer : writers) {
+        writer.join();
+    }
+
+    double seconds = secondsSince(start);
+    consumer.finish();
+
+    uint64_t total = (uint64_t)perThread * threads;
+    printf("%d writer%s   %7.1f ns/message per thread  %6.1f M messages/s  %llu dropped\n", threads, threads > 1? "s" : " ",
+        seconds * 1e9 / perThread, total / seconds / 1e6, (unsigned long long)sink.getDropped());
+
+    return consumer.messages + sink.getDropped() == total;
+}
+
+static void printLatency(const char* name, std::vector<uint64_t>& latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    size_t count = latencies.size();
+
+    printf("%-24s p50 %7.2f us  p99 %7.2f us  p99.9 %7.2f us  max %8.2f us\n", name,
+        latencies[count / 2] / 1e3, latencies[count * 99 / 100] / 1e3, latencies[count * 999 / 1000] / 1e3, latencies[count - 1] / 1e3);
+}
+
+/**
+ * Sends a timestamped message every @param gapNanoseconds and measures when the reader sees it
+ * */
+static bool measureLatency(const char* name, int idleMicroseconds, int messages, uint64_t gapNanoseconds) {
+    ShmSink sink(RING_NAME, 8 << 20);
+    Consumer consumer(idleMicroseconds, true);
+    std::ostream& output = sink;
+    char line[64] = "........ timestamped message\n";
+
+    for(int i = 0; i < messages; ++i) {
+        uint64_t sent = nowNanoseconds();
+        memcpy(line, &sent, sizeof(sent));
+        output.write(line, 29);
+
+        while(nowNanoseconds() - sent < gapNanoseconds) {
+        }
+    }
+
+    consumer.finish();
+    printLatency(name, consumer.latencies);
+    return consumer.messages + sink.getDropped() == (uint64_t)messages;
+}
+
+int main(int argc, char** argv) {
+    int messages = argc > 1? atoi(argv[1]) : 4000000;
+    bool matches = true;
+
+    printf("writing %d messages of 96 bytes with a reader draining the ring:\n", messages);
+
+    for(int threads = 1; threads <= 4; threads *= 2) {
+        matches = measureWriters(threads, messages) && matches;
+    }
+
+    {
+        DebugLogger logger;
+        logger.setLevel(Level::LEVEL_TRACE);
+        int count = messages / 4;
+
+        ShmSink sink(RING_NAME, 8 << 20);
+        Consumer consumer(200, false);
+        logger.setTargetOutput(&sink);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < count; ++i) {
+            logger.trace("request {int} GET {str} status={int}", i, "/api/v1/orders", 200);
+        }
+
+        double shmSeconds = secondsSince(start);
+        consumer.finish();
+
+        FileSink file("/tmp/ShmBenchmark.log");
+        logger.setTargetOutput(&file);
+        start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < count; ++i) {
+            logger.trace("request {int} GET {str} status={int}", i, "/api/v1/orders", 200);
+        }
+
+        file.flush();
+        double fileSeconds = secondsSince(start);
+        remove("/tmp/ShmBenchmark.log");
+
+        printf("logger to ShmSink %7.1f ns/message, to FileSink %7.1f ns/message\n", shmSeconds * 1e9 / count, fileSeconds * 1e9 / count);
+        matches = consumer.messages + sink.getDropped() == (uint64_t)count && matches;
+    }
+
+    printf("latency to the reader, one message every 5us:\n");
+    matches = measureLatency("spinning reader", 0, messages / 40, 5000) && matches;
+    matches = measureLatency("reader sleeping 200us", 200, messages / 40, 5000) && matches;
+
+    shm_unlink(RING_NAME);
+
+    if(!matches) {
+        printf("the reader didn't get every message that wasn't dropped\n");
+    }
+
+    return matches? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "ShmSink.h"
+
+/**
+ * Drains the shared memory ring of a ShmSink to a file
+ * ```
+ * ShmCollector [-o file] [-x] [-i microseconds] name
+ * ```
+ * Waits for the ring to be created, then copies every message to the file (appending) or stdout.
+ * When the application closes the ring, or dies without closing it, what is left is drained, records the application
+ * was in the middle of writing are skipped and reported, and the ring is removed. Then the collector waits for the next ring
+ * by that name, or exits with -x. -i sets how long to sleep when the ring is empty (default 200us)
+ * Stops on SIGINT or SIGTERM after draining what is in the ring
+ * */
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStop(int) {
+    stopRequested = 1;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: ShmCollector [-o file] [-x] [-i microseconds] name\n"
+        "  -o file          append to file instead of writing to stdout\n"
+        "  -x               exit once the ring is closed instead of waiting for the next one\n"
+        "  -i microseconds  sleep this long when the ring is empty (default 200)\n");
+}
+
+/**
+ * Copies every finished message to @param output
+ * @return the last status of the reader
+ * */
+static ShmSink::Reader::Status drain(ShmSink::Reader& reader, FILE* output, uint64_t& messages) {
+    const char* data;
+    size_t length;
+    ShmSink::Reader::Status status;
+
+    while((status = reader.peek(data, length)) == ShmSink::Reader::RECORD) {
+        fwrite(data, 1, length, output);
+        reader.release();
+        messages++;
+    }
+
+    return status;
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = nullptr;
+    const char* name = nullptr;
+    bool exitWhenClosed = false;
+    int idleMicroseconds = 200;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            idleMicroseconds = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-x") == 0) {
+            exitWhenClosed = true;
+        }
+        else if(argv[i][0] == '-' || name) {
+            usage();
+            return 2;
+        }
+        else {
+            name = argv[i];
+        }
+    }
+
+    if(!name) {
+        usage();
+        return 2;
+    }
+
+    FILE* output = outputPath? fopen(outputPath, "ab") : stdout;
+
+    if(!output) {
+        fprintf(stderr, "can't open %s\n", outputPath);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    ShmSink::Reader reader;
+
+    while(!stopRequested) {
+        if(!reader.attach(name)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+
+        fprintf(stderr, "attached to %s, %llu bytes, writer %u\n", name, (unsigned long long)reader.getCapacity(), reader.getWriterPid());
+        uint64_t messages = 0;
+        uint64_t salvaged = 0;
+        bool crashed = false;
+
+        while(true) {
+            //read the state first, the messages written before the ring was closed are all in by then
+            bool closed = reader.isClosed();
+            ShmSink::Reader::Status status = drain(reader, output, messages);
+
+            if(status == ShmSink::Reader::EMPTY && (closed || stopRequested)) {
+                break;
+            }
+
+            //check the writer after draining, what it finished before dying is still read
+            if(reader.isWriterDead()) {
+                crashed = true;
+
+                while(drain(reader, output, messages) != ShmSink::Reader::EMPTY) {
+                    salvaged += reader.salvage();
+                }
+
+                break;
+            }
+
+            fflush(output);
+            std::this_thread::sleep_for(std::chrono::microseconds(idleMicroseconds));
+        }
+
+        fflush(output);
+        fprintf(stderr, "%s %s: %llu messages, %llu dropped by the writer", name, crashed? "writer died" : reader.isClosed()? "closed" : "stopped",
+            (unsigned long long)messages, (unsigned long long)reader.getDropped());
+
+        if(salvaged) {
+            fprintf(stderr, ", %llu bytes of unfinished records skipped", (unsigned long long)salvaged);
+        }
+
+        fprintf(stderr, "\n");
+
+        //a new ShmSink may already have replaced the ring, only remove this one
+        if(!stopRequested && reader.isCurrent(name)) {
+            shm_unlink(name);
+        }
+
+        reader.detach();
+
+        if(exitWhenClosed) {
+            break;
+        }
+    }
+
+    if(outputPath) {
+        fclose(output);
+    }
+
+    return 0;
+}
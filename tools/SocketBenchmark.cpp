@@ -0,0 +1,218 @@
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "SocketSink.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures logging through a SocketSink to a collector thread in this process, for each kind of socket and a few batch sizes,
+ * compared with writing the same messages to a file. Then runs a collector that can't keep up to show the drop accounting
+ * Returns 1 if a collector on a Unix socket received a different number of bytes than the sink says it sent
+ * ```
+ * SocketBenchmark [messages] [directory]
+ * ```
+ * */
+
+/**
+ * A mix of the messages a traced service prints
+ * */
+static void logMessages(DebugLogger& logger, int count) {
+    static const char* users[] = { "alice", "bob", "carol", "dave", "erin" };
+    static const char* paths[] = { "/api/v1/orders", "/api/v1/users", "/static/app.js", "/health" };
+
+    for(int i = 0; i < count; ++i) {
+        switch(i % 4) {
+            case 0:
+                logger.trace("request {int} GET {str} user={str} status={int} took {.3f}ms", i, paths[i % 4], users[i % 5], (i % 50)? 200 : 404, (i % 997) * 0.0137);
+                break;
+            case 1:
+                logger.trace("db.query rows={int} table=orders shard={int} cache={str}", (i * 7) % 1000, i % 16, (i % 3)? "hit" : "miss");
+                break;
+            case 2:
+                logger.trace("queue depth {int}, worker {int} picked job {0x ulong}", (i / 3) % 40, i % 8, (unsigned long long)i * 2654435761ull);
+                break;
+            default:
+                logger.trace("response {int} sent {int} bytes", i - 3, 512 + (i % 4096));
+                break;
+        }
+    }
+}
+
+/**
+ * Receives on an address until stopped, counting bytes, optionally sleeping after every read to act like a slow agent
+ * */
+class Collector {
+    public:
+        Collector(const SocketSink::Address& address, int slowMicroseconds)
+            :address(address),
+            slowMicroseconds(slowMicroseconds)
+        {
+            listener = socket(address.family(), address.type, 0);
+
+            if(address.family() == AF_UNIX) {
+                unlink(((const sockaddr_un*)&address.storage)->sun_path);
+            }
+
+            if(listener < 0 || bind(listener, address.get(), address.length) != 0 || (address.type == SOCK_STREAM && listen(listener, 4) != 0)) {
+                fprintf(stderr, "can't listen: %s\n", strerror(errno));
+                exit(1);
+            }
+
+            //the default buffer, so a slow collector pushes back on the sink
+            if(slowMicroseconds == 0) {
+                int size = 4 << 20;
+                setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+            }
+
+            thread = std::thread(&Collector::run, this);
+        }
+
+        /**
+         * Stops once nothing more arrives
+         * */
+        uint64_t finish() {
+            stopping.store(true);
+            thread.join();
+            close(listener);
+
+            if(address.family() == AF_UNIX) {
+                unlink(((const sockaddr_un*)&address.storage)->sun_path);
+            }
+
+            return bytes;
+        }
+
+    private:
+        void run() {
+            static char buffer[1 << 17];
+            int fd = listener;
+
+            while(true) {
+                pollfd waiting = { fd, POLLIN, 0 };
+
+                if(poll(&waiting, 1, 50) <= 0) {
+                    if(stopping.load()) {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                if(address.type == SOCK_STREAM && fd == listener) {
+                    fd = accept(listener, nullptr, nullptr);
+                    continue;
+                }
+
+                ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+
+                if(length <= 0) {
+                    if(fd != listener) {
+                        close(fd);
+                        fd = listener;
+                    }
+
+                    continue;
+                }
+
+                bytes += (uint64_t)length;
+
+                if(slowMicroseconds) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(slowMicroseconds));
+                }
+            }
+
+            if(fd != listener) {
+                close(fd);
+            }
+        }
+
+        SocketSink::Address address;
+        int slowMicroseconds;
+        int listener;
+        uint64_t bytes = 0;
+        std::atomic<bool> stopping{ false };
+        std::thread thread;
+};
+
+static bool measureSocket(const std::string& addressText, size_t batchSize, int messages, int slowMicroseconds) {
+    SocketSink::Address address;
+    SocketSink::Address::parse(addressText.c_str(), address);
+    Collector collector(address, slowMicroseconds);
+
+    SocketSink sink(addressText.c_str(), batchSize);
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&sink);
+
+    if(slowMicroseconds) {
+        sink.setMaxQueuedBatches(16);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    logMessages(logger, messages);
+    double logSeconds = secondsSince(start);
+    sink.drain();
+    double totalSeconds = secondsSince(start);
+    uint64_t received = collector.finish();
+
+    printf("%-22s %7zu %9.0f %9.0f %8.1f %9llu %9llu\n", addressText.substr(0, addressText.find(':')).c_str(), batchSize,
+        messages / logSeconds / 1000, messages / totalSeconds / 1000, sink.getSentBytes() / totalSeconds / 1e6,
+        (unsigned long long)sink.getSentBatches(), (unsigned long long)sink.getDropped());
+
+    if(received != sink.getSentBytes()) {
+        printf("  collector received %llu bytes, the sink sent %llu\n", (unsigned long long)received, (unsigned long long)sink.getSentBytes());
+    }
+
+    //UDP may lose datagrams the collector's buffer has no room for, Unix sockets never do
+    return received == sink.getSentBytes() || address.family() != AF_UNIX;
+}
+
+int main(int argc, char** argv) {
+    int messages = argc > 1? atoi(argv[1]) : 1000000;
+    std::string directory = argc > 2? argv[2] : "/tmp";
+    std::string socketPath = directory + "/SocketBenchmark.sock";
+    bool matches = true;
+
+    printf("%d messages\n", messages);
+    printf("%-22s %7s %9s %9s %8s %9s %9s\n", "socket", "batch", "klog/s", "kmsg/s", "MB/s", "batches", "dropped");
+
+    {
+        std::string path = directory + "/SocketBenchmark.log";
+        FileSink file(path.c_str());
+        DebugLogger logger;
+        logger.setLevel(Level::LEVEL_TRACE);
+        logger.setTargetOutput(&file);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        logMessages(logger, messages);
+        file.flush();
+        double seconds = secondsSince(start);
+        printf("%-22s %7s %9.0f %9.0f %8.1f\n", "file", "-", messages / seconds / 1000, messages / seconds / 1000, file.getBytes() / seconds / 1e6);
+        remove(path.c_str());
+    }
+
+    static const size_t batchSizes[] = { 4096, 16384, 65507 };
+
+    for(size_t batchSize : batchSizes) {
+        matches = measureSocket("unix:" + socketPath, batchSize, messages, 0) && matches;
+    }
+
+    for(size_t batchSize : batchSizes) {
+        matches = measureSocket("unix-stream:" + socketPath, batchSize, messages, 0) && matches;
+    }
+
+    for(size_t batchSize : batchSizes) {
+        matches = measureSocket("udp:127.0.0.1:47613", batchSize, messages, 0) && matches;
+    }
+
+    printf("slow collector, 16 queued batches:\n");
+    matches = measureSocket("unix:" + socketPath, 16384, messages, 2000) && matches;
+
+    return matches? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "Timer.h"
+
+/**
+ * Measures the cost of reading each clock policy in Timer.h and checks that none of them go backwards,
+ * both on one thread and across threads
+ * Returns 1 if any clock went backwards
+ * */
+
+static const int READS = 10000000;
+static const int CHECK_THREADS = 4;
+static const int CHECK_READS = 2000000;
+
+template<typename Clock>
+double nanosecondsPerRead() {
+    uint64_t sink = 0;
+    uint64_t start = SteadyClock::ticks();
+
+    for(int i = 0; i < READS; ++i) {
+        sink += Clock::ticks();
+    }
+
+    uint64_t end = SteadyClock::ticks();
+
+    //keeps the loop from being optimized away
+    if(sink == 1) {
+        printf(" ");
+    }
+
+    return (double)(end - start) / READS;
+}
+
+/**
+ * Each thread reads the newest value published by any thread, then reads the clock, which must not be older
+ * */
+template<typename Clock>
+uint64_t countBackwardSteps() {
+    std::atomic<uint64_t> latest{ 0 };
+    std::atomic<uint64_t> backwards{ 0 };
+    std::vector<std::thread> threads;
+
+    for(int t = 0; t < CHECK_THREADS; ++t) {
+        threads.emplace_back([&latest, &backwards]() {
+            BasicTimer<Clock> timer;
+            uint64_t previousElapsed = 0;
+
+            for(int i = 0; i < CHECK_READS; ++i) {
+                uint64_t published = latest.load(std::memory_order_acquire);
+                uint64_t now = Clock::toNanoseconds(Clock::ticks());
+                uint64_t elapsed = timer.nanoseconds();
+
+                if(now < published || elapsed < previousElapsed) {
+                    backwards.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                previousElapsed = elapsed;
+
+                while(now > published && !latest.compare_exchange_weak(published, now, std::memory_order_release)) {
+                }
+            }
+        });
+    }
+
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return backwards.load();
+}
+
+template<typename Clock>
+bool benchmark(const char* name) {
+    double cost = nanosecondsPerRead<Clock>();
+    uint64_t backwards = countBackwardSteps<Clock>();
+    printf("%-12s %7.2f ns/read  %llu backward steps\n", name, cost, (unsigned long long)backwards);
+    return backwards == 0;
+}
+
+int main() {
+    bool invariant = TscClock::isInvariant();
+    printf("invariant tsc: %s\n", invariant? "yes" : "no, TscClock uses steady_clock");
+
+    bool passed = benchmark<SteadyClock>("steady");
+    passed = benchmark<CoarseClock>("coarse") && passed;
+    passed = benchmark<TscClock>("tsc") && passed;
+
+    //compare the calibrated TSC against steady_clock over 100ms
+    if(invariant) {
+        uint64_t steadyStart = SteadyClock::ticks();
+        uint64_t tscStart = TscClock::ticks();
+
+        while(SteadyClock::ticks() - steadyStart < 100000000) {
+        }
+
+        double steadyElapsed = (double)(SteadyClock::ticks() - steadyStart);
+        double tscElapsed = (double)TscClock::toNanoseconds(TscClock::ticks() - tscStart);
+        printf("tsc calibration error: %.1f ppm\n", (tscElapsed - steadyElapsed) / steadyElapsed * 1e6);
+    }
+
+    return passed? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DebugLogger.h"
+#include "FileSink.h"
+#include "VariableWatch.h"
+#include "BenchmarkClock.h"
+
+/**
+ * Measures a hot loop that updates watched variables: alone, while a VariableWatch prints them every 10ms,
+ * and while it logs a line every 1024 iterations instead
+ * Returns 1 if the watch doesn't start or never prints
+ * ```
+ * WatchBenchmark [iterations]
+ * ```
+ * */
+
+static std::atomic<int64_t> handled{ 0 };
+static std::atomic<double> load{ 0 };
+static SeqlockString stage;
+
+/**
+ * The loop being watched, logging every 1024th iteration when @param logger is set
+ * */
+static double runLoop(long long iterations, DebugLogger* logger) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(long long i = 0; i < iterations; ++i) {
+        handled.fetch_add(1, std::memory_order_relaxed);
+        load.store((double)(i & 255) / 256, std::memory_order_relaxed);
+
+        if((i & 0xfffff) == 0) {
+            stage.set((i >> 20) & 1? "merge" : "scan");
+        }
+
+        if(logger && (i & 1023) == 0) {
+            logger->trace("handled=[handled] load=[load] stage=[stage]");
+        }
+    }
+
+    return secondsSince(start) * 1e9 / iterations;
+}
+
+int main(int argc, char** argv) {
+    long long iterations = argc > 1? atoll(argv[1]) : 200000000;
+
+    FileSink file("/tmp/WatchBenchmark.log");
+    DebugLogger logger;
+    logger.setLevel(Level::LEVEL_TRACE);
+    logger.setTargetOutput(&file);
+    logger.addVariable("handled", &handled);
+    logger.addVariable("load", &load);
+    logger.addVariable("stage", &stage);
+
+    printf("%lld iterations\n", iterations);
+    printf("no logging          %6.2f ns/iteration\n", runLoop(iterations, nullptr));
+
+    bool works;
+    {
+        VariableWatch watch(logger, "handled=[handled] load=[load] stage=[stage]", 10);
+        double watched = runLoop(iterations, nullptr);
+        watch.stop();
+        printf("watched every 10ms  %6.2f ns/iteration, %llu snapshots\n", watched, (unsigned long long)watch.getPrinted());
+        works = watch.isValid() && watch.getPrinted() > 0;
+    }
+
+    printf("line every 1024     %6.2f ns/iteration\n", runLoop(iterations, &logger));
+
+    {
+        int plain = 0;
+        logger.addVariable("plain", &plain);
+        VariableWatch rejected(logger, std::vector<std::string>{ "handled", "plain" }, 10);
+        printf("watching a plain int: %s\n", rejected.isValid()? "started" : ("rejected " + rejected.getRejected()).c_str());
+        works = works && !rejected.isValid();
+    }
+
+    file.flush();
+    remove("/tmp/WatchBenchmark.log");
+    return works? 0 : 1;
+}